@@ -1,22 +1,53 @@
 /*
  *	Excalibur Engine Entry
  *	(c) 2013  Jim Fan
+ *
+ *	A thin UCI front-end over libexcalibur (engine.h): UCI::process() drives one
+ *	Excalibur::Engine with the protocol's commands.
  */
 
 #include "search.h"
 #include "eval.h"
 #include "uci.h"
 #include "thread.h"
+#include "engine.h"
 
-int main()
+int main(int argc, char *argv[])
 {
 	display_engine_info;
 
-	Utils::init();
-	Board::init_tables();
-	UCI::init_options();
-	Eval::init();
-	Search::init();
+	Excalibur::init();
+
+	// Command line mode: run one command and exit with its status.
+	// Only 'bench [depth] [threads] [hash]', 'book build ...', 'analyze ...', 'match ...',
+	// 'gensfen ...' and 'serve ...' are supported
+	if (argc > 1)
+	{
+		string cmd, args;
+		for (int i = 2; i < argc; i++)
+			args += string(argv[i]) + " ";
+		istringstream iss(args);
+
+		ThreadPool::init(false);
+		int status = 1;
+		if (str2lower(cmd = argv[1]) == "bench")
+			status = UCI::bench(iss);
+		else if (cmd == "book")
+			status = UCI::book(iss);
+		else if (cmd == "analyze")
+			status = UCI::analyze(iss);
+		else if (cmd == "match")
+			status = UCI::match(iss);
+		else if (cmd == "gensfen")
+			status = UCI::gensfen(iss);
+		else if (cmd == "serve")
+			status = UCI::serve(iss);
+		else
+			sync_print("Command line not supported: " << cmd);
+		ThreadPool::terminate();
+		return status;
+	}
+
 	ThreadPool::init();
 
 	UCI::process();
@@ -0,0 +1,336 @@
+/*
+ *	EPD batch analysis. Syntax: analyze <epd> [--threads N] --depth D|--nodes N|--movetime T [--out file]
+ *	Worker threads take the positions in turn. Each one searches with its own
+ *	Search::Context: root, limits, history and evaluation tables. Only the TT
+ *	is shared. Every position gives one JSON line, written in the order of the file.
+ *	EPD 'bm' and 'am' operations are scored like a test suite.
+ */
+#include "search.h"
+#include "uci.h"
+#include "thread.h"
+#include <thread>
+
+using namespace Search;
+
+namespace UCI
+{
+
+// Sanity check of the 4 EPD fields before we hand them to Position::parse_fen()
+bool valid_fen_fields(const string *field)
+{
+	int rank = 0, file = 0, kings[COLOR_N] = { 0, 0 };
+	for (char ch : field[0])
+	{
+		if (ch == '/')
+		{
+			if (file != 8)  return false;
+			rank ++;
+			file = 0;
+		}
+		else if (ch >= '1' && ch <= '8')
+			file += ch - '0';
+		else if (strchr("pnbrqkPNBRQK", ch))
+		{
+			kings[W] += ch == 'K';
+			kings[B] += ch == 'k';
+			file ++;
+		}
+		else
+			return false;
+		if (file > 8)  return false;
+	}
+	return rank == 7 && file == 8 && kings[W] == 1 && kings[B] == 1
+		&& (field[1] == "w" || field[1] == "b")
+		&& field[2].find_first_not_of("KQkq-") == string::npos
+		&& (field[3] == "-" || (field[3].size() == 2 && field[3][0] >= 'a' && field[3][0] <= 'h'
+									&& (field[3][1] == '3' || field[3][1] == '6')));
+}
+
+bool parse_epd(string line, EpdPosition& epd)
+{
+	epd = EpdPosition();
+	istringstream iss(line);
+	string field[4];
+	for (string& f : field)
+		if (!(iss >> f))
+			return false;
+	if (!valid_fen_fields(field))
+		return false;
+	epd.fen = field[0] + " " + field[1] + " " + field[2] + " " + field[3];
+
+	// A plain FEN carries the two counters. In EPD they are 'hmvc' and 'fmvn'
+	string rest, counters[2];
+	getline(iss, rest);
+	istringstream issCnt(rest);
+	if (issCnt >> counters[0] >> counters[1] && is_int(counters[0]) && is_int(counters[1]))
+		getline(issCnt, rest);
+	else
+		counters[0] = "0", counters[1] = "1";
+
+	// Operations are "opcode operand ...;". Strings are in double quotes
+	vector<pair<string, vector<string>>> ops;
+	vector<string> tokens;
+	string tok;
+	bool quoted = false;
+	for (size_t i = 0; i <= rest.size(); i++)
+	{
+		char ch = i < rest.size() ? rest[i] : ';';
+		if (ch == '"')
+			quoted = !quoted;
+		else if (!quoted && (ch == ' ' || ch == '\t' || ch == ';'))
+		{
+			if (!tok.empty())
+				tokens.push_back(tok);
+			tok.clear();
+			if (ch == ';' && !tokens.empty())
+			{
+				ops.push_back(make_pair(tokens[0], vector<string>(tokens.begin() + 1, tokens.end())));
+				tokens.clear();
+			}
+		}
+		else
+			tok += ch;
+	}
+	for (auto& op : ops)
+		if ((op.first == "hmvc" || op.first == "fmvn") && op.second.size() == 1 && is_int(op.second[0]))
+			counters[op.first == "fmvn"] = op.second[0];
+	epd.fen += " " + counters[0] + " " + counters[1];
+
+	Position pos(epd.fen);
+	for (auto& op : ops)
+	{
+		if (op.first == "id" && !op.second.empty())
+			epd.id = op.second[0];
+		else if (op.first == "bm" || op.first == "am")
+			for (string& san : op.second)
+			{
+				Move mv = san2move(pos, san);
+				if (mv == MOVE_NULL)
+					return false;
+				(op.first == "bm" ? epd.bm : epd.am).push_back(mv);
+			}
+	}
+	return true;
+}
+
+} // namespace UCI
+
+
+namespace Analysis
+{
+
+// The work shared by the workers. Lines are (line number, text)
+vector<pair<int, string>> Lines;
+std::atomic<int> NextLine;
+LimitListener Limits;
+std::atomic<int> Scored, Solved, Errors;
+std::atomic<U64> TotalNodes;
+
+// Results come back out of order. They're held until the previous lines are written
+Mutex OutLock;
+map<int, string> Finished;
+int NextOut;
+ofstream OutFile;
+
+string json_escape(const string& str)
+{
+	string out;
+	for (char ch : str)
+	{
+		if (ch == '"' || ch == '\\')  out += '\\';
+		if (ch >= 0 && ch < ' ')  continue;
+		out += ch;
+	}
+	return out;
+}
+
+void write(int idx, const string& json)
+{
+	OutLock.lock();
+	Finished[idx] = json;
+	while (!Finished.empty() && Finished.begin()->first == NextOut)
+	{
+		if (OutFile.is_open())
+			OutFile << Finished.begin()->second << "\n";
+		else
+			sync_print(Finished.begin()->second);
+		Finished.erase(Finished.begin());
+		NextOut ++;
+	}
+	OutLock.unlock();
+}
+
+struct AnalysisWorker : public Thread
+{
+	AnalysisWorker() { cx.silent = true; cx.read_options(); }
+	virtual void execute();
+	string analyze(const pair<int, string>& line);
+
+	Context cx;
+};
+
+void AnalysisWorker::execute()
+{
+	bind_context(cx);
+	for (int i; (i = NextLine++) < int(Lines.size()); )
+		write(i, analyze(Lines[i]));
+}
+
+string AnalysisWorker::analyze(const pair<int, string>& line)
+{
+	ostringstream oss;
+	oss << "{\"line\":" << line.first;
+	UCI::EpdPosition epd;
+	if (!UCI::parse_epd(line.second, epd))
+	{
+		Errors ++;
+		oss << ",\"error\":\"bad EPD\"}";
+		return oss.str();
+	}
+	if (!epd.id.empty())
+		oss << ",\"id\":\"" << json_escape(epd.id) << "\"";
+
+	cx.rootPos = Position(epd.fen);  // the assignment resets the node count
+	cx.rootMoveList.clear();
+	MoveBuffer mbuf;
+	ScoredMove *it, *end = cx.rootPos.gen_moves<LEGAL>(mbuf);
+	for (it = mbuf; it != end; ++it)
+		cx.rootMoveList.push_back(RootMove(it->move));
+	cx.limit = Limits;
+	cx.signal.stopOnPonderhit = cx.signal.stop = false;
+	cx.searchTime = now();
+
+	run();
+
+	Msec time = now() - cx.searchTime;
+	const RootMove& rm = cx.rootMoveList[0];
+	Move best = rm.pv[0];
+	TotalNodes += cx.rootPos.nodes;
+
+	if (best == MOVE_NULL)  // checkmate or stalemate
+		oss << ",\"bestmove\":null";
+	else
+		oss << ",\"bestmove\":\"" << UCI::move2uci(best) << "\"";
+	// A search stopped within its first iteration has no score
+	Value score = rm.score != -VALUE_INFINITE ? rm.score
+		: cx.rootMoveList.size() == 1 && best == MOVE_NULL ?
+			(cx.rootPos.checker_map() ? -VALUE_MATE : VALUE_DRAW) : VALUE_NULL;
+	if (score != VALUE_NULL)
+	{
+		string unit, val;  // "cp 25" or "mate -3"
+		istringstream(UCI::score2uci(score)) >> unit >> val;
+		oss << ",\"score\":{\"" << unit << "\":" << val << "}";
+	}
+	oss << ",\"depth\":" << cx.completedDepth << ",\"nodes\":" << cx.rootPos.nodes
+		<< ",\"time\":" << time << ",\"pv\":[";
+	for (int i = 0; rm.pv[i] != MOVE_NULL; i++)
+		oss << (i ? "," : "") << "\"" << UCI::move2uci(rm.pv[i]) << "\"";
+	oss << "]";
+
+	if (!epd.bm.empty() || !epd.am.empty())
+	{
+		bool solved = (epd.bm.empty() || std::find(epd.bm.begin(), epd.bm.end(), best) != epd.bm.end())
+			&& std::find(epd.am.begin(), epd.am.end(), best) == epd.am.end();
+		Scored ++;
+		Solved += solved;
+		oss << ",\"solved\":" << (solved ? "true" : "false");
+	}
+	oss << "}";
+	return oss.str();
+}
+
+} // namespace Analysis
+
+
+namespace UCI
+{
+
+int analyze(istream& args)
+{
+	using namespace Analysis;
+	string epdPath, outPath, opt, val;
+	int threads = 0;
+	LimitListener limit;
+	limit.clear();
+	bool ok = bool(args >> epdPath) && epdPath.compare(0, 2, "--") != 0;
+	while (ok && args >> opt)
+	{
+		ok = bool(args >> val);
+		if (!ok)  break;
+		if (opt == "--out")
+			outPath = val;
+		else if (!is_int(val) || str2int(val) < 1)
+			ok = false;
+		else if (opt == "--threads")  threads = str2int(val);
+		else if (opt == "--depth")  limit.depth = min(str2int(val), MAX_PLY - 1);
+		else if (opt == "--nodes")  limit.nodes = str2int(val);
+		else if (opt == "--movetime")  limit.moveTime = str2int(val);
+		else
+			ok = false;
+	}
+	if (!ok || !(limit.depth || limit.nodes || limit.moveTime))
+	{
+		sync_print("Usage: analyze <epd> [--threads N] --depth D|--nodes N|--movetime T [--out file]");
+		return 1;
+	}
+
+	ifstream fin(epdPath);
+	if (!fin.is_open())
+	{
+		sync_print("info string cannot open " + epdPath);
+		return 1;
+	}
+	Lines.clear();
+	string line;
+	for (int n = 1; getline(fin, line); n++)
+	{
+		if (!line.empty() && line.back() == '\r')
+			line.pop_back();
+		if (line.find_first_not_of(" \t") != string::npos && line[0] != '#')
+			Lines.push_back(make_pair(n, line));
+	}
+	if (!outPath.empty())
+	{
+		OutFile.open(outPath);
+		if (!OutFile.is_open())
+		{
+			sync_print("info string cannot write " + outPath);
+			return 1;
+		}
+	}
+
+	if (threads < 1)  // all cores
+		threads = max(1u, std::thread::hardware_concurrency());
+	threads = min<int>(threads, max<size_t>(Lines.size(), 1));
+	U64 startTime = now();
+	Limits = limit;
+	NextLine = NextOut = 0;
+	Scored = Solved = Errors = 0;
+	TotalNodes = 0;
+	Finished.clear();
+	// The TT of the workers is only allocated when needed, see Search::init()
+	Transposition::TT.set_size(OptMap["Hash"]);
+
+	vector<AnalysisWorker *> workers;
+	for (int i = 0; i < threads; i++)
+		workers.push_back(new_thread<AnalysisWorker>());
+	// The workers exit by themselves when there are no lines left
+	for (AnalysisWorker *w : workers)
+		del_thread(w);
+	if (OutFile.is_open())
+		OutFile.close();
+
+	Msec time = max<Msec>(now() - startTime, 1);
+	ostringstream oss;
+	oss << "info string analyze: " << Lines.size() << " positions";
+	if (Errors)
+		oss << " (" << Errors << " bad EPD lines)";
+	if (Scored)
+		oss << ", solved " << Solved << "/" << Scored;
+	oss << ", " << TotalNodes << " nodes in " << time / 1000.0 << " s, "
+		<< TotalNodes * 1000 / time << " nps on " << threads << " threads";
+	sync_print(oss.str());
+	return 0;
+}
+
+} // namespace UCI
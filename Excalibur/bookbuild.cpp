@@ -0,0 +1,336 @@
+/*
+ *	PGN to Polyglot book builder. Syntax: book build <pgn> <out> [maxply] [threads]
+ *	The calling thread streams the PGN file and cuts it into batches of games.
+ *	Worker threads replay the SAN moves and add up the weights of every
+ *	(position, move) pair into hash maps sharded by key, so that they rarely
+ *	wait on each other. Finally the entries are sorted and written big-endian.
+ */
+#include "openbook.h"
+#include "uci.h"
+#include "thread.h"
+#include <thread>
+
+using namespace Moves;
+
+namespace Polyglot
+{
+
+// A game as the workers need it
+struct PgnGame
+{
+	string fen;  // empty for the standard start position
+	int result;  // from white's point of view: 2 win, 1 draw, 0 loss
+	string moves;  // movetext
+};
+typedef vector<PgnGame> PgnBatch;
+const size_t BATCH_SIZE = 256;  // games
+
+// (key, Polyglot move) -> weight
+struct BookMove
+{
+	U64 key;
+	ushort move;
+	bool operator==(const BookMove& bm) const { return key == bm.key && move == bm.move; }
+};
+struct BookMoveHash
+{
+	size_t operator()(const BookMove& bm) const { return size_t(bm.key ^ bm.move); }
+};
+
+const int SHARD_N = 64;
+struct Shard
+{
+	Mutex lock;
+	unordered_map<BookMove, U64, BookMoveHash> weights;
+};
+inline int shard_of(U64 key) { return key >> 58; }
+
+Shard *Shards;
+int MaxPly;
+std::atomic<U64> GameCnt, BadGameCnt;
+// Signaled by a worker done with a batch, when the reader waits for room
+Mutex IdleLock;
+ConditionVar IdleCond;
+
+// Polyglot moves: to in bits 0-5, from in 6-11, promotion (knight 1 to queen 4) in 12-14.
+// Castling is "king takes rook"
+ushort polyglot_move(Move mv)
+{
+	Square from = get_from(mv), to = get_to(mv);
+	if (is_castle(mv))
+		to = to > from ? from + 3 : from - 4;
+	return ushort(to | from << 6 | (is_promo(mv) ? (get_promo(mv) - 1) << 12 : 0));
+}
+
+// Replays one game and appends its (position, move) pairs with their weights
+bool replay(const PgnGame& game, vector<pair<BookMove, int>>& out, vector<StateInfo>& states)
+{
+	Position pos(game.fen.empty() ? FEN_START : game.fen);
+	U64 psq = psq_key(pos, pos.Occupied);
+	istringstream iss(game.moves);
+	string tok;
+	int ply = 0;
+
+	while (ply < MaxPly && iss >> tok)
+	{
+		// Move numbers "12." and "12...", possibly glued to the move
+		size_t dot = tok.find_last_of('.');
+		if (dot != string::npos)
+			tok = tok.substr(dot + 1);
+		if (tok.find_first_not_of("!?") == string::npos
+			|| tok[0] == '$' || isdigit(tok[0]) || tok == "*")
+			continue;  // annotation, NAG or result
+
+		Move mv = UCI::san2move(pos, tok);
+		if (mv == MOVE_NULL)
+			return false;
+
+		// The winner's moves weigh 2, a draw's 1, the loser's 0
+		int weight = pos.turn == W ? game.result : 2 - game.result;
+		if (weight)
+			out.push_back(make_pair(BookMove{ psq ^ state_key(pos), polyglot_move(mv) }, weight));
+
+		// Incremental key: rehash only the squares the move touches
+		Square from = get_from(mv), to = get_to(mv);
+		Bit touched = setbit(from) | setbit(to);
+		if (is_castle(mv))
+			touched |= to > from ? setbit(from + 1) | setbit(from + 3)
+								: setbit(from - 1) | setbit(from - 4);
+		else if (is_ep(mv))
+			touched |= setbit(sq2rank(from) * 8 + sq2file(to));
+		psq ^= psq_key(pos, touched);
+		pos.make_move(mv, states[ply++]);
+		psq ^= psq_key(pos, touched);
+	}
+	return true;
+}
+
+struct BookWorker : public Thread
+{
+	virtual void execute();
+	void process(const PgnBatch& batch);
+
+	RingQueue<PgnBatch *, 16> batches;
+};
+
+void BookWorker::execute()
+{
+	PgnBatch *batch;
+	while (true)
+	{
+		if (batches.pop(batch))
+		{
+			process(*batch);
+			delete batch;
+			IdleLock.lock();
+			IdleCond.signal();
+			IdleLock.unlock();
+			continue;
+		}
+		mutex.lock();
+		bool more = exist;
+		if (more)
+			sleepCond.timed_wait(mutex, 1);
+		mutex.unlock();
+		// del_thread() is only called after the last push
+		if (!more && batches.empty())
+			return;
+	}
+}
+
+void BookWorker::process(const PgnBatch& batch)
+{
+	vector<pair<BookMove, int>> moves;
+	vector<StateInfo> states(MaxPly);
+	for (const PgnGame& game : batch)
+	{
+		if (!replay(game, moves, states))
+			BadGameCnt ++;
+		GameCnt ++;
+	}
+
+	// Group by shard, so that each shard is locked once per batch
+	sort(moves.begin(), moves.end(), [](const pair<BookMove, int>& a, const pair<BookMove, int>& b)
+		{ return shard_of(a.first.key) < shard_of(b.first.key); });
+	for (size_t i = 0; i < moves.size(); )
+	{
+		Shard& shard = Shards[shard_of(moves[i].first.key)];
+		shard.lock.lock();
+		int s = shard_of(moves[i].first.key);
+		for (; i < moves.size() && shard_of(moves[i].first.key) == s; i++)
+			shard.weights[moves[i].first] += moves[i].second;
+		shard.lock.unlock();
+	}
+}
+
+// Hands the batch to the first worker with room in its queue
+void dispatch(vector<BookWorker *>& workers, PgnBatch *batch)
+{
+	for (size_t w = 0; ; w = (w + 1) % workers.size())
+	{
+		if (workers[w]->batches.push(batch))
+		{
+			workers[w]->signal();
+			return;
+		}
+		if (w == workers.size() - 1)  // all busy
+		{
+			IdleLock.lock();
+			IdleCond.timed_wait(IdleLock, 10);
+			IdleLock.unlock();
+		}
+	}
+}
+
+// Writes the entries sorted by key, best move first, in big-endian.
+// The order is total, so the file doesn't depend on the number of threads
+void write_book(ofstream& fout, vector<pair<BookMove, U64>>& entries)
+{
+	sort(entries.begin(), entries.end(), [](const pair<BookMove, U64>& a, const pair<BookMove, U64>& b)
+		{ return a.first.key != b.first.key ? a.first.key < b.first.key
+				: a.second != b.second ? a.second > b.second : a.first.move < b.first.move; });
+
+	for (size_t i = 0, j; i < entries.size(); i = j)
+	{
+		// The weights of a position are scaled down together to fit 16 bits
+		U64 maxWeight = entries[i].second;
+		for (j = i; j < entries.size() && entries[j].first.key == entries[i].first.key; j++)
+		{
+			U64 weight = maxWeight > 0xFFFF ? entries[j].second * 0xFFFF / maxWeight : entries[j].second;
+			BinaryIO<BigEndian>::put(fout, entries[j].first.key);
+			BinaryIO<BigEndian>::put(fout, entries[j].first.move);
+			BinaryIO<BigEndian>::put(fout, ushort(max<U64>(weight, 1)));
+			BinaryIO<BigEndian>::put(fout, uint(0)); // learn
+		}
+	}
+}
+
+string build(string pgnPath, string outPath, int maxPly, int threads)
+{
+	if (!KeysLoaded)
+		load_keys("Polyglot.key");
+	ifstream fin(pgnPath);
+	if (!fin.is_open())
+		return "cannot open " + pgnPath;
+
+	U64 startTime = now();
+	Shards = new Shard[SHARD_N];
+	MaxPly = max(1, maxPly);
+	GameCnt = BadGameCnt = 0;
+	if (threads < 1)  // all cores
+		threads = max(1u, std::thread::hardware_concurrency());
+	vector<BookWorker *> workers;
+	for (int i = 0; i < threads; i++)
+		workers.push_back(new_thread<BookWorker>());
+
+	// Tags start a game, the movetext runs until the next tag
+	PgnBatch *batch = new PgnBatch();
+	PgnGame game;
+	bool inMoves = false;
+	int depth = 0;  // of nested {comments} and (variations)
+	string line;
+	game.result = -1;
+	while (true)
+	{
+		bool eof = !getline(fin, line);
+		if (!line.empty() && line.back() == '\r')
+			line.pop_back();
+
+		if (eof || (inMoves && depth == 0 && !line.empty() && line[0] == '['))
+		{
+			if (game.result >= 0)  // unfinished games ("*") are skipped
+				batch->push_back(game);
+			if (batch->size() == BATCH_SIZE || (eof && !batch->empty()))
+			{
+				dispatch(workers, batch);
+				batch = new PgnBatch();
+			}
+			game = PgnGame();
+			game.result = -1;
+			inMoves = false;
+			depth = 0;
+			if (eof)  break;
+		}
+
+		if (!line.empty() && line[0] == '[' && depth == 0)
+		{
+			istringstream iss(line.substr(1));
+			string tag, value;
+			iss >> tag;
+			getline(iss, value);
+			size_t q1 = value.find('"'), q2 = value.rfind('"');
+			value = q1 < q2 ? value.substr(q1 + 1, q2 - q1 - 1) : "";
+			if (tag == "Result")
+				game.result = value == "1-0" ? 2 : value == "0-1" ? 0 : value == "1/2-1/2" ? 1 : -1;
+			else if (tag == "FEN")
+				game.fen = value;
+		}
+		else if (!line.empty() && line[0] != '%')  // '%' escapes a line
+		{
+			// Comments and variations are dropped here, so tokens never span lines
+			inMoves = true;
+			for (char ch : line)
+			{
+				if (ch == '{' || ch == '(')  depth ++;
+				else if (ch == '}' || ch == ')')  depth = max(0, depth - 1);
+				else if (depth == 0)
+				{
+					if (ch == ';')  break;  // comment to the end of line
+					game.moves += ch;
+				}
+			}
+			game.moves += ' ';
+		}
+	}
+	delete batch;
+
+	for (BookWorker *w : workers)
+		del_thread(w);
+
+	vector<pair<BookMove, U64>> entries;
+	for (int s = 0; s < SHARD_N; s++)
+	{
+		for (auto& bm : Shards[s].weights)
+			entries.push_back(bm);
+		Shards[s].weights.clear();
+	}
+	delete [] Shards;
+
+	ofstream fout(outPath, ofstream::binary);
+	if (!fout.is_open())
+		return "cannot write " + outPath;
+	write_book(fout, entries);
+	fout.close();
+
+	ostringstream oss;
+	oss << "book: " << GameCnt << " games";
+	if (BadGameCnt)
+		oss << " (" << BadGameCnt << " with an illegal move, kept up to it)";
+	oss << ", " << entries.size() << " entries written to " << outPath
+		<< " in " << (now() - startTime) / 1000.0 << " s";
+	return oss.str();
+}
+
+} // namespace Polyglot
+
+
+namespace UCI
+{
+
+int book(istream& args)
+{
+	string sub, pgn, out, maxPly, threads;
+	args >> sub >> pgn >> out >> maxPly >> threads;
+	if (sub != "build" || out.empty() || (!maxPly.empty() && !is_int(maxPly))
+		|| (!threads.empty() && !is_int(threads)))
+	{
+		sync_print("Usage: book build <pgn> <out> [maxply] [threads]");
+		return 1;
+	}
+	string msg = Polyglot::build(pgn, out, maxPly.empty() ? 40 : str2int(maxPly),
+							threads.empty() ? 0 : str2int(threads));
+	sync_print("info string " << msg);
+	return msg.compare(0, 6, "book: ") == 0 ? 0 : 1;
+}
+
+} // namespace UCI
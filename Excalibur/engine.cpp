@@ -0,0 +1,409 @@
+/*
+ *	libexcalibur, see engine.h.
+ *	An Engine is a worker Thread with its own Search::Context and TT. It sleeps
+ *	until analyze() hands it a search, plays it with think(), and fulfils the
+ *	promise with the result. Iterations are reported through Context::onIteration.
+ */
+#include "engine.h"
+#include "search.h"
+#include "eval.h"
+#include "uci.h"
+#include "thread.h"
+#include "openbook.h"
+#include "stats.h"
+#include "profile.h"
+#include <mutex>
+
+using namespace Search;
+using UCI::score2uci;
+
+namespace Excalibur
+{
+
+void init()
+{
+	static std::once_flag once;
+	std::call_once(once, []
+	{
+		Utils::init();
+		Board::init_tables();
+		UCI::init_options();
+		Eval::init();
+		Search::init();
+	});
+}
+
+Score to_score(Value v)
+{
+	Score score;
+	score.isMate = abs(v) >= VALUE_MATE_IN_MAX_PLY;
+	score.value = !score.isMate ? v * 100 / MG_PAWN
+		: (v > 0 ? VALUE_MATE - v + 1 : -VALUE_MATE - v) / 2;
+	return score;
+}
+
+struct Engine::Impl : public Thread
+{
+	Impl();
+	virtual void execute();
+	// The book, Search::run() and the UCI output around it
+	void think();
+	// Waits until the last search handed over is finished
+	void wait_idle();
+	void load_book();
+	InfoUpdate info(size_t line);
+	SearchResult result();
+
+	Context cx;
+	Transposition::Table tt;
+	Position pos;  // the current position, its moves played on 'states'
+	SetupStatePtr states;
+	map<string, int> options;  // play style options set by set_option()
+	bool warm;  // "Warm Requery"
+	bool useBook;
+	string bookFile;
+	// "Speculative Ponder": the replies to ponder on besides the predicted one,
+	// which is 'lastMove', played on 'parent'. See ponder.cpp
+	int replies;
+	Position parent;
+	Move lastMove;
+	volatile bool helpers;  // the Ponder helpers are ours
+
+	// Handed over under 'mutex'. True from analyze() until the promise is kept
+	volatile bool searching;
+	ConditionVar idleCond;
+	InfoCallback callback;
+	ResultCallback onResult;
+	std::promise<SearchResult> promise;
+};
+
+Engine::Impl::Impl() : states(new stack<StateInfo>()), warm(false), useBook(false),
+	replies(0), lastMove(MOVE_NULL), helpers(false), searching(false)
+{
+	cx.silent = true;
+	cx.tt = &tt;
+	cx.read_options();
+	cx.onIteration = [this]
+	{
+		if (callback)
+			for (size_t i = 0; i < min<size_t>(cx.multiPV, cx.rootMoveList.size()); i++)
+				callback(info(i));
+	};
+}
+
+void Engine::Impl::execute()
+{
+	bind_context(cx);
+	while (true)
+	{
+		mutex.lock();
+		while (!searching && exist)
+			sleepCond.wait(mutex);
+		mutex.unlock();
+		if (!exist)
+			return;
+
+		think();
+		SearchResult res = result();
+		if (onResult)
+			onResult(res);
+		promise.set_value(res);
+
+		mutex.lock();
+		searching = false;
+		idleCond.signal();
+		mutex.unlock();
+	}
+}
+
+void Engine::Impl::think()
+{
+	SearchStats::clear();
+	Profiler::clear();
+	U64 startCycles = Profiler::cycles();
+
+	// Allocated on this thread: the timer reads the limits of the bound context
+	cx.searchTime = now();
+	cx.completedDepth = 0;
+	if (cx.limit.use_timer())
+		cx.timer.talloc(cx.rootPos.turn, cx.rootPos.ply());
+
+	Move bookMv = MOVE_NULL;
+	vector<RootMove>::iterator Rmv;
+	// No legal moves available. Either we're checkmated, or stalemate.
+	if (cx.rootMoveList.empty())
+	{
+		cx.rootMoveList.push_back(MOVE_NULL);
+		if (!cx.silent)
+			sync_print("info depth 0 score "
+				<< score2uci(cx.rootPos.checker_map() ? -VALUE_MATE : VALUE_DRAW));
+	}
+	// A book move we are to consider is played at once
+	else if (useBook
+		&& cx.rootPos.st->cntInternalFiftyMove < 27
+		&& !cx.limit.infinite && !cx.limit.mateInX
+		&& (bookMv = Polyglot::probe(cx.rootPos)) != MOVE_NULL
+		&& (Rmv = std::find(cx.rootMoveList.begin(), cx.rootMoveList.end(), bookMv)) != cx.rootMoveList.end())
+		std::swap(cx.rootMoveList[0], *Rmv);
+	else
+		run();
+
+	if (!cx.silent)
+		sync_print("info nodes " << cx.rootPos.nodes << " time " << now() - cx.searchTime);
+	SearchStats::publish();
+	if (SearchStats::enabled() && !cx.silent)
+		sync_print("info string " << SearchStats::summary());
+	Profiler::publish(Profiler::cycles() - startCycles, cx.rootPos.nodes);
+	if (Profiler::enabled() && !cx.silent)
+		sync_print(Profiler::report());
+
+	// When we reach max depth we arrive here even without Signal.stop is raised,
+	// but if we are pondering or in infinite search, according to UCI protocol,
+	// we shouldn't report the best move until the GUI sends a "stop" or "ponderhit"
+	// command. We simply wait here until stop() or ponderhit() raises Signal.stop.
+	// Without legal moves there's nothing to wait for.
+	if (!cx.signal.stop && (cx.limit.ponder || cx.limit.infinite)
+		&& cx.rootMoveList[0].pv[0] != MOVE_NULL)
+	{
+		cx.signal.stopOnPonderhit = true;
+		wait_until(cx.signal.stop);
+	}
+}
+
+void Engine::Impl::wait_idle()
+{
+	mutex.lock();
+	while (searching)
+		idleCond.wait(mutex);
+	mutex.unlock();
+}
+
+// Also randomizes RKiss for the book variation
+void Engine::Impl::load_book()
+{
+	Polyglot::load(bookFile);
+	RKiss::init_seed(now() % 2000);
+}
+
+InfoUpdate Engine::Impl::info(size_t line)
+{
+	const RootMove& rm = cx.rootMoveList[line];
+	InfoUpdate info;
+	info.multiPV = int(line) + 1;
+	info.depth = cx.completedDepth;
+	info.score = to_score(rm.score);
+	info.nodes = cx.rootPos.nodes;
+	info.time = int(now() - cx.searchTime);
+	info.nps = info.nodes * 1000 / max(info.time, 1);
+	info.hashfull = tt.hashfull();
+	for (int i = 0; rm.pv[i] != MOVE_NULL; i++)
+		info.pv.push_back(UCI::move2uci(rm.pv[i]));
+	return info;
+}
+
+SearchResult Engine::Impl::result()
+{
+	const RootMove& rm = cx.rootMoveList[0];
+	SearchResult res;
+	res.bestMove = rm.pv[0] != MOVE_NULL ? UCI::move2uci(rm.pv[0]) : "";
+	res.ponderMove = rm.pv[0] != MOVE_NULL && rm.pv[1] != MOVE_NULL ? UCI::move2uci(rm.pv[1]) : "";
+	// A search stopped within its first iteration has no score
+	Value score = rm.score != -VALUE_INFINITE ? rm.score
+		: rm.pv[0] != MOVE_NULL ? VALUE_ZERO
+		: cx.rootPos.checker_map() ? -VALUE_MATE : VALUE_DRAW;
+	res.score = to_score(score);
+	res.depth = cx.completedDepth;
+	res.nodes = cx.rootPos.nodes;
+	res.time = int(now() - cx.searchTime);
+	for (int i = 0; rm.pv[i] != MOVE_NULL; i++)
+		res.pv.push_back(UCI::move2uci(rm.pv[i]));
+	return res;
+}
+
+
+Engine::Engine(int hashMB)
+{
+	init();
+	impl = new_thread<Impl>();
+	impl->tt.set_size(max(hashMB, 1));
+}
+
+Engine::~Engine()
+{
+	stop();
+	impl->wait_idle();
+	if (impl->helpers)
+		Ponder::end();
+	del_thread(impl);
+}
+
+bool Engine::set_position(const string& fen, const vector<string>& moves)
+{
+	UCI::EpdPosition epd;
+	if (!UCI::parse_epd(fen, epd))
+		return false;
+	// Check every move before we touch the current position
+	Position pos(epd.fen);
+	stack<StateInfo> states;
+	for (string mvstr : moves)
+	{
+		Move mv = UCI::uci2move(pos, mvstr);
+		if (mv == MOVE_NULL)
+			return false;
+		states.push(StateInfo());
+		pos.make_move(mv, states.top());
+	}
+
+	impl->wait_idle();
+	// The speculative ponder helpers search on the old states
+	if (impl->helpers)
+		Ponder::finish();
+	impl->pos.parse_fen(epd.fen);
+	impl->states = SetupStatePtr(new stack<StateInfo>());
+	impl->lastMove = MOVE_NULL;
+	for (string mvstr : moves)
+	{
+		Move mv = UCI::uci2move(impl->pos, mvstr);
+		impl->parent = impl->pos;
+		impl->lastMove = mv;
+		impl->states->push(StateInfo());
+		impl->pos.make_move(mv, impl->states->top());
+	}
+	return true;
+}
+
+bool Engine::set_option(const string& name, const string& value)
+{
+	if (name == "Warm Requery" || name == "Use Opening Book" || name == "Book Variation" || name == "UCI Info")
+	{
+		if (value != "true" && value != "false")
+			return false;
+		impl->wait_idle();
+		bool on = value == "true";
+		if (name == "Warm Requery")
+			impl->warm = on;
+		else if (name == "Book Variation")
+			Polyglot::AllowBookVariation = on;
+		else if (name == "UCI Info")
+			impl->cx.silent = !on;
+		else if ((impl->useBook = on))
+			impl->load_book();
+		return true;
+	}
+	if (name == "Book File")
+	{
+		if (value.empty())
+			return false;
+		impl->wait_idle();
+		impl->bookFile = value;
+		if (impl->useBook)
+			impl->load_book();
+		return true;
+	}
+	bool style = std::find(StyleOptions, StyleOptions + STYLE_OPTION_N, name) != StyleOptions + STYLE_OPTION_N;
+	if (!(style || name == "Hash" || name == "Speculative Ponder")
+			|| !is_int(!value.empty() && value[0] == '-' ? value.substr(1) : value)  // "Contempt Factor" can be negative
+			|| !UCI::OptMap[name].accepts(value))
+		return false;
+	impl->wait_idle();
+	if (name == "Hash")
+		impl->tt.set_size(str2int(value));
+	else if (name == "Speculative Ponder")
+		impl->replies = str2int(value);
+	else
+	{
+		impl->options[name] = str2int(value);
+		impl->cx.read_options(impl->options);
+	}
+	return true;
+}
+
+void Engine::new_game()
+{
+	impl->wait_idle();
+	impl->tt.clear();
+	impl->cx.history.clear();
+	impl->cx.gains.clear();
+	impl->cx.refutations.clear();
+	impl->cx.warmKey = 0;
+}
+
+std::future<SearchResult> Engine::analyze(const Limits& limits, InfoCallback callback, ResultCallback onResult)
+{
+	impl->wait_idle();
+	Context& cx = impl->cx;
+	// On a ponder miss, a speculative ponder helper might have searched the move played
+	bool adopted = impl->helpers && Ponder::adopt(impl->pos, cx);
+	impl->helpers = false;
+	cx.warm = adopted || impl->warm;
+	cx.multiPV = max(1, min(limits.multiPV, MAX_MULTI_PV));
+	cx.rootPos = impl->pos;
+	cx.rootMoveList.clear();
+	MoveBuffer mbuf;
+	ScoredMove *it, *end = cx.rootPos.gen_moves<LEGAL>(mbuf);
+	for (it = mbuf; it != end; ++it)
+	{
+		bool searched = limits.searchMoves.empty();
+		for (string mvstr : limits.searchMoves)
+			searched |= UCI::uci2move(cx.rootPos, mvstr) == it->move;
+		if (searched)
+			cx.rootMoveList.push_back(RootMove(it->move));
+	}
+
+	LimitListener& limit = cx.limit;
+	limit.clear();
+	limit.depth = min(limits.depth, MAX_PLY - 1);
+	limit.nodes = int(min<long long>(limits.nodes, INT_MAX));
+	limit.moveTime = limits.moveTime;
+	limit.mateInX = limits.mate;
+	for (Color c : COLORS)
+		limit.time[c] = limits.time[c], limit.increment[c] = limits.increment[c];
+	limit.movesToGo = limits.movesToGo;
+	limit.infinite = limits.infinite || !(limit.depth || limit.nodes || limit.moveTime || limit.mateInX
+		|| limit.time[W] || limit.time[B]);
+	limit.ponder = limits.ponder;
+	cx.signal.stopOnPonderhit = cx.signal.stop = false;
+
+	impl->callback = callback;
+	impl->onResult = onResult;
+	impl->promise = std::promise<SearchResult>();
+	std::future<SearchResult> future = impl->promise.get_future();
+	impl->mutex.lock();
+	impl->searching = true;
+	impl->sleepCond.signal();
+	impl->mutex.unlock();
+
+	// Ponder on the likely alternatives to the predicted reply too
+	if (limits.ponder && impl->replies && impl->lastMove != MOVE_NULL)
+	{
+		Ponder::start(impl->parent, impl->lastMove, impl->replies, &impl->tt);
+		impl->helpers = true;
+	}
+	return future;
+}
+
+void Engine::stop()
+{
+	impl->cx.signal.stop = true;
+	// A finished ponder or infinite search waits for the stop signal before
+	// it reports its best move, as required by UCI
+	impl->signal();
+	if (impl->helpers)
+		Ponder::stop();
+}
+
+// In case Signal.stopOnPonderhit is set we are
+// waiting for 'ponderhit' to stop the search (for instance because we
+// already ran out of time), otherwise we should continue searching but
+// switching from pondering to normal search.
+void Engine::ponderhit()
+{
+	if (impl->helpers)
+		Ponder::stop();
+	if (impl->cx.signal.stopOnPonderhit)
+		stop();
+	else
+		impl->cx.limit.ponder = false;
+}
+
+} // namespace Excalibur
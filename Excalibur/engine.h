@@ -0,0 +1,148 @@
+/*
+ *	libexcalibur: the engine as a library, without the UCI text protocol.
+ *	Build with 'make lib' (libexcalibur.a and the shared library).
+ *	This header only needs the standard library, so it can be installed alone.
+ *
+ *	Excalibur::init();
+ *	Excalibur::Engine engine;
+ *	engine.set_position(Excalibur::START_FEN, { "e2e4", "e7e5" });
+ *	Excalibur::Limits limits;
+ *	limits.depth = 12;
+ *	auto result = engine.analyze(limits, [](const Excalibur::InfoUpdate& info) { ... });
+ *	cout << result.get().bestMove;
+ *
+ *	Every Engine has its own search state, hash table and worker thread, so any
+ *	number of them can search side by side in one process.
+ *	The UCI executable is a front-end over one Engine: UCI::process() turns the
+ *	protocol into the calls below and prints what the engine reports.
+ */
+#ifndef __engine_h__
+#define __engine_h__
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <future>
+#include <memory>
+
+namespace Excalibur
+{
+	// Initializes the lookup tables and the default options. Call once before
+	// anything else. Later calls do nothing
+	void init();
+
+	const char * const START_FEN = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+	// The limits of one analysis, as in UCI 'go'. Without any, the search is infinite
+	// and runs until stop()
+	struct Limits
+	{
+		Limits() : depth(0), nodes(0), moveTime(0), mate(0), movesToGo(0),
+			multiPV(1), infinite(false), ponder(false)
+			{ time[0] = time[1] = increment[0] = increment[1] = 0; }
+
+		int depth;
+		long long nodes;
+		int moveTime;  // ms
+		int mate;  // find a mate in this many moves
+		int time[2], increment[2];  // ms, [white, black]: a game clock
+		int movesToGo;
+		std::vector<std::string> searchMoves;  // UCI moves. Empty for all moves
+		int multiPV;  // number of best lines to search and report, up to 32
+		// The result waits for stop(), even when the limits above are reached,
+		// unless there's no legal move
+		bool infinite;
+		// Pondering on the opponent's time: the clock doesn't run until ponderhit(),
+		// and the result waits for ponderhit() or stop()
+		bool ponder;
+	};
+
+	// A score from the side to move's point of view
+	struct Score
+	{
+		bool isMate;
+		// Centipawns, or moves to mate if isMate: negative if we're mated, 0 if mated now
+		int value;
+	};
+
+	// Progress of a search, sent after each completed iteration.
+	// A MultiPV search sends one for each line, best first
+	struct InfoUpdate
+	{
+		int multiPV;  // the rank of the line, 1 for the best
+		int depth;
+		Score score;
+		long long nodes;
+		int time;  // ms
+		long long nps;
+		int hashfull;  // permill
+		std::vector<std::string> pv;  // UCI moves
+	};
+
+	struct SearchResult
+	{
+		std::string bestMove;  // UCI. Empty if there's no legal move
+		std::string ponderMove;  // may be empty
+		Score score;
+		int depth;  // of the last completed iteration
+		long long nodes;
+		int time;  // ms
+		std::vector<std::string> pv;
+	};
+
+	// Called on the engine's own thread, so they must not block for long
+	typedef std::function<void(const InfoUpdate&)> InfoCallback;
+	typedef std::function<void(const SearchResult&)> ResultCallback;
+
+	class Engine
+	{
+	public:
+		explicit Engine(int hashMB = 16);
+		~Engine();  // stops the search and waits for it
+		Engine(const Engine&) = delete;
+		Engine& operator=(const Engine&) = delete;
+
+		// Sets the position from a FEN and a list of UCI moves played from it.
+		// False if the FEN or a move is invalid, then the position is unchanged
+		bool set_position(const std::string& fen, const std::vector<std::string>& moves = std::vector<std::string>());
+
+		// Sets one of the play style options: "Mobility", "Pawn Shield", "King Safety",
+		// "Aggressiveness", "Contempt Factor", "Power Level". Or "Hash" in MB.
+		// Or "Warm Requery", "true" or "false": analyses of the same position as
+		// the last one, e.g. with other searchMoves, resume from its depth.
+		// Or "Use Opening Book", "true" or "false": a book move is played without
+		// searching, except in infinite and mate searches. "Book File" is its path and
+		// "Book Variation" picks among the book moves at random. The book is loaded
+		// once per process, so all the engines that use it share the last one loaded.
+		// Or "Speculative Ponder", 0 to 8: a ponder search also ponders on that many
+		// other replies to the last move of the position, on threads of their own.
+		// They are shared by the process too: only one engine may use them.
+		// Or "UCI Info", "true" or "false": the engine prints its progress to cout
+		// as UCI 'info' lines, like the UCI executable does.
+		// False if the name or the value is invalid
+		bool set_option(const std::string& name, const std::string& value);
+
+		// Clears the hash table and the search history before an unrelated game
+		void new_game();
+
+		// Starts searching the current position on the engine's thread.
+		// The calls above and analyze() wait for the previous search to finish.
+		// 'onResult' gets the result as soon as the search ends, before the future,
+		// for callers that can't wait on it
+		std::future<SearchResult> analyze(const Limits& limits, InfoCallback callback = InfoCallback(),
+			ResultCallback onResult = ResultCallback());
+
+		// Ends the current search early. Its future still gets the best move so far
+		void stop();
+
+		// The opponent played the move a ponder search pondered on. The search goes on
+		// within its time limits, or ends at once if it has already used up its time
+		void ponderhit();
+
+	private:
+		struct Impl;
+		Impl *impl;
+	};
+}
+
+#endif // __engine_h__
@@ -3,6 +3,7 @@
 #include "pawnshield.h"
 #include "uci.h"
 #include "search.h"
+#include "profile.h"
 
 using namespace Board;
 
@@ -154,9 +155,9 @@ const Bit SpaceMask[] =
 };
 
 // King danger constants and variables. The king danger scores are taken
-// from the KingDanger[]. Various little "meta-bonuses" measuring
+// from the Eval::Weights kingDanger[]. Various little "meta-bonuses" measuring
 // the strength of the enemy attack are added up into an integer, which
-// is used as an index to KingDanger[].
+// is used as an index to kingDanger[].
 //
 // KingAttackWeights[PieceType] contains king attack weights by piece type
 const int KingAttackWeights[PIECE_TYPE_N] = { 0, 0, 2, 2, 3, 5 };
@@ -190,17 +191,17 @@ Score apply_weight(Score v, Score w)
 		(int(eg_value(v)) * eg_value(w)) / 0x100);
 }
 
-/* Evaluation weights that can be adjusted by UCI option */
+/* Evaluation weights that can be adjusted by UCI option, see Eval::Weights */
 enum EvalOptionType {Mobility, PawnShield, KingSafety, Aggressiveness};
-const Score WeightsDefault[] = 
-{ S(289, 344), S(233, 201), S(271, 0), S(307, 0) };
-Score Weights[4]; // will be determined by UCI option.
 
-// Options will be read from the global OptMap
-void set_weight_option(EvalOptionType opt, const string& name)
+// 'percent' of the default weight, as set by the UCI option
+Score option_weight(EvalOptionType opt, int percent)
 {
-	int val = UCI::OptMap[name] * 256 / 100;
-	Weights[opt] = apply_weight(make_score(val, val), WeightsDefault[opt]);
+	// Function static: contexts are constructed at program startup
+	static const Score WeightsDefault[] = 
+	{ S(289, 344), S(233, 201), S(271, 0), S(307, 0) };
+	int val = percent * 256 / 100;
+	return apply_weight(make_score(val, val), WeightsDefault[opt]);
 }
 
 #undef S
@@ -240,35 +241,32 @@ Value interpolate(const Score& v, Phase ph, ScaleFactor scalor)
 
 
 
-// KingDanger[Color][attackUnits] contains the actual king danger
-// weighted scores, indexed by color and by a calculated integer number.
-// filled out in Eval::init()
-Score KingDanger[COLOR_N][128];
-
 namespace Eval
 {
-	// initialize KingDanger table
 	void init() 
 	{
 		// Initialize Endgame evalFunc's and scalingFunc's tables
 		Endgame::init();
+	}
 
-		// Read UCI options from the global OptMap that sets the evaluation weights
-		set_weight_option(Mobility, "Mobility");
-		set_weight_option(PawnShield, "Pawn Shield");
-		set_weight_option(KingSafety, "King Safety");
-		set_weight_option(Aggressiveness, "Aggressiveness");
+	// Scales the default weights by the options, and fills the KingDanger table
+	void Weights::set(int mobilityPct, int pawnShieldPct, int kingSafetyPct, int aggressivenessPct)
+	{
+		mobility = option_weight(Mobility, mobilityPct);
+		pawnShield = option_weight(PawnShield, pawnShieldPct);
+		Score ourKing = option_weight(KingSafety, kingSafetyPct);
+		Score theirKing = option_weight(Aggressiveness, aggressivenessPct);
 
-		// Init KingDanger table
 		const int MaxSlope = 30;
 		const int Peak = 1280;
 
+		kingDanger[0][0] = kingDanger[1][0] = SCORE_ZERO;
 		for (int t = 0, i = 1; i < 100; i++)
 		{
 			t = min(Peak, min(int(0.4 * i * i), t + MaxSlope));
 
-			KingDanger[1][i] = apply_weight(make_score(t, 0), Weights[KingSafety]);
-			KingDanger[0][i] = apply_weight(make_score(t, 0), Weights[Aggressiveness]);
+			kingDanger[1][i] = apply_weight(make_score(t, 0), ourKing);
+			kingDanger[0][i] = apply_weight(make_score(t, 0), theirKing);
 		}
 	}
 
@@ -277,6 +275,7 @@ namespace Eval
 	/// between them based on the remaining material.
 	Value evaluate(const Position& pos, Value& margin)
 	{
+		PROFILE_SCOPE(EVALUATE);
 		EvalInfo ei;
 		Value margins[COLOR_N];
 		Score score, mobility[COLOR_N];
@@ -304,7 +303,7 @@ namespace Eval
 
 		// Probe the pawn hash table
 		ei.pi = Pawnshield::probe(pos);
-		score += apply_weight(ei.pi->pawnshield_score(), Weights[PawnShield]);
+		score += apply_weight(ei.pi->pawnshield_score(), Search::Ctx->evalWeights.pawnShield);
 
 		// Initialize attack and king safety bitboards
 		init_eval_info<W>(pos, ei);
@@ -314,7 +313,7 @@ namespace Eval
 		score +=  evaluate_pieces_of_color<W>(pos, ei, mobility[W])
 			- evaluate_pieces_of_color<B>(pos, ei, mobility[B]);
 
-		score += apply_weight(mobility[W] - mobility[B], Weights[Mobility]);
+		score += apply_weight(mobility[W] - mobility[B], Search::Ctx->evalWeights.mobility);
 
 		// Evaluate kings after all other pieces because we need complete attack
 		// information when computing the king safety evaluation.
@@ -394,6 +393,7 @@ namespace Eval
 	/// q2r2q1/1B2nb2/2prpn2/1rkP1QRR/2P1Pn2/4Nb2/B2R4/3R1K2 b - - 0 1
 	Value see(const Position& pos, Move& m, Value asymmThresh /* =0 */ )
 	{
+		PROFILE_SCOPE(SEE);
 		// ignore castling
 		if (is_castle(m)) return 0;
 
@@ -401,8 +401,8 @@ namespace Eval
 		Value swapList[32], idx = 1;
 		Square from = get_from(m);
 		Square to = get_to(m);
-		swapList[0] = PIECE_VALUE[MG][pos.boardPiece[to]];
-		Color us = pos.boardColor[from];
+		swapList[0] = PIECE_VALUE[MG][pos.piece_on(to)];
+		Color us = pos.color_on(from);
 		occ = pos.Occupied ^ setbit(from);
 
 		if (is_ep(m))
@@ -427,7 +427,7 @@ namespace Eval
 		// destination square, where the sides alternately capture, and always
 		// capture with the least valuable piece. After each capture, we look for
 		// new X-ray attacks from behind the capturing piece.
-		PieceType capt = pos.boardPiece[from];
+		PieceType capt = pos.piece_on(from);
 
 		do
 		{
@@ -546,7 +546,7 @@ Score evaluate_pieces(const Position& pos, EvalInfo& ei, Score& mobility, Bit mo
 	Square sq;
 	Score score = SCORE_ZERO;
 
-	const Square* plist = pos.pieceList[us][PT];
+	const byte* plist = pos.pieceList[us][PT];
 
 	ei.attackedBy[us][PT] = 0;
 
@@ -663,7 +663,7 @@ Score evaluate_pieces_of_color(const Position& pos, EvalInfo& ei, Score& mobilit
 	| ei.attackedBy[us][BISHOP] | ei.attackedBy[us][ROOK]
 	| ei.attackedBy[us][QUEEN]  | ei.attackedBy[us][KING];
 	
-	DBG_MSG("Mobility " << C(us), apply_weight(mobility, Weights[Mobility]));
+	DBG_MSG("Mobility " << C(us), apply_weight(mobility, Search::Ctx->evalWeights.mobility));
 	return score;
 }
 
@@ -694,7 +694,7 @@ Score evaluate_king(const Position& pos, EvalInfo& ei, Value margins[])
 		| ei.attackedBy[us][QUEEN]);
 
 		// Initialize the 'attackUnits' variable, which is used later on as an
-		// index to the KingDanger[] array. The initial value is based on the
+		// index to the kingDanger[] array. The initial value is based on the
 		// number and types of the enemy's attacking pieces, the number of
 		// attacked and undefended squares around our king, the square of the
 		// king, and the quality of the pawn shelter.
@@ -761,16 +761,17 @@ Score evaluate_king(const Position& pos, EvalInfo& ei, Value margins[])
 		if (battack)
 			attackUnits += KnightCheck * bit_count(battack);
 
-		// To index KingDanger[] attackUnits must be in [0, 99] range
+		// To index kingDanger[] attackUnits must be in [0, 99] range
 		attackUnits = min(99, max(0, attackUnits));
 
-		// Finally, extract the king danger score from the KingDanger[]
+		// Finally, extract the king danger score from the kingDanger[]
 		// array and subtract the score from evaluation. Set also margins[]
 		// value that will be used for pruning because this value can sometimes
 		// be very big, and so capturing a single attacking piece can therefore
 		// result in a score change far bigger than the value of the captured piece.
-		score -= KingDanger[us == Search::RootColor][attackUnits];
-		margins[us] += mg_value(KingDanger[us == Search::RootColor][attackUnits]);
+		const Score& danger = Search::Ctx->evalWeights.kingDanger[us == Search::Ctx->rootColor][attackUnits];
+		score -= danger;
+		margins[us] += mg_value(danger);
 	}
 
 	DBG_MSG("King " << C(us), score);
@@ -853,7 +854,7 @@ Score evaluate_passed_pawns(const Position& pos, EvalInfo& ei)
 				ebonus -= sq_distance(pos.king_sq(us), forward_sq(us, blockSq)) * rr;
 
 			// If the pawn is free to advance, increase bonus
-			if (pos.boardPiece[blockSq] == NON)
+			if (pos.piece_on(blockSq) == NON)
 			{
 				squaresToQueen = forward_mask(us, sq);
 				defendedSquares = squaresToQueen & ei.attackedBy[us][ALL_PT];
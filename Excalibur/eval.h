@@ -11,6 +11,19 @@ namespace Eval
 	// contains Endgame::init() and KPKbase::init()
 	void init();
 
+	/// The evaluation weights set by the UCI options "Mobility", "Pawn Shield",
+	/// "King Safety" and "Aggressiveness". Every Search::Context has its own,
+	/// so that two engines with different styles can play in one process.
+	struct Weights
+	{
+		// in percent of the default weights
+		void set(int mobility, int pawnShield, int kingSafety, int aggressiveness);
+
+		Score mobility, pawnShield;
+		// [us == rootColor][attackUnits]: our king safety, their king aggressiveness
+		Score kingDanger[COLOR_N][100];
+	};
+
 	// margin stores the uncertainty estimation of position's evaluation
 	// that typically is used by the search for pruning decisions.
 	Value evaluate(const Position& pos, Value& margin);
@@ -29,8 +42,8 @@ namespace Eval
 		// Early return if SEE cannot be negative because captured piece value
 		// is not less then capturing one. Note that king moves always return
 		// here because king midgame value is set to 0.
-		if (PIECE_VALUE[MG][pos.boardPiece[get_from(m)]] 
-				<= PIECE_VALUE[MG][pos.boardPiece[get_to(m)]])
+		if (PIECE_VALUE[MG][pos.piece_on(get_from(m))] 
+				<= PIECE_VALUE[MG][pos.piece_on(get_to(m))])
 			return 1;
 		return see(pos, m);  // only cares about positive or negative
 	}
@@ -0,0 +1,383 @@
+/*
+ *	Training data. Syntax:
+ *	gensfen <out> --depth D|--nodes N [--positions N] [--threads N] [--random N] [--openings file] [--seed S]
+ *	gensfen read <file> [count] [skip]
+ *	gensfen shuffle <in> <out> [--seed S] [--memory MB]
+ *	Worker threads play self-play games from randomised openings, each one in its
+ *	own Search::Context. Every searched position becomes a fixed-size TrainingRecord,
+ *	labelled with the game result once the game is over, and appended to the file.
+ *	The shuffler scatters the records into temporary buckets that fit in memory,
+ *	so it works on files of any size.
+ */
+#include "search.h"
+#include "packedpos.h"
+#include "uci.h"
+#include "thread.h"
+#include <thread>
+#include <random>
+
+using namespace Search;
+
+namespace Gensfen
+{
+
+// A side with a score beyond EvalLimit centipawns is adjudicated the winner
+const int EvalLimit = 3000;
+const int MaxGamePly = 400;  // then it's a draw
+const Msec ReportInterval = 10000;
+
+vector<string> Openings;  // empty for the start position
+int RandomPlies;
+U64 Target;  // positions to write
+LimitListener Limits;
+U64 Seed;
+
+// Written under WriteLock
+Mutex WriteLock;
+Packed::Writer<TrainingRecord> *Out;
+std::atomic<U64> Written, Games;
+U64 StartTime, LastReport;
+int ThreadCnt, WorkerCnt;
+
+string report()
+{
+	Msec time = max<Msec>(now() - StartTime, 1);
+	ostringstream oss;
+	oss << fixed << setprecision(0) << "info string gensfen: " << Written << " positions, "
+		<< Games << " games, " << Written * 1000.0 / time << " positions/s, "
+		<< Written * 1000.0 / time / ThreadCnt << " per thread";
+	return oss.str();
+}
+
+struct GenWorker : public Thread
+{
+	GenWorker();
+	virtual void execute();
+	// Plays one game into 'records'. False if the opening is already over
+	bool play(vector<TrainingRecord>& records);
+
+	Context cx;
+	std::mt19937_64 rng;
+	vector<StateInfo> states;  // one per ply of the game, random opening included
+};
+
+GenWorker::GenWorker() : rng(Seed + WorkerCnt++)
+{
+	cx.silent = true;
+	cx.read_options();
+}
+
+void GenWorker::execute()
+{
+	bind_context(cx);
+	vector<TrainingRecord> records;
+	while (Written < Target)
+	{
+		records.clear();
+		if (!play(records))
+			continue;
+
+		WriteLock.lock();
+		Out->write(records.data(), records.size());
+		Written += records.size();
+		Games ++;
+		if (now() - LastReport >= ReportInterval)
+		{
+			LastReport = now();
+			sync_print(report());
+		}
+		WriteLock.unlock();
+	}
+}
+
+bool GenWorker::play(vector<TrainingRecord>& records)
+{
+	Position pos(Openings.empty() ? FEN_START : Openings[rng() % Openings.size()]);
+	int ply = 0;
+	states.resize(RandomPlies + MaxGamePly + 1);
+	MoveBuffer mbuf;
+	ScoredMove *end;
+
+	// Random opening moves
+	for (; ply < RandomPlies; ply++)
+	{
+		end = pos.gen_moves<LEGAL>(mbuf);
+		if (end == mbuf)
+			return false;
+		pos.make_move(mbuf[rng() % (end - mbuf)].move, states[ply]);
+	}
+
+	int result;  // for white: 1 win, 0 draw, -1 loss
+	for (; ; ply++)
+	{
+		end = pos.gen_moves<LEGAL>(mbuf);
+		if (end == mbuf)
+		{
+			result = !pos.checker_map() ? 0 : pos.turn == W ? -1 : 1;
+			break;
+		}
+		if (pos.is_draw<true>() || ply - RandomPlies >= MaxGamePly)
+		{
+			result = 0;
+			break;
+		}
+
+		// The copy keeps the st_prev chain into 'states', so the search sees repetitions
+		cx.rootPos = pos;
+		cx.rootMoveList.clear();
+		for (ScoredMove *it = mbuf; it != end; ++it)
+			cx.rootMoveList.push_back(RootMove(it->move));
+		cx.limit = Limits;
+		cx.signal.stopOnPonderhit = cx.signal.stop = false;
+		cx.searchTime = now();
+		run();
+
+		const RootMove& rm = cx.rootMoveList[0];
+		TrainingRecord rec;
+		pos.encode(rec.pos);
+		rec.pos.payload = 0;
+		rec.score = short(rm.score == -VALUE_INFINITE ? VALUE_ZERO : rm.score);
+		rec.move = rm.pv[0];
+		rec.ply = ushort(pos.ply());
+		rec.result = 0;
+		rec.reserved = 0;
+		records.push_back(rec);
+
+		if (rm.score != -VALUE_INFINITE && abs(rm.score) >= EvalLimit * MG_PAWN / 100)
+		{
+			result = (rm.score > 0) == (pos.turn == W) ? 1 : -1;
+			break;
+		}
+		Move mv = rm.pv[0];
+		pos.make_move(mv, states[ply]);
+	}
+
+	for (TrainingRecord& rec : records)
+		rec.result = (rec.pos.flags & 1) == W ? result : -result;
+	return true;
+}
+
+// Random permutation of a file too large for memory: scatter into buckets
+// of about half the budget, then shuffle each bucket in memory
+string shuffle(string inPath, string outPath, U64 seed, U64 memoryMB)
+{
+	typedef TrainingRecord Rec;
+	U64 startTime = now();
+	std::mt19937_64 rng(seed);
+	U64 total;
+	try
+	{
+		Packed::Reader<Rec> in(inPath);
+		total = in.size();
+		U64 perBucket = max<U64>((memoryMB << 20) / sizeof(Rec), 1);
+		U64 buckets = total <= perBucket ? 1 : 2 * ((total + perBucket - 1) / perBucket);
+		vector<Rec> recs;
+
+		if (buckets == 1)
+		{
+			Packed::load(inPath, recs);
+			std::shuffle(recs.begin(), recs.end(), rng);
+			Packed::save(outPath, recs);
+		}
+		else
+		{
+			vector<Packed::Writer<Rec> *> parts;
+			for (U64 b = 0; b < buckets; b++)
+				parts.push_back(new Packed::Writer<Rec>(outPath + ".part" + int2str(int(b))));
+			recs.resize(4096);
+			for (size_t n; (n = in.read(recs.data(), recs.size())) > 0; )
+				for (size_t i = 0; i < n; i++)
+					parts[rng() % buckets]->write(recs[i]);
+			for (auto part : parts)
+				delete part;
+
+			Packed::Writer<Rec> out(outPath);
+			for (U64 b = 0; b < buckets; b++)
+			{
+				string partPath = outPath + ".part" + int2str(int(b));
+				Packed::load(partPath, recs);
+				std::shuffle(recs.begin(), recs.end(), rng);
+				out.write(recs.data(), recs.size());
+				remove(partPath.c_str());
+			}
+		}
+	}
+	catch (FileNotFoundException& e)
+	{
+		return e.what();
+	}
+	ostringstream oss;
+	oss << "gensfen: shuffled " << total << " positions into " << outPath
+		<< " in " << (now() - startTime) / 1000.0 << " s";
+	return oss.str();
+}
+
+// One line per record: FEN, best move, score, ply and result for the side to move
+string read(string path, U64 count, U64 skip)
+{
+	try
+	{
+		Packed::Reader<TrainingRecord> in(path);
+		in.skip(skip);
+		TrainingRecord rec;
+		Position pos;
+		for (U64 i = 0; i < count && in.read(rec); i++)
+		{
+			if (!pos.decode(rec.pos))
+			{
+				ostringstream oss;
+				oss << "gensfen: " << path << " has a malformed record at " << skip + i;
+				return oss.str();
+			}
+			sync_print(pos.to_fen() << " | " << UCI::move2uci(rec.move) << " | "
+				<< UCI::score2uci(rec.score) << " | ply " << rec.ply << " | result " << int(rec.result));
+		}
+		ostringstream oss;
+		oss << "gensfen: " << path << " has " << in.size() << " positions";
+		return oss.str();
+	}
+	catch (FileNotFoundException& e)
+	{
+		return e.what();
+	}
+}
+
+} // namespace Gensfen
+
+
+namespace UCI
+{
+
+int gensfen(istream& args)
+{
+	using namespace Gensfen;
+	const string usage = "Usage: gensfen <out> --depth D|--nodes N [--positions N] [--threads N]"
+		" [--random N] [--openings file] [--seed S]\n"
+		"       gensfen read <file> [count] [skip]\n"
+		"       gensfen shuffle <in> <out> [--seed S] [--memory MB]";
+	string outPath, opt, val, openPath;
+	args >> outPath;
+	if (outPath == "read" || outPath == "shuffle")
+	{
+		string path, outPath2, count, skip;
+		args >> path;
+		if (outPath == "read")
+		{
+			args >> count >> skip;
+			if (path.empty() || (!count.empty() && !is_int(count)) || (!skip.empty() && !is_int(skip)))
+			{
+				sync_print(usage);
+				return 1;
+			}
+			string msg = read(path, count.empty() ? 10 : stoull(count), skip.empty() ? 0 : stoull(skip));
+			sync_print("info string " << msg);
+			return msg.compare(0, 9, "gensfen: ") == 0 ? 0 : 1;
+		}
+		args >> outPath2;
+		U64 seed = now(), memoryMB = 1024;
+		bool ok = !path.empty() && !outPath2.empty();
+		while (ok && args >> opt)
+		{
+			ok = args >> val && is_int(val);
+			if (!ok)  break;
+			if (opt == "--seed")  seed = stoull(val);
+			else if (opt == "--memory")  memoryMB = max(1ull, stoull(val));
+			else  ok = false;
+		}
+		if (!ok)
+		{
+			sync_print(usage);
+			return 1;
+		}
+		string msg = shuffle(path, outPath2, seed, memoryMB);
+		sync_print("info string " << msg);
+		return msg.compare(0, 9, "gensfen: ") == 0 ? 0 : 1;
+	}
+
+	int threads = 0;
+	LimitListener limit;
+	limit.clear();
+	Target = 1000000;
+	RandomPlies = 8;
+	Seed = now();
+	bool ok = !outPath.empty() && outPath.compare(0, 2, "--") != 0;
+	while (ok && args >> opt)
+	{
+		ok = bool(args >> val);
+		if (!ok)  break;
+		if (opt == "--openings")
+			openPath = val;
+		else if (!is_int(val))
+			ok = false;
+		else if (opt == "--random")  RandomPlies = min(str2int(val), MaxGamePly);
+		else if (opt == "--seed")  Seed = stoull(val);
+		else if (str2int(val) < 1)  ok = false;
+		else if (opt == "--positions")  Target = stoull(val);
+		else if (opt == "--threads")  threads = str2int(val);
+		else if (opt == "--depth")  limit.depth = min(str2int(val), MAX_PLY - 1);
+		else if (opt == "--nodes")  limit.nodes = str2int(val);
+		else
+			ok = false;
+	}
+	if (!ok || !(limit.depth || limit.nodes))
+	{
+		sync_print(usage);
+		return 1;
+	}
+
+	Openings.clear();
+	if (!openPath.empty())
+	{
+		ifstream fin(openPath);
+		if (!fin.is_open())
+		{
+			sync_print("info string cannot open " + openPath);
+			return 1;
+		}
+		string line;
+		for (int n = 1; getline(fin, line); n++)
+		{
+			if (!line.empty() && line.back() == '\r')
+				line.pop_back();
+			if (line.find_first_not_of(" \t") == string::npos || line[0] == '#')
+				continue;
+			EpdPosition epd;
+			if (!parse_epd(line, epd))
+			{
+				sync_print("info string bad opening at line " << n);
+				return 1;
+			}
+			Openings.push_back(epd.fen);
+		}
+	}
+
+	try { Out = new Packed::Writer<TrainingRecord>(outPath, true); }
+	catch (FileNotFoundException&)
+	{
+		sync_print("info string cannot write " + outPath);
+		return 1;
+	}
+
+	if (threads < 1)  // all cores
+		threads = max(1u, std::thread::hardware_concurrency());
+	ThreadCnt = threads;
+	Limits = limit;
+	Written = Games = 0;
+	WorkerCnt = 0;
+	StartTime = LastReport = now();
+	// The TT of the workers is only allocated when needed, see Search::init()
+	Transposition::TT.set_size(OptMap["Hash"]);
+
+	vector<GenWorker *> workers;
+	for (int i = 0; i < threads; i++)
+		workers.push_back(new_thread<GenWorker>());
+	// The workers exit by themselves once the target is reached
+	for (GenWorker *w : workers)
+		del_thread(w);
+	delete Out;
+
+	sync_print(report() << " on " << threads << " threads, appended to " << outPath);
+	return 0;
+}
+
+} // namespace UCI
@@ -224,6 +224,13 @@ DEF_OPERATOR(PieceType);
 #  define INLINE  inline
 #endif
 
+// Thread local storage. VC++ only supports thread_local from VS2015 on
+#ifdef _MSC_VER
+#  define THREAD_LOCAL  __declspec(thread)
+#else
+#  define THREAD_LOCAL  thread_local
+#endif
+
 // Suppress noisy VC++ compiler warning
 #ifdef _MSC_VER
 #pragma warning (disable : 4996) // time.. struct usafe
@@ -261,6 +268,7 @@ class HashTable
 {
 public:
 	HashTable(): data(Size, T()) {}
+	static const size_t Bytes = Size * sizeof(T);  // memory of one table
 	T* operator[](U64 key) { return &data[(uint)key & (Size - 1)]; }
 
 private:
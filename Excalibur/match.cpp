@@ -0,0 +1,454 @@
+/*
+ *	Engine match between two sets of UCI options. Syntax:
+ *	match <openings|startpos> [--games N] [--threads N] --depth D|--nodes N|--movetime T|--tc base+inc
+ *		[--first Name=Value ...] [--second Name=Value ...] [--sprt elo0 elo1] [--pgn file]
+ *	Every opening is played twice, with colors reversed. A game is played by one
+ *	worker thread that owns a Search::Context and a TT for each side, so the two
+ *	engines and the games running side by side share no search state.
+ *	The result is reported as Elo, and with --sprt as a log-likelihood ratio.
+ */
+#include "search.h"
+#include "uci.h"
+#include "thread.h"
+#include <thread>
+
+using namespace Search;
+
+namespace Match
+{
+
+// Adjudication. A side resigns when both engines agree for ResignMoves
+// moves each that it is down ResignScore centipawns. A game is drawn
+// after DrawMoveNumber if both scores stay within DrawScore for DrawMoves moves each.
+const int ResignMoves = 3;
+const int ResignScore = 1000;
+const int DrawMoveNumber = 40;
+const int DrawMoves = 8;
+const int DrawScore = 10;
+const int MaxGamePly = 1000;  // then it's a draw
+const int TT_MB = 16;  // per side and worker
+
+// SPRT error rates, alpha = beta
+const double SprtAlpha = 0.05;
+
+vector<string> Openings;
+int GameCnt;
+std::atomic<int> NextGame;
+std::atomic<bool> Stop;  // the SPRT has decided
+LimitListener Limits;
+Msec TcBase, TcInc;  // --tc, or 0
+map<string, int> Options[2];  // of the first and the second engine
+bool Sprt;
+double Elo0, Elo1;
+
+// Results from the first engine's point of view. Updated under ResultLock
+Mutex ResultLock;
+int Wins, Draws, Losses, Adjudicated, Finished;
+ofstream PgnFile;
+
+struct Game
+{
+	int result;  // from white's point of view: 2 win, 1 draw, 0 loss
+	string reason;
+	string moves;  // SAN movetext
+	bool adjudicated;
+};
+
+/* Statistics of a W/D/L record */
+double elo(double score) { return 400 * log10(score / (1 - score)); }
+
+// Mean score and the variance of one game's score
+void score_variance(int w, int d, int l, double& score, double& var)
+{
+	double n = w + d + l;
+	score = (w + d / 2.0) / n;
+	var = (w + d / 4.0) / n - score * score;
+}
+
+// Log-likelihood ratio of elo1 against elo0, with the normal approximation
+// of the score distribution
+double llr(int w, int d, int l, double elo0, double elo1)
+{
+	if (w + d + l == 0)  return 0;
+	double score, var;
+	score_variance(w, d, l, score, var);
+	if (var <= 0)  return 0;
+	double s0 = 1 / (1 + pow(10, -elo0 / 400)), s1 = 1 / (1 + pow(10, -elo1 / 400));
+	return (s1 - s0) * (2 * score - s0 - s1) / (2 * var / (w + d + l));
+}
+
+string report(int w, int d, int l)
+{
+	int n = w + d + l;
+	ostringstream oss;
+	oss << fixed << setprecision(1) << "info string match: " << n << " games, +"
+		<< w << " =" << d << " -" << l;
+	if (n == 0)
+		return oss.str();
+	double score, var;
+	score_variance(w, d, l, score, var);
+	// Clamped, so that a clean sweep reports a large but finite Elo
+	double sc = min(max(score, 0.001), 0.999);
+	double margin = 1.96 * sqrt(var / n);
+	double low = elo(min(max(sc - margin, 0.001), 0.999)), high = elo(min(max(sc + margin, 0.001), 0.999));
+	oss << ", score " << score * 100 << "%, elo " << showpos << elo(sc)
+		<< noshowpos << " +/- " << (high - low) / 2;
+	if (w + l)
+		oss << ", los " << 50 * (1 + erf((w - l) / sqrt(2.0 * (w + l)))) << "%";
+	if (Sprt)
+	{
+		double lower = log(SprtAlpha / (1 - SprtAlpha)), upper = -lower;
+		double ratio = llr(w, d, l, Elo0, Elo1);
+		oss << setprecision(2) << ", llr " << ratio << " (" << lower << ", " << upper << ") ["
+			<< setprecision(1) << Elo0 << ", " << Elo1 << "]";
+		if (ratio >= upper)  oss << " H1 accepted";
+		else if (ratio <= lower)  oss << " H0 accepted";
+	}
+	return oss.str();
+}
+
+// The side of the game: one engine
+struct Side
+{
+	Context cx;
+	Transposition::Table tt;
+};
+
+struct MatchWorker : public Thread
+{
+	MatchWorker();
+	virtual void execute();
+	Game play(int idx);
+	Move think(Side& side, const Position& pos, Msec clock[], Value& score);
+
+	Side sides[2];  // first, second
+	vector<StateInfo> states;
+};
+
+MatchWorker::MatchWorker() : states(MaxGamePly)
+{
+	for (int i = 0; i < 2; i++)
+	{
+		sides[i].cx.silent = true;
+		sides[i].cx.read_options(Options[i]);
+		sides[i].tt.set_size(TT_MB);
+		sides[i].cx.tt = &sides[i].tt;
+	}
+}
+
+// Searches one move. 'score' is from the side to move's point of view
+Move MatchWorker::think(Side& side, const Position& pos, Msec clock[], Value& score)
+{
+	Context& cx = side.cx;
+	bind_context(cx);
+	// The copy keeps the st_prev chain into 'states', so the search sees repetitions
+	cx.rootPos = pos;
+	cx.rootMoveList.clear();
+	MoveBuffer mbuf;
+	ScoredMove *it, *end = cx.rootPos.gen_moves<LEGAL>(mbuf);
+	for (it = mbuf; it != end; ++it)
+		cx.rootMoveList.push_back(RootMove(it->move));
+	cx.limit = Limits;
+	if (TcBase)
+		for (Color c : COLORS)
+			cx.limit.time[c] = max<Msec>(clock[c], 1), cx.limit.increment[c] = TcInc;
+	cx.signal.stopOnPonderhit = cx.signal.stop = false;
+	cx.searchTime = now();
+	if (cx.limit.use_timer())
+		cx.timer.talloc(pos.turn, pos.ply());
+
+	run();
+
+	score = cx.rootMoveList[0].score;
+	return cx.rootMoveList[0].pv[0];
+}
+
+Game MatchWorker::play(int idx)
+{
+	Game game;
+	game.adjudicated = false;
+	bool firstWhite = idx % 2 == 0;
+	Position pos(Openings[idx / 2 % Openings.size()]);
+	for (Side& side : sides)
+		side.tt.clear();
+	Msec clock[COLOR_N] = { TcBase, TcBase };
+	int resignStreak = 0, drawStreak = 0;  // in plies
+	int lastSign = 0;
+
+	for (int ply = 0; ; ply++)
+	{
+		if (pos.count_legal() == 0)
+		{
+			bool mate = pos.checker_map() != 0;
+			game.result = !mate ? 1 : pos.turn == W ? 0 : 2;
+			game.reason = mate ? "checkmate" : "stalemate";
+			break;
+		}
+		if (pos.is_draw<true>())
+		{
+			game.result = 1;
+			game.reason = pos.st->cntFiftyMove >= 100 ? "fifty moves"
+				: pos.piece_union(PAWN) || pos.non_pawn_material(W) + pos.non_pawn_material(B) > MG_BISHOP ?
+					"3-fold repetition"
+				: "insufficient material";
+			break;
+		}
+		if (ply == MaxGamePly)
+		{
+			game.result = 1;
+			game.reason = "maximum length";
+			game.adjudicated = true;
+			break;
+		}
+
+		Color us = pos.turn;
+		Value score;
+		Msec start = now();
+		Move mv = think(sides[(us == W) != firstWhite], pos, clock, score);
+		if (TcBase)
+		{
+			clock[us] -= now() - start;
+			if (clock[us] < 0)
+			{
+				game.result = us == W ? 0 : 2;
+				game.reason = string(us == W ? "white" : "black") + " loses on time";
+				break;
+			}
+			clock[us] += TcInc;
+		}
+
+		// A search stopped in its first iteration has no score, and breaks the streaks
+		bool scored = score != -VALUE_INFINITE;
+		int cp = abs(score) >= VALUE_MATE_IN_MAX_PLY ? (score > 0 ? 100000 : -100000)
+			: score * 100 / MG_PAWN;
+		if (us == B)  cp = -cp;  // white's point of view
+		int sign = !scored ? 0 : cp >= ResignScore ? 1 : cp <= -ResignScore ? -1 : 0;
+		resignStreak = sign && sign == lastSign ? resignStreak + 1 : sign ? 1 : 0;
+		lastSign = sign;
+		drawStreak = scored && abs(cp) <= DrawScore ? drawStreak + 1 : 0;
+
+		ostringstream oss;
+		if (us == W || ply == 0)
+			oss << pos.ply() / 2 + 1 << (us == W ? ". " : "... ");
+		oss << UCI::move2san(pos, mv) << " ";
+		game.moves += oss.str();
+		pos.make_move(mv, states[ply]);
+
+		if (lastSign && resignStreak >= 2 * ResignMoves)
+		{
+			game.result = lastSign > 0 ? 2 : 0;
+			game.reason = string(lastSign > 0 ? "black" : "white") + " resigns";
+			game.adjudicated = true;
+			break;
+		}
+		if (ply + 1 >= 2 * DrawMoveNumber && drawStreak >= 2 * DrawMoves)
+		{
+			game.result = 1;
+			game.reason = "draw by adjudication";
+			game.adjudicated = true;
+			break;
+		}
+	}
+	return game;
+}
+
+void finish(int idx, const Game& game)
+{
+	bool firstWhite = idx % 2 == 0;
+	int result = firstWhite ? game.result : 2 - game.result;
+	ResultLock.lock();
+	(result == 2 ? Wins : result == 1 ? Draws : Losses) ++;
+	Adjudicated += game.adjudicated;
+	if (PgnFile.is_open())
+	{
+		const char *resultStr[] = { "0-1", "1/2-1/2", "1-0" };
+		PgnFile << "[Event \"Excalibur match\"]\n[Round \"" << idx + 1 << "\"]\n"
+			<< "[White \"" << (firstWhite ? "first" : "second") << "\"]\n"
+			<< "[Black \"" << (firstWhite ? "second" : "first") << "\"]\n"
+			<< "[Result \"" << resultStr[game.result] << "\"]\n"
+			<< "[FEN \"" << Openings[idx / 2 % Openings.size()] << "\"]\n[SetUp \"1\"]\n\n"
+			<< game.moves << "{" << game.reason << "} " << resultStr[game.result] << "\n\n";
+	}
+	if (++Finished % 10 == 0 && Finished < GameCnt)
+		sync_print(report(Wins, Draws, Losses));
+	if (Sprt)
+	{
+		double ratio = llr(Wins, Draws, Losses, Elo0, Elo1);
+		if (abs(ratio) >= log((1 - SprtAlpha) / SprtAlpha))
+			Stop = true;
+	}
+	ResultLock.unlock();
+}
+
+void MatchWorker::execute()
+{
+	for (int i; !Stop && (i = NextGame++) < GameCnt; )
+		finish(i, play(i));
+}
+
+// Reads "Name=Value" pairs until the next "--" flag. Names may have spaces: "King Safety=80"
+bool parse_options(istream& args, map<string, int>& options, string& next)
+{
+	string name, tok;
+	next.clear();
+	while (args >> tok)
+	{
+		if (tok.compare(0, 2, "--") == 0)
+		{
+			next = tok;
+			break;
+		}
+		size_t eq = tok.find('=');
+		name += (name.empty() ? "" : " ") + tok.substr(0, eq);
+		if (eq == string::npos)
+			continue;
+		string val = tok.substr(eq + 1);
+		// A side can set the options of Search::Context::read_options()
+		if (std::find(StyleOptions, StyleOptions + STYLE_OPTION_N, name) == StyleOptions + STYLE_OPTION_N
+			|| !is_int(val[0] == '-' ? val.substr(1) : val)  // "Contempt Factor" can be negative
+			|| !UCI::OptMap[name].accepts(val))
+		{
+			sync_print("info string match: bad option " << name << "=" << val);
+			return false;
+		}
+		options[name] = str2int(val);
+		name.clear();
+	}
+	return name.empty();
+}
+
+} // namespace Match
+
+
+namespace UCI
+{
+
+int match(istream& args)
+{
+	using namespace Match;
+	string openPath, pgnPath, opt, val;
+	int threads = 0, games = 0;
+	LimitListener limit;
+	limit.clear();
+	Options[0].clear();
+	Options[1].clear();
+	Sprt = false;
+	TcBase = TcInc = 0;
+	bool ok = bool(args >> openPath) && openPath.compare(0, 2, "--") != 0;
+	args >> opt;
+	while (ok && !opt.empty())
+	{
+		if (opt == "--first" || opt == "--second")
+		{
+			ok = parse_options(args, Options[opt == "--second"], opt);
+			continue;
+		}
+		ok = bool(args >> val);
+		if (!ok)  break;
+		if (opt == "--pgn")
+			pgnPath = val;
+		else if (opt == "--tc")
+		{
+			// seconds, like 10+0.1
+			size_t plus = val.find('+');
+			TcBase = Msec(atof(val.substr(0, plus).c_str()) * 1000);
+			TcInc = plus == string::npos ? 0 : Msec(atof(val.substr(plus + 1).c_str()) * 1000);
+			ok = TcBase > 0;
+		}
+		else if (opt == "--sprt")
+		{
+			string elo1;
+			ok = bool(args >> elo1);
+			Elo0 = atof(val.c_str()), Elo1 = atof(elo1.c_str());
+			ok = ok && Elo1 > Elo0;
+			Sprt = true;
+		}
+		else if (!is_int(val) || str2int(val) < 1)
+			ok = false;
+		else if (opt == "--games")  games = str2int(val);
+		else if (opt == "--threads")  threads = str2int(val);
+		else if (opt == "--depth")  limit.depth = min(str2int(val), MAX_PLY - 1);
+		else if (opt == "--nodes")  limit.nodes = str2int(val);
+		else if (opt == "--movetime")  limit.moveTime = str2int(val);
+		else
+			ok = false;
+		if (!(args >> opt))
+			opt.clear();
+	}
+	if (!ok || !(limit.depth || limit.nodes || limit.moveTime || TcBase))
+	{
+		sync_print("Usage: match <openings|startpos> [--games N] [--threads N] "
+			"--depth D|--nodes N|--movetime T|--tc base+inc "
+			"[--first Name=Value ...] [--second Name=Value ...] [--sprt elo0 elo1] [--pgn file]");
+		return 1;
+	}
+
+	Openings.clear();
+	if (openPath == "startpos")
+		Openings.push_back(FEN_START);
+	else
+	{
+		ifstream fin(openPath);
+		if (!fin.is_open())
+		{
+			sync_print("info string cannot open " + openPath);
+			return 1;
+		}
+		string line;
+		for (int n = 1; getline(fin, line); n++)
+		{
+			if (!line.empty() && line.back() == '\r')
+				line.pop_back();
+			if (line.find_first_not_of(" \t") == string::npos || line[0] == '#')
+				continue;
+			EpdPosition epd;
+			if (!parse_epd(line, epd) || Position(epd.fen).count_legal() == 0)
+			{
+				sync_print("info string bad opening at line " << n);
+				return 1;
+			}
+			Openings.push_back(epd.fen);
+		}
+		if (Openings.empty())
+		{
+			sync_print("info string no openings in " + openPath);
+			return 1;
+		}
+	}
+	if (!pgnPath.empty())
+	{
+		PgnFile.open(pgnPath);
+		if (!PgnFile.is_open())
+		{
+			sync_print("info string cannot write " + pgnPath);
+			return 1;
+		}
+	}
+
+	GameCnt = games ? games : 2 * int(Openings.size());
+	if (threads < 1)  // all cores
+		threads = max(1u, std::thread::hardware_concurrency());
+	threads = min(threads, GameCnt);
+	U64 startTime = now();
+	Limits = limit;
+	NextGame = 0;
+	Stop = false;
+	Wins = Draws = Losses = Adjudicated = Finished = 0;
+
+	vector<MatchWorker *> workers;
+	for (int i = 0; i < threads; i++)
+		workers.push_back(new_thread<MatchWorker>());
+	// The workers exit by themselves when there are no games left
+	for (MatchWorker *w : workers)
+		del_thread(w);
+	if (PgnFile.is_open())
+		PgnFile.close();
+
+	ostringstream oss;
+	oss << report(Wins, Draws, Losses) << ", " << Adjudicated << " adjudicated, "
+		<< (now() - startTime) / 1000.0 << " s on " << threads << " threads";
+	sync_print(oss.str());
+	return 0;
+}
+
+} // namespace UCI
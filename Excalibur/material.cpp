@@ -1,4 +1,6 @@
 #include "material.h"
+#include "stats.h"
+#include "profile.h"
 
 // Values modified by Joona Kiiski
 const Value MidgameLimit = 15581;
@@ -103,9 +105,6 @@ int imbalance(const Position& pos)
 
 namespace Material
 {
-// Stores the material evaluation hash table
-HashTable<Entry, 8192> Table;
-
 using Endgame::probe_eval_func;
 using Endgame::probe_scaling_func;
 using Endgame::probe_non_unique_func;
@@ -116,14 +115,19 @@ using Endgame::probe_non_unique_func;
 /// have to recompute everything when the same material configuration occurs again.
 Entry* probe(const Position& pos)
 {
+	PROFILE_SCOPE(MATERIAL_PROBE);
 	U64 key = pos.material_key();
-	Entry* ent = Table[key];
+	Entry* ent = (*Table)[key];
 
 	// If ent->key matches the position's material hash key, it means that we
 	// have analyzed this material configuration before, and we can simply
 	// return the information we found the last time instead of recomputing it.
+	STAT_INC(MATERIAL_PROBES);
 	if (ent->key == key)
+	{
+		STAT_INC(MATERIAL_HITS);
 		return ent;
+	}
 
 	memset(ent, 0, sizeof(Entry));
 	ent->key = key;
@@ -205,13 +209,13 @@ Entry* probe(const Position& pos)
 	if (pos.pieceCount[W][PAWN] == 0 && npm_w - npm_b <= MG_BISHOP)
 	{
 		ent->scalor[W] = (byte)
-			(npm_w == npm_b || npm_w < MG_ROOK ? 0 : NoPawnsScalor[min(pos.pieceCount[W][BISHOP], 2)]);
+			(npm_w == npm_b || npm_w < MG_ROOK ? 0 : NoPawnsScalor[min<int>(pos.pieceCount[W][BISHOP], 2)]);
 	}
 
 	if (pos.pieceCount[B][PAWN] == 0 && npm_b - npm_w <= MG_BISHOP)
 	{
 		ent->scalor[B] = (byte)
-			(npm_w == npm_b || npm_b < MG_ROOK ? 0 : NoPawnsScalor[min(pos.pieceCount[B][BISHOP], 2)]);
+			(npm_w == npm_b || npm_b < MG_ROOK ? 0 : NoPawnsScalor[min<int>(pos.pieceCount[B][BISHOP], 2)]);
 	}
 
 	// Compute the space weight
@@ -45,7 +45,9 @@ namespace Material
 	};
 
 	// stores all the probed entries
-	extern HashTable<Entry, 8192> Table;
+	typedef HashTable<Entry, 8192> EntryTable;
+	// The table of the calling thread's search context, see Search::bind_context()
+	extern THREAD_LOCAL EntryTable *Table;
 
 	Entry* probe(const Position& pos);
 	Phase game_phase(const Position& pos);
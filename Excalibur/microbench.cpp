@@ -0,0 +1,244 @@
+/*
+ *	Microbenchmarks of the engine kernels in isolation.
+ *	Build with 'make microbench'. Usage: ./microbench [repetitions] [kernel name filter]
+ *	The corpus is every position up to 2 plies from the 'bench' positions.
+ *	Each kernel makes one warm-up pass over the corpus, then each repetition times
+ *	a full pass. We report ns per operation: median, 10th and 90th percentiles, best.
+ *	Timing whole passes keeps the clock overhead out of the measurement.
+ */
+#include "search.h"
+#include "eval.h"
+#include "uci.h"
+#include "material.h"
+#include "pawnshield.h"
+#include "ttable.h"
+
+using namespace Board;
+using namespace Moves;
+using Transposition::TT;
+
+// Results are accumulated here so that the compiler can't drop the work
+volatile U64 Sink;
+
+const size_t CORPUS_MAX = 50000;
+
+vector<Position> Corpus;  // not in check
+vector<Position> CheckCorpus;  // in check, for evasions
+// Legal moves of Corpus[i] are Moves[MoveIndex[i]] to Moves[MoveIndex[i + 1]]
+vector<Move> LegalMoves;
+vector<size_t> MoveIndex;
+vector<Move> Captures;  // with the index of their position in CaptureOwner
+vector<size_t> CaptureOwner;
+
+void collect(Position& pos, int depth)
+{
+	(pos.checker_map() ? CheckCorpus : Corpus).push_back(pos);
+	if (depth == 0 || Corpus.size() >= CORPUS_MAX)
+		return;
+
+	MoveBuffer mbuf;
+	StateInfo si;
+	CheckInfo ci = pos.check_info();
+	for (ScoredMove *it = mbuf, *end = pos.gen_moves<LEGAL>(mbuf); it != end; ++it)
+	{
+		pos.make_move(it->move, si, ci, pos.is_check(it->move, ci));
+		collect(pos, depth - 1);
+		pos.unmake_move(it->move);
+	}
+}
+
+void build_corpus()
+{
+	for (int i = 0; i < UCI::BENCH_FEN_N; i++)
+	{
+		Position pos(UCI::BenchFens[i]);
+		collect(pos, 2);
+	}
+
+	MoveBuffer mbuf;
+	for (size_t i = 0; i < Corpus.size(); i++)
+	{
+		MoveIndex.push_back(LegalMoves.size());
+		for (ScoredMove *it = mbuf, *end = Corpus[i].gen_moves<LEGAL>(mbuf); it != end; ++it)
+		{
+			LegalMoves.push_back(it->move);
+			if (!Corpus[i].is_quiet(it->move))
+				{ Captures.push_back(it->move); CaptureOwner.push_back(i); }
+		}
+	}
+	MoveIndex.push_back(LegalMoves.size());
+}
+
+
+/**********************************************/
+// A kernel makes one pass over the corpus and returns the number of operations
+typedef std::function<U64()> Kernel;
+
+int Repetitions = 15;
+string Filter;
+
+void run(const string& name, Kernel kernel)
+{
+	if (name.find(Filter) == string::npos)
+		return;
+
+	U64 ops = max<U64>(kernel(), 1);  // warm-up
+	vector<double> samples;
+	for (int i = 0; i < Repetitions; i++)
+	{
+		U64 start = now_us();
+		kernel();
+		samples.push_back((now_us() - start) * 1000.0 / ops);
+	}
+	std::sort(samples.begin(), samples.end());
+	size_t n = samples.size();
+
+	cout << left << setw(22) << name << right << fixed << setprecision(1)
+		<< setw(10) << ops
+		<< setw(10) << samples[n / 2]
+		<< setw(10) << samples[n / 10]
+		<< setw(10) << samples[n * 9 / 10]
+		<< setw(10) << samples[0] << endl;
+}
+
+template<GenType GT>
+U64 gen_kernel(vector<Position>& corpus)
+{
+	MoveBuffer mbuf;
+	U64 ops = 0, sum = 0;
+	for (Position& pos : corpus)
+	{
+		sum += pos.gen_moves<GT>(mbuf) - mbuf;
+		++ops;
+	}
+	Sink += sum;
+	return ops;
+}
+
+
+int main(int argc, char *argv[])
+{
+	if (argc > 1)	Repetitions = max(str2int(argv[1]), 1);
+	if (argc > 2)	Filter = argv[2];
+
+	Utils::init();
+	Board::init_tables();
+	UCI::init_options();
+	Eval::init();
+	Search::init();
+	TT.set_size(16);
+
+	build_corpus();
+	cout << "Corpus: " << Corpus.size() << " positions, " 
+		<< CheckCorpus.size() << " in check, " << LegalMoves.size() << " moves, "
+		<< Captures.size() << " captures. " << Repetitions << " repetitions\n" << endl;
+	cout << left << setw(22) << "kernel" << right << setw(10) << "ops" 
+		<< setw(10) << "ns/op" << setw(10) << "p10" << setw(10) << "p90" 
+		<< setw(10) << "best" << endl;
+
+	run("rook_attack", [] {
+		U64 ops = 0, sum = 0;
+		for (Position& pos : Corpus)
+			for (int sq = 0; sq < SQ_N; sq++, ops++)
+				sum ^= rook_attack(sq, pos.Occupied);
+		Sink += sum;
+		return ops;
+	});
+	run("bishop_attack", [] {
+		U64 ops = 0, sum = 0;
+		for (Position& pos : Corpus)
+			for (int sq = 0; sq < SQ_N; sq++, ops++)
+				sum ^= bishop_attack(sq, pos.Occupied);
+		Sink += sum;
+		return ops;
+	});
+
+	run("gen_moves<CAPTURE>", [] { return gen_kernel<CAPTURE>(Corpus); });
+	run("gen_moves<QUIET>", [] { return gen_kernel<QUIET>(Corpus); });
+	run("gen_moves<EVASION>", [] { return gen_kernel<EVASION>(CheckCorpus); });
+	run("gen_moves<LEGAL>", [] { return gen_kernel<LEGAL>(Corpus); });
+
+	run("make+unmake_move", [] {
+		StateInfo si;
+		U64 ops = 0;
+		for (size_t i = 0; i < Corpus.size(); i++)
+		{
+			Position& pos = Corpus[i];
+			CheckInfo ci = pos.check_info();
+			for (size_t m = MoveIndex[i]; m < MoveIndex[i + 1]; m++, ops++)
+			{
+				Move mv = LegalMoves[m];
+				pos.make_move(mv, si, ci, pos.is_check(mv, ci));
+				pos.unmake_move(mv);
+			}
+		}
+		Sink += ops;
+		return ops;
+	});
+
+	run("evaluate", [] {
+		Value margin, sum = VALUE_ZERO;
+		for (Position& pos : Corpus)
+			sum += Eval::evaluate(pos, margin);
+		Sink += sum;
+		return U64(Corpus.size());
+	});
+
+	run("see", [] {
+		int sum = 0;
+		for (size_t i = 0; i < Captures.size(); i++)
+			sum += Eval::see(Corpus[CaptureOwner[i]], Captures[i]);
+		Sink += sum;
+		return U64(Captures.size());
+	});
+
+	run("TT.store", [] {
+		for (Position& pos : Corpus)
+			TT.store(pos.key(), VALUE_ZERO, BOUND_EXACT, 1, MOVE_NULL, VALUE_ZERO, VALUE_ZERO);
+		return U64(Corpus.size());
+	});
+	run("TT.probe", [] {
+		U64 hits = 0;
+		for (Position& pos : Corpus)
+			hits += TT.probe(pos.key()) != nullptr;
+		Sink += hits;
+		return U64(Corpus.size());
+	});
+
+	run("Material::probe", [] {
+		U64 sum = 0;
+		for (Position& pos : Corpus)
+			sum += Material::probe(pos)->gamePhase;
+		Sink += sum;
+		return U64(Corpus.size());
+	});
+	run("Pawnshield::probe", [] {
+		U64 sum = 0;
+		for (Position& pos : Corpus)
+			sum += Pawnshield::probe(pos)->score;
+		Sink += sum;
+		return U64(Corpus.size());
+	});
+
+	// Main search sorter and qsearch sorter, run to exhaustion.
+	// One op is one move returned
+	run("MoveSorter", [] {
+		static HistoryStats history;  // empty: the quiet moves keep the generation order
+		Search::SearchInfo ss;
+		memset(&ss, 0, sizeof(ss));
+		Move refutations[2] = { MOVE_NULL, MOVE_NULL };
+		U64 ops = 0;
+		for (Position& pos : Corpus)
+		{
+			MoveSorter mainSorter(pos, MOVE_NULL, 6 * ONE_PLY, history, refutations, &ss);
+			while (mainSorter.next_move() != MOVE_NULL)
+				++ops;
+			MoveSorter qSorter(pos, MOVE_NULL, DEPTH_QS_CHECKS, history, SQ_NULL);
+			while (qSorter.next_move() != MOVE_NULL)
+				++ops;
+		}
+		return ops;
+	});
+
+	return 0;
+}
@@ -35,11 +35,14 @@ namespace Moves
 	inline bool is_normal(Move& mv) { return (mv & 0xc000) == 0x0; }
 }
 
+// A move and its ordering score, 32 bits in all so that a MoveBuffer
+// stays small. Scores must fit in 16 bits.
 struct ScoredMove
 {
 	Move move;
-	Value value;
+	short value;
 };
+static_assert(sizeof(ScoredMove) == sizeof(int), "ScoredMove must pack into 32 bits");
 
 // For sorting scheme in MoveSorter
 inline bool operator<(const ScoredMove& mv1, const ScoredMove& mv2)
@@ -4,6 +4,7 @@
 #include "material.h"
 #include "pawnshield.h"
 #include "ttable.h"
+#include "profile.h"
 using Transposition::TT;
 
 using namespace Board;
@@ -186,7 +187,7 @@ ScoredMove* Position::gen_promo(ScoredMove* mbuf, Bit& target, Bit& pawnsPromo,
 template<PieceType PT, bool qcheck, bool legal>
 ScoredMove* Position::gen_piece(ScoredMove* mbuf, Bit& target, Bit pinned, Bit discv) const
 {
-	const Square *tmpSq = pieceList[turn][PT];
+	const byte *tmpSq = pieceList[turn][PT];
 	Square from, to, ksq;	if (legal) ksq = king_sq(turn);
 	Bit toMap, ptCheckMap;
 	for (int i = 0; i < pieceCount[turn][PT]; i++)
@@ -275,7 +276,7 @@ ScoredMove* Position::gen_evasion(ScoredMove* mbuf, Bit pinned) const
 	{
 		ckCount ++;
 		cksq = pop_lsb(ck);
-		switch (boardPiece[cksq])  // who's checking me?
+		switch (piece_on(cksq))  // who's checking me?
 		{
 			// pseudo attack maps that don't concern about occupancy
 		case ROOK: sliderAttack |= ray_mask(ROOK, cksq); break;
@@ -307,11 +308,15 @@ ScoredMove* Position::gen_evasion(ScoredMove* mbuf, Bit pinned) const
 
 template<>
 ScoredMove* Position::gen_moves<EVASION>(ScoredMove* mbuf) const
-	{ return gen_evasion<false>(mbuf); }
+{
+	PROFILE_SCOPE(GEN_MOVES);
+	return gen_evasion<false>(mbuf);
+}
 
 template<GenType GT>
 ScoredMove* Position::gen_moves(ScoredMove* mbuf) const
 {
+	PROFILE_SCOPE(GEN_MOVES);
 	Bit target = GT == CAPTURE ? piece_union(~turn) :
 		GT == QUIET ? ~Occupied : 
 		GT == NON_EVASION ? ~piece_union(turn) : 0;
@@ -330,6 +335,7 @@ template ScoredMove* Position::gen_moves<NON_EVASION>(ScoredMove* mbuf) const;
 template<>
 ScoredMove* Position::gen_moves<QUIET_CHECK>(ScoredMove* mbuf) const
 {
+	PROFILE_SCOPE(GEN_MOVES);
 	// Discovered check (the pieces that blocks a ray checker)
 	Bit dc, discv, toMap; 
 	dc = discv = discv_map();
@@ -338,7 +344,7 @@ ScoredMove* Position::gen_moves<QUIET_CHECK>(ScoredMove* mbuf) const
 	while (dc)
 	{
 		from = pop_lsb(dc);
-		pt = boardPiece[from];
+		pt = piece_on(from);
 
 		// Pawn's discovered checks will be handled in gen_pawns
 		if (pt == PAWN) continue;
@@ -358,6 +364,7 @@ ScoredMove* Position::gen_moves<QUIET_CHECK>(ScoredMove* mbuf) const
 template<>
 ScoredMove* Position::gen_moves<LEGAL>(ScoredMove* mbuf) const
 {
+	PROFILE_SCOPE(GEN_MOVES);
 	Bit pinned = pinned_map();
 	return checker_map() ? gen_evasion<true>(mbuf, pinned)
 		: gen_all_pieces<NON_EVASION, true>(mbuf, ~piece_union(turn), pinned);
@@ -421,6 +428,7 @@ int Position::count_legal() const
 template<bool UseCheckInfo>
 void Position::make_move_helper(Move& mv, StateInfo& nextSt, const CheckInfo& ci, bool isCheck)
 {
+	PROFILE_SCOPE(MAKE_MOVE);
 	// First get the previous Zobrist key
 	U64 key = st->key;
 
@@ -439,14 +447,14 @@ void Position::make_move_helper(Move& mv, StateInfo& nextSt, const CheckInfo& ci
 	Square to = get_to(mv);
 	Bit ToMap = setbit(to);  // to update the captured piece's bitboard
 	Bit FromToMap = setbit(from) | ToMap;
-	PieceType piece = boardPiece[from];
-	PieceType capt = is_ep(mv) ? PAWN : boardPiece[to];
+	PieceType piece = piece_on(from);
+	PieceType capt = is_ep(mv) ? PAWN : piece_on(to);
 	Color opp = ~turn;
 
 	Pieces[piece][turn] ^= FromToMap;
 	Colormap[turn] ^= FromToMap;
-	boardPiece[from] = NON;  boardColor[from] = COLOR_NULL;
-	boardPiece[to] = piece;  boardColor[to] = turn;
+	board[from] = EMPTY_SQ;
+	board[to] = make_piece(turn, piece);
 
 	// hash keys and incremental score
 	key ^= Zobrist::turn;  // update side-to-move
@@ -481,7 +489,7 @@ void Position::make_move_helper(Move& mv, StateInfo& nextSt, const CheckInfo& ci
 		if (is_ep(mv)) 
 		{
 			captSq = backward_sq(turn, st->st_prev->epSquare);
-			boardPiece[captSq] = NON; boardColor[captSq] = COLOR_NULL;
+			board[captSq] = EMPTY_SQ;
 			ToMap = setbit(captSq);
 		}
 			else captSq = to;
@@ -508,7 +516,7 @@ void Position::make_move_helper(Move& mv, StateInfo& nextSt, const CheckInfo& ci
 			st->npMaterial[opp] -= PIECE_VALUE[MG][capt];
 
 		st->materialKey ^= Zobrist::psq[opp][capt][pieceCount[opp][capt]];
-		prefetch((char *) Material::Table[st->materialKey]); // load to cache material key is updated
+		prefetch((char *) (*Material::Table)[st->materialKey]); // load to cache material key is updated
 
 		st->psqScore -= PieceSquareTable[opp][capt][captSq];
 	} // end of captures
@@ -525,7 +533,7 @@ void Position::make_move_helper(Move& mv, StateInfo& nextSt, const CheckInfo& ci
 
 		// Update pawn structure key and prefetch access
 		st->pawnKey ^= Zobrist::psq[turn][PAWN][from] ^ Zobrist::psq[turn][PAWN][to];
-		prefetch((char *) Pawnshield::Table[st->pawnKey]); // load to cache
+		prefetch((char *) (*Pawnshield::Table)[st->pawnKey]); // load to cache
 
 		// Set enpassant only if the moved pawn can be attacked
 		Square ep;
@@ -539,7 +547,7 @@ void Position::make_move_helper(Move& mv, StateInfo& nextSt, const CheckInfo& ci
 		{
 			PieceType promo = get_promo(mv);
 			Pawnmap[turn] ^= ToMap;  // the pawn's no longer there
-			boardPiece[to] = promo;
+			board[to] = make_piece(turn, promo);
 			Pieces[promo][turn] ^= ToMap;
 
 			// Update piece lists, move the last pawn at index[to] position
@@ -555,11 +563,11 @@ void Position::make_move_helper(Move& mv, StateInfo& nextSt, const CheckInfo& ci
 			key ^= Zobrist::psq[turn][PAWN][to] ^ Zobrist::psq[turn][promo][to];
 
 			st->pawnKey ^= Zobrist::psq[turn][PAWN][to];
-			prefetch((char *) Pawnshield::Table[st->pawnKey]); // load to cache
+			prefetch((char *) (*Pawnshield::Table)[st->pawnKey]); // load to cache
 
 			st->materialKey ^= Zobrist::psq[turn][promo][pieceCount[turn][promo]++]
 					^ Zobrist::psq[turn][PAWN][pieceCount[turn][PAWN]];
-			prefetch((char *) Material::Table[st->materialKey]); // load to cache material key is updated
+			prefetch((char *) (*Material::Table)[st->materialKey]); // load to cache material key is updated
 
 			st->psqScore += PieceSquareTable[turn][promo][to] - PieceSquareTable[turn][PAWN][to];
 			st->npMaterial[turn] += PIECE_VALUE[MG][promo];
@@ -575,8 +583,8 @@ void Position::make_move_helper(Move& mv, StateInfo& nextSt, const CheckInfo& ci
 		rfrom = RookCastleSq[turn][castleType][0];
 		rto = RookCastleSq[turn][castleType][1];
 
-		boardPiece[rfrom] = NON; boardColor[rfrom] = COLOR_NULL;  // from
-		boardPiece[rto] = ROOK; boardColor[rto] = turn; // to
+		board[rfrom] = EMPTY_SQ;  // from
+		board[rto] = make_piece(turn, ROOK); // to
 
 		// move the rook in pieceList
 		plistIndex[rto] = plistIndex[rfrom];
@@ -589,10 +597,11 @@ void Position::make_move_helper(Move& mv, StateInfo& nextSt, const CheckInfo& ci
 	}
 
 	// Load transposition entry access as soon as we get the new position zobrist key
-	prefetch((char *) TT.first_entry(key));
+	prefetch((char *) Transposition::ThreadTT->first_entry(key));
 
 	st->captured = capt;
 	st->key = key;
+	rep_add(key);
 	Occupied = Colormap[W] | Colormap[B];
 
 	// Now we look from our opponents' perspective and update checker info
@@ -643,15 +652,15 @@ void Position::unmake_move(Move& mv)
 	Square to = get_to(mv);
 	Bit ToMap = setbit(to);  // to update the captured piece's bitboard
 	Bit FromToMap = setbit(from) | ToMap;
-	PieceType piece = is_promo(mv) ? PAWN : boardPiece[to];
+	PieceType piece = is_promo(mv) ? PAWN : piece_on(to);
 	PieceType capt = st->captured;
 	Color opp = turn;
 	turn = ~turn;
 
 	Pieces[piece][turn] ^= FromToMap;
 	Colormap[turn] ^= FromToMap;
-	boardPiece[from] = piece; boardColor[from] = turn; // restore
-	boardPiece[to] = NON; boardColor[to] = COLOR_NULL;
+	board[from] = make_piece(turn, piece); // restore
+	board[to] = EMPTY_SQ;
 
 	// Promotion
 	if (is_promo(mv))
@@ -660,8 +669,7 @@ void Position::unmake_move(Move& mv)
 		Pawnmap[turn] ^= ToMap;  // flip back
 		//++pieceCount[turn][PAWN];
 		//--pieceCount[turn][promo];
-		boardPiece[from] = PAWN;
-		boardPiece[to] = NON;
+		// board[from] and board[to] are already restored above, since 'piece' is PAWN
 		Pieces[promo][turn] ^= ToMap;
 
 		// Update piece lists, move the last promoted piece at index[to] position
@@ -683,8 +691,8 @@ void Position::unmake_move(Move& mv)
 		rfrom = RookCastleSq[turn][castleType][0];
 		rto = RookCastleSq[turn][castleType][1];
 
-		boardPiece[rfrom] = ROOK;  boardColor[rfrom] = turn;  // from
-		boardPiece[rto] = NON;  boardColor[rto] = COLOR_NULL; // to
+		board[rfrom] = make_piece(turn, ROOK);  // from
+		board[rto] = EMPTY_SQ; // to
 
 		// un-move the rook in pieceList
 		plistIndex[rfrom] = plistIndex[rto];
@@ -709,7 +717,7 @@ void Position::unmake_move(Move& mv)
 
 		Pieces[capt][opp] ^= ToMap;
 		Colormap[opp] ^= ToMap;
-		boardPiece[to] = capt; boardColor[to] = opp;  // restore the captured piece
+		board[to] = make_piece(opp, capt);  // restore the captured piece
 
 		// Update piece list, add a new captured piece in capt square
 		plistIndex[to] = pieceCount[opp][capt]++;
@@ -718,6 +726,7 @@ void Position::unmake_move(Move& mv)
 
 	Occupied = Colormap[W] | Colormap[B];
 
+	rep_remove(st->key);
 	st = st->st_prev; // recover the state from previous position
 }
 
@@ -731,7 +740,7 @@ void Position::make_null_move(StateInfo& nextSt)
 	st = &nextSt;
 
 	st->key ^= Zobrist::turn;
-	prefetch((char*)TT.first_entry(st->key)); // Load TT access to cache
+	prefetch((char*)Transposition::ThreadTT->first_entry(st->key)); // Load TT access to cache
 
 	st->cntFiftyMove ++;  // will be set to 0 later if it's a pawn move or capture
 	st->cntInternalFiftyMove = 0; // explained in the header comment
@@ -741,6 +750,7 @@ void Position::make_null_move(StateInfo& nextSt)
 		st->key ^=Zobrist::ep[sq2file(st->epSquare)];
 		st->epSquare = SQ_NULL;
 	}
+	rep_add(st->key);
 
 	turn = ~turn; // flip side
 }
@@ -748,6 +758,7 @@ void Position::make_null_move(StateInfo& nextSt)
 /* Unmake a null move */
 void Position::unmake_null_move()
 {
+	rep_remove(st->key);
 	st = st->st_prev; // restore the state
 	turn = ~turn;
 }
\ No newline at end of file
@@ -1,6 +1,10 @@
 #include "movesort.h"
 #include "eval.h"
 #include "search.h"
+#include "profile.h"
+#if defined(__SSE4_1__) || defined(__AVX2__)
+#  include <immintrin.h>
+#endif
 
 using namespace Moves;
 
@@ -93,8 +97,8 @@ void MoveSorter::score<CAPTURE>()
 	{
 		mv = it->move;
 		// We'll prefer using a lesser piece to capture a stronger opp (MVV/LVA)
-		it->value = PIECE_VALUE[MG][pos.boardPiece[get_to(mv)]]
-				- pos.boardPiece[get_from(mv)];
+		it->value = PIECE_VALUE[MG][pos.piece_on(get_to(mv))]
+				- pos.piece_on(get_from(mv));
 
 		if (is_promo(mv))
 			it->value += PIECE_VALUE[MG][get_promo(mv)] - PIECE_VALUE[MG][PAWN];
@@ -132,8 +136,8 @@ void MoveSorter::score<EVASION>()
 
 		// We'll prefer using a lesser piece to capture a stronger opp (MVV/LVA)
 		else if (pos.is_capture(mv))
-			it->value = PIECE_VALUE[MG][pos.boardPiece[get_to(mv)]]
-							- pos.boardPiece[get_from(mv)] + HistoryStats::MAX;
+			it->value = PIECE_VALUE[MG][pos.piece_on(get_to(mv))]
+							- pos.piece_on(get_from(mv)) + HistoryStats::MAX;
 
 		else
 			it->value = history.get(pos, get_from(mv), get_to(mv));
@@ -141,6 +145,49 @@ void MoveSorter::score<EVASION>()
 }
 
 
+/*
+ *	Rank sort on int keys: (score << 16) | (MAX_MOVES - 1 - index).
+ *	A higher key means a higher score, and on equal scores the move generated
+ *	first, as in the stable insertion sort this replaces. Keys never tie,
+ *	so we can compare plain ints without any branch on the outcome.
+ */
+
+// Number of keys in [begin, end) that are greater than k
+inline int count_greater(const int* begin, const int* end, int k)
+{
+	const int* it = begin;
+	int cnt = 0;
+#if defined(__AVX2__)
+	const __m256i vk = _mm256_set1_epi32(k);
+	for (; end - it >= 8; it += 8)
+		cnt += bit_count(_mm256_movemask_ps(_mm256_castsi256_ps(
+				_mm256_cmpgt_epi32(_mm256_loadu_si256((const __m256i*) it), vk))));
+#elif defined(__SSE4_1__)
+	const __m128i vk = _mm_set1_epi32(k);
+	for (; end - it >= 4; it += 4)
+		cnt += bit_count(_mm_movemask_ps(_mm_castsi128_ps(
+				_mm_cmpgt_epi32(_mm_loadu_si128((const __m128i*) it), vk))));
+#endif
+	for (; it < end; ++it)
+		cnt += *it > k;
+	return cnt;
+}
+
+// Sorts [begin, end) by descending score, stable. Because no two keys are equal,
+// the final index of a move is just the number of keys greater than its own.
+// More comparisons than an insertion sort, but they are all SIMD and none
+// of them is a branch, where insertion sort mispredicts on almost every move.
+inline void sort_moves(ScoredMove* begin, ScoredMove* end)
+{
+	int n = int(end - begin), keys[MAX_MOVES];
+	for (int i = 0; i < n; i++)
+		keys[i] = begin[i].value * (1 << 16) + (MAX_MOVES - 1 - i);
+	ScoredMove sorted[MAX_MOVES];
+	for (int i = 0; i < n; i++)
+		sorted[count_greater(keys, keys + n, keys[i])] = begin[i];
+	memcpy(begin, sorted, n * sizeof(ScoredMove));
+}
+
 /* Generates, scores and sorts the next group of moves */
 void MoveSorter::gen_next_moves()
 {
@@ -183,15 +230,15 @@ void MoveSorter::gen_next_moves()
 			// precede all those for which it returns false. 
 			// The iterator returned points to the first element of the second group.
 			// end marks the start of all negative-scored moves
-		end = std::partition(cur, end, [](const ScoredMove& mv) { return mv.value > 0; }); 
-		insertion_sort<ScoredMove>(cur, end);
+		end = std::partition(cur, end, [](const ScoredMove& mv) { return mv.value > 0; });
+		sort_moves(cur, end);
 		return;
 
 	case S1QuietNegative: // sorts the negative partition
 		cur = end; // start of the negative mbuf part
 		end = endQuiet; // the ultimate end
 		if (depth >= 3 * ONE_PLY)
-			insertion_sort<ScoredMove>(cur, end);
+			sort_moves(cur, end);
 		return;
 
 	case S1BadCapture: // We reverse the roll of cur and end: end < cur.
@@ -230,10 +277,15 @@ void MoveSorter::gen_next_moves()
 // Helper for next_move()
 // Selects and moves to the front the best move in the range [begin, end),
 // it is faster than sorting all the moves in advance when moves are few, as
-// normally are the possible captures.
+// normally are the possible captures. Too few for a SIMD max reduction to pay off,
+// but the compiler can use a conditional move instead of a branch.
+// The first of equal scores wins, as with std::max_element.
 inline ScoredMove* select_best(ScoredMove* begin, ScoredMove* end)
 {
-	std::swap(*begin, *std::max_element(begin, end));
+	ScoredMove* best = begin;
+	for (ScoredMove* it = begin + 1; it < end; ++it)
+		best = it->value > best->value ? it : best;
+	std::swap(*begin, *best);
 	return begin;
 }
 
@@ -246,6 +298,7 @@ inline ScoredMove* select_best(ScoredMove* begin, ScoredMove* end)
  */
 Move MoveSorter::next_move()
 {
+	PROFILE_SCOPE(NEXT_MOVE);
 	Move mv;
 	while (true)
 	{
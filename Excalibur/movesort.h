@@ -25,7 +25,7 @@ struct Stats
 
 	//const T get(Color c, PieceType pt, Square to) const { return table[c][pt][to]; }
 	INLINE const T get(const Position& pos, Square moverLocation, Square to) const
-	{ return table[pos.boardColor[moverLocation]][pos.boardPiece[moverLocation]][to]; }
+	{ return table[pos.color_on(moverLocation)][pos.piece_on(moverLocation)][to]; }
 
 	void clear() { memset(table, 0, sizeof(table)); }
 
@@ -36,8 +36,8 @@ struct Stats
 	// get the moving piece's color and type. 
 	void update(const Position& pos, Square moverLocation, Square to, Move m)
 	{
-		Color c = pos.boardColor[moverLocation];
-		PieceType pt = pos.boardPiece[moverLocation];
+		Color c = pos.color_on(moverLocation);
+		PieceType pt = pos.piece_on(moverLocation);
 
 		if (m == table[c][pt][to].first)
 			return;
@@ -49,8 +49,8 @@ struct Stats
 	//void update(Color c, PieceType pt, Square to, Value v)
 	void update(const Position& pos, Square moverLocation, Square to, Value v)
 	{
-		Color c = pos.boardColor[moverLocation];
-		PieceType pt = pos.boardPiece[moverLocation];
+		Color c = pos.color_on(moverLocation);
+		PieceType pt = pos.piece_on(moverLocation);
 
 		if (Gain)
 			table[c][pt][to] = max(v, table[c][pt][to] - 1);
@@ -100,4 +100,8 @@ private:
 	MoveBuffer mbuf;
 };
 
+// Debug command 'perft sort': MoveSorter throughput over
+// all the positions of a perft tree (perft.cpp)
+void sorter_speedometer(Position& pos, int depth);
+
 #endif // __movesort_h__
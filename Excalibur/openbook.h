@@ -3,6 +3,7 @@
  *	Standard Polyglot format is defined by http://hardy.uhasselt.be/Toga/book_format.html
  *	Excalibur format: first 781 Zobrist keys, then entries of opening.
  *	Each entry has 3 parts: "position key", "best move" and "counts" (actually score-weight)
+ *	Standard big-endian books are read as they are, with the keys from "Polyglot.key"
  */
 
 #ifndef __openbook_h__
@@ -12,14 +13,15 @@
 
 namespace Polyglot
 {
-	// Maps a Polyglot-format key to an array of ScoredMove
-	// Outer unordered_map gives us the map of move-counts(weights) from a polyglot position key
-	// Inner map contains opening variations of the same position, sorted descendingly by 'count'
+	// The book file is memory-mapped and never loaded: probe() binary-searches
+	// the entries in place. They must be sorted by key, as Polyglot books are.
+	// Each entry is 12 bytes: key (U64), move (ushort), count (ushort).
+	// A standard Polyglot entry has 16, big-endian: key, move, count, learn (uint)
 	// Polyglot: count = 2*win + draw;
-	// If we don't AllowBookVariation, we simply return the first move in the map (with the largest count)
-	// if we do, we randomly  choose a move from the map
-	typedef unordered_map<U64, map<ushort, Move, std::greater<ushort>>> PolyglotBookMap; 
-	extern PolyglotBookMap OpeningBook;
+	// If we don't AllowBookVariation, we simply play the move with the largest count
+	// if we do, we randomly choose a move among the entries of the position
+	const size_t BookEntrySize = 12;
+	const size_t PolyglotEntrySize = 16;
 
 	// True when we favor variation over the best move 
 	// set to false if we strictly plays the move with the largest "counts"
@@ -30,13 +32,44 @@ namespace Polyglot
 	// set to false by load(). If false, probe() will return MOVE_NULL
 	extern bool ValidBook;
 
-	// Loads the new filepath into 'OpeningBook' global variable. 
+	// Maps the new filepath and reads its Zobrist keys. Startup cost doesn't
+	// depend on the size of the book. Either format is detected.
+	// A standard book takes its keys from "Polyglot.key", next to it or in the
+	// working directory, else the standard Polyglot keys, unless they're already loaded.
 	// will be triggered by UCI Option "Opening Book"
 	void load(string filePath);
 
-	// Called in Search::think() before any searching to see if we've got a Book hit
+	// Polyglot's Zobrist keys. 781 in total
+	struct KeySet
+	{
+		U64 psq[COLOR_N][PIECE_TYPE_N][SQ_N];
+		U64 castle[COLOR_N][4]; // using a similar trick as our Zobrist::
+		U64 ep[FILE_N];
+		U64 turn;
+	};
+	// Set by load() from the book, or by load_keys()
+	extern KeySet Zobrist;
+	extern bool KeysLoaded;
+
+	// Reads the keys from a "Polyglot.key" text file: 781 hex numbers.
+	// Without a readable file, loads the standard Polyglot keys and returns false
+	bool load_keys(string polyglotKeyPath);
+
+	// Polyglot hash of the position, with the Zobrist keys of the loaded book
+	U64 book_key(const Position& pos);
+	// The two halves of book_key(): the pieces on 'squares',
+	// and the castling rights, ep square and side to move
+	U64 psq_key(const Position& pos, Bit squares);
+	U64 state_key(const Position& pos);
+
+	// Called by an Engine before any searching to see if we've got a Book hit
 	Move probe(const Position& pos);
 
+	// Builds a standard Polyglot book (big-endian .bin) from the games of a PGN file,
+	// up to maxPly plies into each game.
+	// Returns a summary, or an error message
+	string build(string pgnPath, string outPath, int maxPly, int threads);
+
 	// Transforms a standard polyglot book to Excalibur-compatible format.
 	// "Ployglot.key" and "book.bin"
 	void adapt(string polyglotKeyPath, string bookBinPath);
@@ -0,0 +1,58 @@
+#include "packedpos.h"
+
+// Encode the current position into 32 bytes.
+// The payload field is left untouched
+void Position::encode(PackedPosition& pp) const
+{
+	pp.occupied = Occupied;
+	memset(pp.pieces, 0, sizeof(pp.pieces));
+
+	Bit occ = Occupied;
+	for (int i = 0; occ; i++)
+		pp.pieces[i >> 1] |= board[pop_lsb(occ)] << ((i & 1) << 2);
+
+	pp.flags = turn | (castle_rights(W) << 1) | (castle_rights(B) << 3);
+	pp.epSquare = ep_sq();
+	pp.fiftyMove = min(st->cntFiftyMove, 255);
+	pp.reserved = 0;
+	pp.fullMove = 1 + (cntHalfMove - (turn == B)) / 2;
+}
+
+// Restore a position from its 32-byte encoding.
+// Same result as parse_fen() on the FEN of the encoded position,
+// but without any string parsing.
+// Returns false and leaves the position alone if the record can't be one that
+// encode() wrote: more than 32 pieces, a piece code with no piece type, or an
+// ep square off the board. Records are otherwise trusted to be legal positions.
+bool Position::decode(const PackedPosition& pp)
+{
+	if (bit_count<CNT_FULL>(pp.occupied) > 32
+		|| (pp.epSquare >= SQ_N && pp.epSquare != SQ_NULL))
+		return false;
+	Bit occ = pp.occupied;
+	for (int i = 0; occ; i++, occ &= occ - 1)
+	{
+		PieceType pt = PieceType((pp.pieces[i >> 1] >> ((i & 1) << 2)) & 7);
+		if (pt == NON || pt > KING)
+			return false;
+	}
+
+	clear_board();
+
+	occ = pp.occupied;
+	for (int i = 0; occ; i++)
+	{
+		byte code = (pp.pieces[i >> 1] >> ((i & 1) << 2)) & 0xF;
+		put_piece(pop_lsb(occ), Color(code >> 3), PieceType(code & 7));
+	}
+
+	turn = Color(pp.flags & 1);
+	st->castleRights[W] = (pp.flags >> 1) & 3;
+	st->castleRights[B] = (pp.flags >> 3) & 3;
+	st->epSquare = pp.epSquare;
+	st->cntFiftyMove = pp.fiftyMove;
+	cntHalfMove = max(2 * (pp.fullMove - 1), 0) + (turn == B);
+
+	init_state();
+	return true;
+}
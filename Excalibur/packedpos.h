@@ -0,0 +1,113 @@
+/*
+ *	Packed 32-byte position encoding, for analysis caches, training sets and IPC.
+ *	A FEN round trip goes through stringstream both ways, which is far too slow
+ *	when we store millions of positions.
+ *	Layout of a PackedPosition:
+ *	- 8 bytes: occupancy bitboard
+ *	- 16 bytes: a 4-bit piece code for each occupied square, from a1 to h8,
+ *	  low nibble first. The code is (color << 3) | piece type, same as Position::board[]
+ *	- side to move, castling rights, ep square, 50-move counter and full move number
+ */
+
+#ifndef __packedpos_h__
+#define __packedpos_h__
+
+#include "position.h"
+
+struct PackedPosition
+{
+	Bit occupied;
+	byte pieces[16];  // 32 nibbles at most
+	byte flags;  // bit 0: side to move. bits 1-2: white castling rights, bits 3-4: black
+	byte epSquare;  // SQ_NULL if none
+	byte fiftyMove;  // cntFiftyMove
+	byte reserved;  // always 0 for now
+	ushort fullMove;  // FEN full move number, starts at 1
+	ushort payload;  // free for the user, e.g. a score or a game result. encode() leaves it alone
+
+	friend bool operator==(const PackedPosition& pp1, const PackedPosition& pp2)
+		{ return memcmp(&pp1, &pp2, sizeof(PackedPosition)) == 0; }
+};
+
+static_assert(sizeof(PackedPosition) == 32, "PackedPosition must be exactly 32 bytes");
+
+/* A labelled position of a training set, as written by 'gensfen' */
+struct TrainingRecord
+{
+	PackedPosition pos;
+	short score;  // search score for the side to move, in Value units (MG_PAWN is a pawn)
+	Move move;  // best move found by the search
+	ushort ply;  // game ply of the position, 0 at the start position
+	signed char result;  // game result for the side to move: 1 win, 0 draw, -1 loss
+	byte reserved;  // always 0 for now
+};
+
+static_assert(sizeof(TrainingRecord) == 40, "TrainingRecord must be exactly 40 bytes");
+
+/* Bulk I/O. Records of a fixed size (PackedPosition, TrainingRecord) are stored
+ * back to back without any header, in little-endian (the system convention, see BinaryIO) */
+namespace Packed
+{
+	// Streams records from a file in large blocks
+	template<typename Record = PackedPosition>
+	class Reader
+	{
+	public:
+		Reader(string filePath) : fin(filePath, ifstream::binary) // throws FileNotFoundException
+		{
+			if (!fin.is_open())
+				throw FileNotFoundException(filePath);
+			fin.seekg(0, ios::end);
+			total = U64(fin.tellg()) / sizeof(Record);
+			fin.seekg(0, ios::beg);
+		}
+		// Reads up to n records into buf. Returns the number actually read, 0 at the end
+		size_t read(Record *buf, size_t n)
+		{
+			fin.read((char *) buf, n * sizeof(Record));
+			return size_t(fin.gcount()) / sizeof(Record);
+		}
+		bool read(Record& rec) { return read(&rec, 1) == 1; }
+		// Skips n records
+		void skip(U64 n) { fin.seekg(n * sizeof(Record), ios::cur); }
+		U64 size() const { return total; } // number of records in the file
+	private:
+		ifstream fin;
+		U64 total;
+	};
+
+	// Appends records to a file, buffered by the ofstream
+	template<typename Record = PackedPosition>
+	class Writer
+	{
+	public:
+		Writer(string filePath, bool append = false) // throws FileNotFoundException
+			: fout(filePath, append ? ofstream::binary | ofstream::app : ofstream::binary)
+		{
+			if (!fout.is_open())
+				throw FileNotFoundException(filePath);
+		}
+		void write(const Record *buf, size_t n) { fout.write((const char *) buf, n * sizeof(Record)); }
+		void write(const Record& rec) { write(&rec, 1); }
+		void flush() { fout.flush(); }
+	private:
+		ofstream fout;
+	};
+
+	// Read or write a whole file at once
+	template<typename Record>
+	void load(string filePath, vector<Record>& records)
+	{
+		Reader<Record> reader(filePath);
+		records.resize(size_t(reader.size()));
+		records.resize(reader.read(records.data(), records.size()));
+	}
+	template<typename Record>
+	void save(string filePath, const vector<Record>& records, bool append = false)
+	{
+		Writer<Record> writer(filePath, append);
+		writer.write(records.data(), records.size());
+	}
+}
+
+#endif // __packedpos_h__
@@ -1,5 +1,7 @@
 /* Pawn structure evaluator */
 #include "pawnshield.h"
+#include "stats.h"
+#include "profile.h"
 
 using namespace Board;
 
@@ -80,7 +82,7 @@ Score evaluate_pawns(const Position& pos, Pawnshield::Entry* ent)
 	// flag a pawn's state
 	bool passed, isolated, doubled, opposed, chain, backward, candidate;
 	Score score = SCORE_ZERO;
-	const Square* pawnl = pos.pieceList[us][PAWN];
+	const byte* pawnl = pos.pieceList[us][PAWN];
 
 	Bit ourPawns = pos.Pawnmap[us];
 	Bit oppPawns = pos.Pawnmap[opp];
@@ -161,19 +163,22 @@ Score evaluate_pawns(const Position& pos, Pawnshield::Entry* ent)
 
 namespace Pawnshield 
 {
-	HashTable<Entry, 16384> Table;
-
 	/// probe() takes a position object as input, computes a Entry object, and returns
 	/// a pointer to it. The result is also stored in a hash table, so we don't have
 	/// to recompute everything when the same pawn structure occurs again.
 
 	Entry* probe(const Position& pos) 
 	{
+		PROFILE_SCOPE(PAWN_PROBE);
 		U64 key = pos.pawn_key();
-		Entry* ent = Table[key];
+		Entry* ent = (*Table)[key];
 
+		STAT_INC(PAWN_PROBES);
 		if (ent->key == key)
+		{
+			STAT_INC(PAWN_HITS);
 			return ent;
+		}
 
 		ent->key = key;
 		ent->score = evaluate_pawns<W>(pos, ent) - evaluate_pawns<B>(pos, ent);
@@ -48,7 +48,9 @@ namespace Pawnshield
 	};
 
 	// stores all the probed entries
-	extern HashTable<Entry, 16384> Table;
+	typedef HashTable<Entry, 16384> EntryTable;
+	// The table of the calling thread's search context, see Search::bind_context()
+	extern THREAD_LOCAL EntryTable *Table;
 
 	Entry* probe(const Position& pos);
 
@@ -223,7 +223,7 @@ void perft_verifier(string filePath, string startID /* ="initial" */, bool verbo
 				fin >> str >> str;  // read off "perft X"
 				fin >> ans;  // The answer
 				start = now();
-				if (Search::Signal.stop)  // force stop by the user
+				if (Search::Ctx->signal.stop)  // force stop by the user
 					{ cout << "perft aborted!" << endl; return; }
 				else
 					actual = ptest.perft<UseHash>(depth); 
@@ -290,4 +290,75 @@ void perft_verifier(Position& pos, int depth)
 }
 // Explicit instantiation
 template void perft_verifier<true>(Position& pos, int depth);
-template void perft_verifier<false>(Position& pos, int depth);
\ No newline at end of file
+template void perft_verifier<false>(Position& pos, int depth);
+
+/* MoveSorter throughput in isolation, without the search around it.
+ * Collects every position of the perft tree below pos, seeds a private
+ * history table, then runs a main search sorter and a qsearch sorter
+ * through each position over and over for about 2 seconds. */
+namespace
+{
+	const size_t SORTER_MAX_POSITIONS = 200000;
+
+	void collect_positions(Position& pos, int depth, vector<Position>& positions)
+	{
+		positions.push_back(pos);
+		if (depth == 0 || positions.size() >= SORTER_MAX_POSITIONS)
+			return;
+
+		MoveBuffer mbuf;
+		StateInfo si;
+		CheckInfo ci = pos.check_info();
+		for (ScoredMove *it = mbuf, *end = pos.gen_moves<LEGAL>(mbuf); it != end; ++it)
+		{
+			pos.make_move(it->move, si, ci, pos.is_check(it->move, ci));
+			collect_positions(pos, depth - 1, positions);
+			pos.unmake_move(it->move);
+		}
+	}
+}
+
+void sorter_speedometer(Position& pos, int depth)
+{
+	vector<Position> positions;
+	collect_positions(pos, depth, positions);
+
+	// Deterministic history scores, so that the quiet stages have something to sort
+	HistoryStats history;
+	history.clear();
+	MoveBuffer mbuf;
+	for (Position& p : positions)
+	{
+		U64 seed = p.key();
+		for (ScoredMove *it = mbuf, *end = p.gen_moves<QUIET>(mbuf); it != end; ++it)
+		{
+			seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+			history.update(p, Moves::get_from(it->move), Moves::get_to(it->move), Value(int(seed >> 56) - 128));
+		}
+	}
+
+	Search::SearchInfo ss;
+	memset(&ss, 0, sizeof(ss)); // no killers
+	Move refutations[2] = { MOVE_NULL, MOVE_NULL };
+	U64 moves = 0, start = now(), time;
+	int rounds = 0;
+	do
+	{
+		for (Position& p : positions)
+		{
+			MoveSorter mainSorter(p, MOVE_NULL, 6 * ONE_PLY, history, refutations, &ss);
+			while (mainSorter.next_move() != MOVE_NULL)
+				++moves;
+			MoveSorter qSorter(p, MOVE_NULL, DEPTH_QS_CHECKS, history, SQ_NULL);
+			while (qSorter.next_move() != MOVE_NULL)
+				++moves;
+		}
+		++rounds;
+	} while ((time = now() - start) < 2000 && !Search::Ctx->signal.stop);
+
+	cout << setw(12) << "Positions = " << positions.size() << endl;
+	cout << setw(12) << "Rounds = " << rounds << endl;
+	cout << setw(12) << "Moves = " << moves << endl;
+	cout << setw(12) << "Time = " << time << " ms" << endl;
+	cout << setw(12) << "Speed = " << moves / max<U64>(time, 1) << " kmoves/s" << endl;
+}
@@ -0,0 +1,193 @@
+/*
+ *	Speculative pondering, UCI option "Speculative Ponder".
+ *	While an Engine ponders on the predicted reply, Helper threads ponder on the
+ *	opponent's next most likely replies, each in its own Search::Context and all
+ *	in the engine's TT. The first helper ranks the replies with a short MultiPV
+ *	search of the position before them, then every helper takes one.
+ *	On a ponder miss, the engine's next search adopts the helper that pondered the
+ *	move actually played: its root moves and history are resumed like a "Warm Requery".
+ */
+#include "search.h"
+#include "thread.h"
+
+using namespace Search;
+
+namespace Ponder
+{
+
+const Depth RankDepth = 8;  // of the MultiPV search that ranks the replies
+
+struct Helper : public Thread
+{
+	Helper();
+	virtual void execute();
+	// Searches 'root' until stopped. False if there's nothing to search
+	bool search(const Position& root);
+
+	int id;  // its rank among the replies
+	Context cx;
+	StateInfo replySt;  // the reply played on Parent
+	U64 rootKey;  // of the position it pondered, 0 if none
+	volatile bool idle;  // under 'mutex'
+	ConditionVar idleCond;
+};
+
+// The position before the opponent's reply, and the reply the engine ponders.
+// Set before the helpers are launched, read only afterwards
+Position Parent;
+Move Predicted;
+int HelperCnt;
+Transposition::Table *HelperTT;
+// Changed by the engine's caller only. stop() may come from any thread, under HelpersLock
+vector<Helper *> Helpers;
+Mutex HelpersLock;
+
+// Ranking, under RankLock. Helpers wait for the first one to fill Replies
+Mutex RankLock;
+ConditionVar RankCond;
+vector<Move> Replies;  // best first, without Predicted
+bool Ranked;
+
+Helper::Helper() : id(int(Helpers.size())), rootKey(0), idle(false)
+{
+	cx.silent = true;
+	cx.tt = HelperTT;
+	cx.read_options();
+}
+
+bool Helper::search(const Position& root)
+{
+	cx.rootPos = root;
+	cx.rootMoveList.clear();
+	MoveBuffer mbuf;
+	ScoredMove *end = cx.rootPos.gen_moves<LEGAL>(mbuf);
+	for (ScoredMove *it = mbuf; it != end; ++it)
+		cx.rootMoveList.push_back(RootMove(it->move));
+	if (cx.rootMoveList.empty() || cx.signal.stop)
+		return false;
+	// Warm with nothing to resume: the search keeps the TT generation
+	// of the engine's ponder search instead of starting a new one
+	cx.warm = true;
+	cx.warmKey = cx.rootPos.key();
+	cx.warmMoves.clear();
+	cx.searchTime = now();
+	run();
+	return true;
+}
+
+void Helper::execute()
+{
+	bind_context(cx);
+	if (id == 0)
+	{
+		cx.multiPV = min(HelperCnt + 1, MAX_MULTI_PV);
+		cx.limit.depth = RankDepth;
+		search(Parent);
+		cx.multiPV = 1;
+		RankLock.lock();
+		for (RootMove& rm : cx.rootMoveList)
+			if (rm.pv[0] != Predicted && rm.pv[0] != MOVE_NULL && int(Replies.size()) < HelperCnt)
+				Replies.push_back(rm.pv[0]);
+		Ranked = true;
+		RankCond.signal();
+		RankLock.unlock();
+	}
+	else
+	{
+		RankLock.lock();
+		while (!Ranked)
+			RankCond.wait(RankLock);
+		RankCond.signal();  // pass it on to the next waiting helper
+		RankLock.unlock();
+	}
+
+	if (id < int(Replies.size()))
+	{
+		Position root(Parent);
+		Move mv = Replies[id];
+		root.make_move(mv, replySt);
+		cx.limit.clear();
+		cx.limit.infinite = true;
+		if (search(root))
+			rootKey = root.key();
+	}
+
+	mutex.lock();
+	idle = true;
+	idleCond.signal();
+	while (exist)
+		sleepCond.wait(mutex);
+	mutex.unlock();
+}
+
+void stop()
+{
+	HelpersLock.lock();
+	for (Helper *h : Helpers)
+		h->cx.signal.stop = true;
+	HelpersLock.unlock();
+}
+
+void finish()
+{
+	stop();
+	for (Helper *h : Helpers)
+	{
+		h->mutex.lock();
+		while (!h->idle)
+			h->idleCond.wait(h->mutex);
+		h->mutex.unlock();
+	}
+}
+
+void end()
+{
+	finish();
+	HelpersLock.lock();
+	vector<Helper *> ended;
+	ended.swap(Helpers);
+	HelpersLock.unlock();
+	for (Helper *h : ended)
+		del_thread(h);
+}
+
+void start(const Position& parent, Move predicted, int replies, Transposition::Table *tt)
+{
+	end();
+	Parent = parent;
+	Predicted = predicted;
+	Replies.clear();
+	Ranked = false;
+	HelperCnt = replies;
+	HelperTT = tt;
+	for (int i = 0; i < replies; i++)
+	{
+		Helper *h = new_thread<Helper>();
+		HelpersLock.lock();
+		Helpers.push_back(h);
+		HelpersLock.unlock();
+	}
+}
+
+bool adopt(const Position& pos, Context& into)
+{
+	finish();
+	bool adopted = false;
+	for (Helper *h : Helpers)
+		if (h->rootKey == pos.key())
+		{
+			into.history = h->cx.history;
+			into.gains = h->cx.gains;
+			into.refutations = h->cx.refutations;
+			into.warmKey = h->rootKey;
+			into.warmMoves = h->cx.rootMoveList;
+			adopted = true;
+			break;
+		}
+	end();
+	return adopted;
+}
+
+const vector<Move>& replies() { return Replies; }
+
+} // namespace Ponder
@@ -9,6 +9,14 @@ const Position& Position::operator=(const Position& another)
 	startSt = *st;
 	st = &startSt;
 	nodes = 0;
+
+	// Recount only the states is_draw() can reach from here and from any position
+	// searched below: those since the last irreversible move
+	memset(repFilter, 0, sizeof(repFilter));
+	rep_add(st->key);
+	StateInfo *prev = st->st_prev;
+	for (int i = min(st->cntFiftyMove, st->cntInternalFiftyMove); i > 0 && prev; i--, prev = prev->st_prev)
+		rep_add(prev->key);
 	return *this;
 }
 
@@ -19,22 +27,7 @@ const Position& Position::operator=(const Position& another)
  */
 void Position::parse_fen(string fen)
 {
-	memset(this, 0, sizeof(Position)); // Sets everything, including startSt to 0
-	startSt.epSquare = SQ_NULL; // but a null ep square isn't 0
-	st = &startSt;
-
-	for (Color c : COLORS)
-		for (PieceType pt : PIECE_TYPES)
-			//Pieces[pt][c] = 0;   // already set to 0 by memset
-			//pieceCount[c][pt] = 0;
-			for (int idx = 0; idx < 16; idx++)
-				pieceList[c][pt][idx] = SQ_NULL;
-
-	for (int sq = 0; sq < SQ_N; sq++)
-	{
-		boardPiece[sq] = NON;
-		boardColor[sq] = COLOR_NULL;
-	}
+	clear_board();
 
 	string str;
 	istringstream iss(fen);
@@ -42,7 +35,6 @@ void Position::parse_fen(string fen)
 	int rank = 7; // FEN starts from the top rank
 	int file = 0;  // leftmost file
 	char ch;
-	Bit mask;
 	while ((ch = iss.get()) != ' ')
 	{
 		if (ch == '/') // move down a rank
@@ -54,7 +46,6 @@ void Position::parse_fen(string fen)
 			file += ch - '0';
 		else
 		{
-			mask = setbit(fr2sq(file, rank));  // r*8 + f
 			Color c = isupper(ch) ? W: B; 
 			ch = tolower(ch);
 			PieceType pt = NON;
@@ -67,24 +58,11 @@ void Position::parse_fen(string fen)
 			case 'q': pt = QUEEN; break;
 			case 'k': pt = KING; break;
 			}
-			Pieces[pt][c] |= mask;
-			Square sq = fr2sq(file, rank);
-			plistIndex[sq] = pieceCount[c][pt] ++;
-			pieceList[c][pt][plistIndex[sq]] = sq;
-			boardPiece[sq] = pt;
-			boardColor[sq] = c;
+			put_piece(fr2sq(file, rank), c, pt);
 			file ++;
 		}
 	}
 
-	for (Color c : COLORS)
-	{
-		Colormap[c] = 0;
-		for (PieceType pt : PIECE_TYPES)
-			Colormap[c] |= Pieces[pt][c];
-	}
-	Occupied = Colormap[W] | Colormap[B];
-
 	turn =  iss.get()=='w' ? W : B;  // indicate active side color
 
 	iss.get(); // consume the space
@@ -127,10 +105,40 @@ void Position::parse_fen(string fen)
 		cntHalfMove = (turn == B);
 	}
 
+	init_state();
+}
+
+// Empty board with a blank root state
+void Position::clear_board()
+{
+	memset(this, 0, sizeof(Position)); // Sets everything, including startSt to 0
+	startSt.epSquare = SQ_NULL; // but a null ep square isn't 0
+	st = &startSt;
+	memset(pieceList, SQ_NULL, sizeof(pieceList));
+	memset(board, EMPTY_SQ, sizeof(board));
+}
+
+// Put a piece on an empty square. Only used to set up a new position
+void Position::put_piece(Square sq, Color c, PieceType pt)
+{
+	Bit mask = setbit(sq);
+	Pieces[pt][c] |= mask;
+	Colormap[c] |= mask;
+	Occupied |= mask;
+	plistIndex[sq] = pieceCount[c][pt] ++;
+	pieceList[c][pt][plistIndex[sq]] = sq;
+	board[sq] = make_piece(c, pt);
+}
+
+// Compute the root state from scratch, after the pieces, turn, 
+// castling rights, ep square and fifty move counter are in place
+void Position::init_state()
+{
 	st->captured = NON;
 	st->checkerMap = attackers_to(king_sq(turn),  ~turn);
 
 	st->key = calc_key();
+	rep_add(st->key);
 	st->materialKey = calc_material_key();
 	st->pawnKey = calc_pawn_key();
 	st->psqScore = calc_psq_score();
@@ -150,14 +158,14 @@ string Position::to_fen() const
 		for (int j = 0; j < 8; j++)
 		{
 			int sq = fr2sq(j, i);
-			if (boardPiece[sq] == NON)
+			if (piece_on(sq) == NON)
 			{
 				space ++;
 				if (j == 7)  fen << space;   // the last file
 			}
 			else
 			{
-				piece = PIECE_FEN[boardColor[sq]][boardPiece[sq]];
+				piece = PIECE_FEN[color_on(sq)][piece_on(sq)];
 				if (space == 0)
 					fen << piece;
 				else
@@ -198,10 +206,12 @@ U64 Position::calc_key() const
 	for (Color c : COLORS)  // castling hash
 		key ^= Zobrist::castle[c][st->castleRights[c]];
 
-	PieceType pt;
-	for (int sq = 0; sq < SQ_N; sq++)
-		if ((pt = boardPiece[sq]) != NON)
-			key ^= Zobrist::psq[boardColor[sq]][pt][sq];
+	Bit occ = Occupied;
+	while (occ)
+	{
+		Square sq = pop_lsb(occ);
+		key ^= Zobrist::psq[color_on(sq)][piece_on(sq)][sq];
+	}
 
 	if ( st->epSquare != SQ_NULL)
 		key ^= Zobrist::ep[sq2file(st->epSquare)];
@@ -233,7 +243,7 @@ U64 Position::calc_pawn_key() const {
 	while (pawns)
 	{
 		int sq = pop_lsb(pawns);
-		key ^= Zobrist::psq[boardColor[sq]][PAWN][sq];
+		key ^= Zobrist::psq[color_on(sq)][PAWN][sq];
 	}
 	return key;
 }
@@ -242,10 +252,12 @@ U64 Position::calc_pawn_key() const {
 Score Position::calc_psq_score() const 
 {
 	Score score = SCORE_ZERO;
-	PieceType pt;
-	for (int sq = 0; sq < SQ_N; sq++)
-		if ((pt = boardPiece[sq]) != NON)
-			score += PieceSquareTable[boardColor[sq]][pt][sq];
+	Bit occ = Occupied;
+	while (occ)
+	{
+		Square sq = pop_lsb(occ);
+		score += PieceSquareTable[color_on(sq)][piece_on(sq)][sq];
+	}
 	return score;
 }
 
@@ -328,12 +340,12 @@ bool Position::is_pseudo(Move mv) const
 	Square from = get_from(mv);
 	Square to = get_to(mv);
 	Bit toMap = setbit(to);
-	PieceType pt = boardPiece[from];
-	PieceType destPt = boardPiece[to]; // destination piece
+	PieceType pt = piece_on(from);
+	PieceType destPt = piece_on(to); // destination piece
 
 	// If the from square is not occupied by a piece belonging to the side to
 	// move, the move is obviously not legal.
-	if (pt == NON || boardColor[from] != turn)
+	if (pt == NON || color_on(from) != turn)
 		return false;
 
 	// The destination square cannot be occupied by a friendly piece
@@ -361,7 +373,7 @@ bool Position::is_pseudo(Move mv) const
 		case DELTA_SW: case DELTA_SE:
 			// Capture. The destination square must be occupied by an enemy
 			// piece (en passant captures was handled earlier).
-			if (destPt == NON || boardColor[to] != ~turn)
+			if (destPt == NON || color_on(to) != ~turn)
 				return false;
 
 			// From and to files must be one file apart, avoids a7h5
@@ -381,7 +393,7 @@ bool Position::is_pseudo(Move mv) const
 			// source and destination squares must be empty.
 			if (    sq2rank(to) != RANK_4
 				|| destPt != NON
-				|| boardPiece[from + DELTA_N] != NON )
+				|| piece_on(from + DELTA_N) != NON )
 				return false;
 			break;
 
@@ -391,7 +403,7 @@ bool Position::is_pseudo(Move mv) const
 			// source and destination squares must be empty.
 			if (    sq2rank(to) != RANK_5
 				|| destPt != NON
-				|| boardPiece[from + DELTA_S] != NON )
+				|| piece_on(from + DELTA_S) != NON )
 				return false;
 			break;
 
@@ -436,7 +448,7 @@ bool Position::pseudo_is_legal(Move mv, Bit pinned) const
 {
 	Square from = get_from(mv);
 	Square to = get_to(mv);
-	if (boardPiece[from] == KING)  // we already checked castling legality
+	if (piece_on(from) == KING)  // we already checked castling legality
 		return is_castle(mv) || !is_sq_attacked(to, ~turn);
 
 	// EP is a very special "pin": K(a6), p(b6), P(c6), q(h6) - if P(c6)x(b7) ep, then q attacks K
@@ -463,7 +475,7 @@ bool Position::is_check(Move mv, const CheckInfo& ci) const
 {
 	Square from = get_from(mv);
 	Square to = get_to(mv);
-	PieceType pt = boardPiece[from];
+	PieceType pt = piece_on(from);
 
 	// Direct check
 	if (ci.pieceCheckMap[pt] & setbit(to))
@@ -530,6 +542,11 @@ bool Position::is_draw() const
 	if (st->cntFiftyMove >= 100 && !is_checkmate())
 		return true;
 
+	// Repetition filter: if no other position in the history shares the 
+	// current key's slot, the StateInfo walk below can't find anything
+	if (repFilter[st->key & REP_FILTER_MASK] < (Do3RepCheck ? 3 : 2))
+		return false;
+
 	// Repetition: check every even half-move
 	Depth start = 4;  // 3-fold repetition must have at least 4 previous half-move states
 		// number of previous states that might contain repetition
@@ -582,7 +599,7 @@ bool operator==(const Position& pos1, const Position& pos2)
 			if (pos1.Pieces[pt][c] != pos2.Pieces[pt][c])
 				{ cout << "false" << PIECE_FULL_NAME[pt] << " Pawns for Color " << c << ": " << pos1.Pieces[pt][c] << " != " << pos2.Pieces[pt][c] << endl;	return false;}
 			if (pos1.pieceCount[c][pt] != pos2.pieceCount[c][pt]) 
-				{ cout << "false pieceCount for Color " << c << " " << PIECE_FULL_NAME[pt] << ": " << pos1.pieceCount[c][pt] << " != " << pos2.pieceCount[c][pt] << endl;	return false;}
+				{ cout << "false pieceCount for Color " << c << " " << PIECE_FULL_NAME[pt] << ": " << (int)pos1.pieceCount[c][pt] << " != " << (int)pos2.pieceCount[c][pt] << endl;	return false;}
 			// test pieceList invariant
 			std::unordered_set<int> plset1, plset2;
 			for (int pc = 0; pc < pos1.pieceCount[c][pt]; pc++)
@@ -599,10 +616,10 @@ bool operator==(const Position& pos1, const Position& pos2)
 		{ cout << "false Occupied: " << pos1.Occupied << " != " << pos2.Occupied << endl;	return false;}
 	for (int sq = 0; sq < SQ_N; sq++)
 	{
-		if (pos1.boardPiece[sq] != pos2.boardPiece[sq]) 
-			{ cout << "false boardPiece for square " << sq2str(sq) << ": " << PIECE_FULL_NAME[pos1.boardPiece[sq]] << " != " << PIECE_FULL_NAME[pos2.boardPiece[sq]] << endl;	return false;}
-		if (pos1.boardColor[sq] != pos2.boardColor[sq]) 
-			{ cout << "false boardColor for square " << sq2str(sq) << ": " << pos1.boardColor[sq] << " != " << pos2.boardColor[sq] << endl;	return false;}
+		if (pos1.piece_on(sq) != pos2.piece_on(sq)) 
+			{ cout << "false board piece for square " << sq2str(sq) << ": " << PIECE_FULL_NAME[pos1.piece_on(sq)] << " != " << PIECE_FULL_NAME[pos2.piece_on(sq)] << endl;	return false;}
+		if (pos1.color_on(sq) != pos2.color_on(sq)) 
+			{ cout << "false board color for square " << sq2str(sq) << ": " << pos1.color_on(sq) << " != " << pos2.color_on(sq) << endl;	return false;}
 	}
 	
 	return true; // won't display anything if the test passes
@@ -626,10 +643,10 @@ string Position::print() const
 			{
 				int sq = fr2sq(fl, rk);
 				string str;
-				if (boardPiece[sq] == NON)  // checkered pattern
+				if (piece_on(sq) == NON)  // checkered pattern
 					str = ((rk + fl) % 2 == 1) ? " " : ".";
 				else
-					str = PIECE_FEN[boardColor[sq]][boardPiece[sq]];
+					str = PIECE_FEN[color_on(sq)][piece_on(sq)];
 				oss << "| " << str << " ";
 				if ( fl == FILE_H) oss << "|";
 			}
@@ -646,10 +663,10 @@ string Position::print() const
 			{
 				int sq = fr2sq(fl, rk);
 				string str;
-				if (boardPiece[sq] == NON)
+				if (piece_on(sq) == NON)
 					str = ".";
 				else
-					str = PIECE_FEN[boardColor[sq]][boardPiece[sq]];
+					str = PIECE_FEN[color_on(sq)][piece_on(sq)];
 				oss << str << " ";
 			}
 			oss << endl;
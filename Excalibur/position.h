@@ -5,6 +5,8 @@
 #include "board.h"
 #include "zobrist.h"
 
+struct PackedPosition; // packedpos.h
+
 /* Internal state of a position: used to unmake a move */
 struct StateInfo
 {
@@ -46,6 +48,20 @@ const CheckInfo ci_NULL; // pass a null CheckInfo for make_move version 2
 // Borrowed from Stockfish, used to partially copy the StateInfo struct. offsetof macro is defined in stddef.h
 const size_t STATEINFO_COPY_SIZE = offsetof(StateInfo, key) / sizeof(U64) + 1;
 
+// Position::board[] packs a square into (color << 3) | piece type, 
+// same as the 4-bit piece identifier layout in globals.h
+INLINE byte make_piece(Color c, PieceType pt) { return byte((c << 3) | pt); }
+const byte EMPTY_SQ = COLOR_NULL << 3;  // NON with COLOR_NULL
+
+// Position::repFilter[] counts the positions in the state history by their
+// low key bits. A slot count of 1 means the current position has no possible 
+// repetition, and is_draw() can skip walking the StateInfo chain.
+// A copy only counts the states a repetition can still reach, so a small
+// table does. A count saturates at REP_FILTER_FULL and then stays there.
+const int REP_FILTER_SIZE = 256;
+const U64 REP_FILTER_MASK = REP_FILTER_SIZE - 1;
+const byte REP_FILTER_FULL = 0xFF;
+
 // A few useful pseudonyms
 #define Pawnmap Pieces[PAWN]
 #define Kingmap Pieces[KING]
@@ -71,20 +87,25 @@ public:
 	Bit Colormap[COLOR_N];  // entire white/black army
 	Bit Occupied;  // everything
 
-	// Incrementally updated info, for fast access:
-	int pieceCount[COLOR_N][PIECE_TYPE_N];
-	Square pieceList[COLOR_N][PIECE_TYPE_N][16]; // records the square of all pieces
-	int plistIndex[SQ_N];  // helps update pieceList[][][]
-	PieceType boardPiece[SQ_N];  // records all piece types
-	Color boardColor[SQ_N];  // records all color distribution
+	StateInfo *st; // state pointer
+	U64 nodes;  // used to keep account of how many nodes have been searched. 
+	int cntHalfMove; // half move counter. starts at 1. The full move increments after black.
 	Color turn;
 
+	// Incrementally updated info, for fast access.
+	// Squares and counts all fit in a byte (SQ_NULL == 64), so the whole
+	// mailbox part of the position is 366 bytes instead of 1336.
+	byte pieceCount[COLOR_N][PIECE_TYPE_N];
+	byte board[SQ_N];  // packed color and piece type of each square. Read by piece_on() and color_on()
+	byte plistIndex[SQ_N];  // helps update pieceList[][][]
+	byte pieceList[COLOR_N][PIECE_TYPE_N][16]; // records the square of all pieces
+	byte repFilter[REP_FILTER_SIZE];  // incremented by make_move() and decremented by unmake_move()
+
 	// Internal states are stored in StateInfo class. Accessed externally as a history stack
-	StateInfo startSt;  // allocate on stack memory, init the state pointer
-	StateInfo *st; // state pointer
+	// The states made during the search live in a separately allocated Search::StateStack, 
+	// startSt only holds the root state. Kept at the end because it's cold.
+	StateInfo startSt;
 
-	U64 nodes;  // used to keep account of how many nodes have been searched. 
-	int cntHalfMove; // half move counter. starts at 1. The full move increments after black.
 	int ply() const { return cntHalfMove; }
 
 	void parse_fen(string fen); // parse a FEN position
@@ -102,6 +123,9 @@ public:
 		{ return Board::piece_attack(pt, turn, sq, Occupied); }
 
 	Square king_sq(Color c) const { return pieceList[c][KING][0]; }
+	// What's on a square. An empty square is NON with COLOR_NULL
+	PieceType piece_on(Square sq) const { return PieceType(board[sq] & 7); }
+	Color color_on(Square sq) const { return Color(board[sq] >> 3); }
 
 	bool is_map_attacked(Bit target, Color opp) const;  // return if any '1' in the target bitmap is attacked.
 	bool is_sq_attacked(Square sq, Color opp) const;  // return if the specified square is attacked. Inlined.
@@ -145,11 +169,11 @@ public:
 	CheckInfo check_info() const; // Get a CheckInfo instance that keeps all shared data about checking
 	bool is_check(Move mv, const CheckInfo& ci) const; // test if a move gives check
 	INLINE bool is_capture(Move mv) const
-		{ return boardPiece[Moves::get_to(mv)] != NON || Moves::is_ep(mv); }
+		{ return piece_on(Moves::get_to(mv)) != NON || Moves::is_ep(mv); }
 	INLINE bool is_quiet(Move mv) const // == not capture or promotion
 		{ return !(is_capture(mv) || Moves::is_promo(mv)); }
 	INLINE bool create_passed_pawn(Move mv) const // does this move create a passed pawn?
-		{ return boardPiece[Moves::get_from(mv)]==PAWN && is_pawn_passed(turn, Moves::get_to(mv)); }
+		{ return piece_on(Moves::get_from(mv))==PAWN && is_pawn_passed(turn, Moves::get_to(mv)); }
 	bool is_pseudo(Move mv) const;
 	bool pseudo_is_legal(Move mv, Bit pinned) const;  // test if a pseudo-legal move is legal, given the pinned map.
 	template<bool Do3RepCheck> bool is_draw() const;
@@ -181,6 +205,11 @@ public:
 	void make_null_move(StateInfo& nextSt); // for null move pruning
 	void unmake_null_move(); // for null move pruning
 
+	/* packedpos.cpp */
+	// Compact 32-byte binary encoding. Much faster than a FEN round trip.
+	void encode(PackedPosition& pp) const;
+	bool decode(const PackedPosition& pp);  // false if pp is malformed
+
 	/* perft.cpp */
 	// Recursive performance testing. Measure speed and accuracy. Used in test drives.
 	// raw node number counting: strictly legal moves.
@@ -188,6 +217,19 @@ public:
 	U64 perft(Depth depth); // start recursion from root
 
 private:
+	// Used by parse_fen() and decode() to build a position from scratch:
+	// clear_board() makes an empty board, put_piece() fills it, and finally
+	// init_state() computes the root state keys and scores.
+	void clear_board();
+	void put_piece(Square sq, Color c, PieceType pt);
+	void init_state();
+
+	// Counts a state in repFilter[] / takes it out again
+	INLINE void rep_add(U64 key)
+		{ byte& n = repFilter[key & REP_FILTER_MASK]; if (n != REP_FILTER_FULL) ++n; }
+	INLINE void rep_remove(U64 key)
+		{ byte& n = repFilter[key & REP_FILTER_MASK]; if (n != REP_FILTER_FULL) --n; }
+
 	// A checking move or not. 'discv' is the discovered check map
 	// 'discv' is needed by checking move generation. 'pinned' for legal move generation
 	template<PieceType, bool qcheck, bool legal>
@@ -0,0 +1,98 @@
+#include "profile.h"
+#include "thread.h"
+
+namespace Profiler
+{
+
+#ifdef PROFILE
+THREAD_LOCAL Record Local[SECTION_N];
+THREAD_LOCAL U64 *ChildCycles = nullptr;
+#endif
+
+// Snapshot of the last search, protected by 'lock'
+Record Last[SECTION_N];
+U64 LastTotal, LastNodes;
+Mutex lock;
+
+const char *SectionName[SECTION_N] =
+{
+	"evaluate", "material_probe", "pawn_probe", "gen_moves",
+	"make_move", "see", "next_move"
+};
+
+bool enabled()
+{
+#ifdef PROFILE
+	return true;
+#else
+	return false;
+#endif
+}
+
+void clear()
+{
+#ifdef PROFILE
+	memset(Local, 0, sizeof(Local));
+#endif
+}
+
+void publish(U64 total, U64 nodes)
+{
+#ifdef PROFILE
+	lock.lock();
+	memcpy(Last, Local, sizeof(Last));
+	LastTotal = total;
+	LastNodes = nodes;
+	lock.unlock();
+#endif
+}
+
+// Upper bound of the histogram bucket below which 'fraction' of the calls fall
+U64 percentile(const Record& r, double fraction)
+{
+	U64 count = 0;
+	for (int i = 0; i < HIST_BUCKETS; i++)
+		if ((count += r.hist[i]) >= fraction * r.calls)
+			return 2ULL << i;
+	return 0;
+}
+
+string report()
+{
+	if (!enabled())
+		return "Profiler is not compiled in. Rebuild with 'make PROFILE=1'";
+
+	Record rec[SECTION_N];
+	lock.lock();
+	memcpy(rec, Last, sizeof(rec));
+	U64 total = max<U64>(LastTotal, 1), nodes = max<U64>(LastNodes, 1);
+	lock.unlock();
+
+	int order[SECTION_N];
+	for (int i = 0; i < SECTION_N; i++)
+		order[i] = i;
+	std::sort(order, order + SECTION_N, 
+		[&](int a, int b) { return rec[a].selfCycles > rec[b].selfCycles; });
+
+	ostringstream oss;
+	oss << fixed << setprecision(1)
+		<< "info string profile total " << total << " cycles " 
+		<< total / nodes << " cycles/node";
+	U64 timed = 0;
+	for (int k = 0; k < SECTION_N; k++)
+	{
+		const Record& r = rec[order[k]];
+		timed += r.selfCycles;
+		oss << "\ninfo string profile " << setw(14) << SectionName[order[k]]
+			<< " self " << setw(5) << 100.0 * r.selfCycles / total << "%"
+			<< " calls " << setw(10) << r.calls
+			<< " cycles/call " << setw(6) << (r.calls ? r.cycles / r.calls : 0)
+			<< " self cycles/node " << setw(6) << r.selfCycles / nodes
+			<< " p50 <" << percentile(r, 0.5) << " p99 <" << percentile(r, 0.99);
+	}
+	oss << "\ninfo string profile " << setw(14) << "rest"
+		<< " self " << setw(5) << 100.0 * (total - min(timed, total)) / total << "%";
+	return oss.str();
+}
+
+} // namespace Profiler
@@ -0,0 +1,116 @@
+/*
+ *	Cycle counting profiler for the hot paths of the search.
+ *	Compiled in only with -DPROFILE (make PROFILE=1). Otherwise PROFILE_SCOPE()
+ *	expands to nothing.
+ *	A ScopedTimer reads the time stamp counter when it is constructed and
+ *	destructed, and charges the difference to its section. Time spent in nested
+ *	timed sections is subtracted, so the "self" cycles of all sections add up.
+ *	Each thread fills its own records, which are published when its search ends.
+ *	Cycles are TSC ticks: on modern CPUs they run at the nominal frequency,
+ *	whatever the current clock speed.
+ */
+
+#ifndef __profile_h__
+#define __profile_h__
+
+#include "utils.h"
+#if defined(_MSC_VER)
+#  include <intrin.h>
+#elif defined(__i386__) || defined(__x86_64__)
+#  include <x86intrin.h>
+#endif
+
+namespace Profiler
+{
+	enum Section
+	{
+		EVALUATE, MATERIAL_PROBE, PAWN_PROBE, GEN_MOVES, 
+		MAKE_MOVE, SEE, NEXT_MOVE,
+		SECTION_N
+	};
+
+	// Histogram bucket i counts the calls that took [2^i, 2^(i+1)) cycles
+	const int HIST_BUCKETS = 32;
+
+	struct Record
+	{
+		U64 calls;
+		U64 cycles;  // including nested sections
+		U64 selfCycles;
+		U64 hist[HIST_BUCKETS];
+	};
+
+	// Time stamp counter. Falls back to nanoseconds on other architectures
+	inline U64 cycles()
+	{
+#if defined(_MSC_VER) || defined(__i386__) || defined(__x86_64__)
+		return __rdtsc();
+#else
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+	}
+
+	// rdtscp waits for the timed code to complete before reading the counter
+	inline U64 cycles_end()
+	{
+#if defined(_MSC_VER) || defined(__i386__) || defined(__x86_64__)
+		unsigned aux;
+		return __rdtscp(&aux);
+#else
+		return cycles();
+#endif
+	}
+
+#ifdef PROFILE
+	extern THREAD_LOCAL Record Local[SECTION_N];
+	extern THREAD_LOCAL U64 *ChildCycles;  // nested cycles counter of the innermost timer
+
+	// RAII timer. Charges its lifetime to a section
+	class ScopedTimer
+	{
+	public:
+		ScopedTimer(Section s) : section(s), children(0), parent(ChildCycles)
+		{
+			ChildCycles = &children;
+			start = cycles();
+		}
+
+		~ScopedTimer()
+		{
+			U64 elapsed = cycles_end() - start;
+			Record& r = Local[section];
+			r.calls ++;
+			r.cycles += elapsed;
+			r.selfCycles += elapsed - children;
+			r.hist[min(msb(elapsed | 1), HIST_BUCKETS - 1)] ++;
+
+			ChildCycles = parent;
+			if (parent)
+				*parent += elapsed;
+		}
+
+	private:
+		Section section;
+		U64 start, children;
+		U64 *parent;
+	};
+
+#  define PROFILE_SCOPE(section) \
+	Profiler::ScopedTimer profileTimer(Profiler::section)
+#else
+#  define PROFILE_SCOPE(section)
+#endif
+
+	// Compiled with -DPROFILE?
+	bool enabled();
+	// Resets the calling thread's records. Called when a search starts
+	void clear();
+	// Copies the calling thread's records to the shared snapshot. Called when a search ends.
+	// 'total' is the number of cycles of the whole search
+	void publish(U64 total, U64 nodes);
+	// Flat profile of the last search, sorted by self cycles. One section per line
+	string report();
+}
+
+#endif // __profile_h__
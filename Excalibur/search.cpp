@@ -5,6 +5,9 @@
 #include "search.h"
 #include "eval.h"
 #include "uci.h"
+#include "thread.h"
+#include "stats.h"
+#include "trace.h"
 
 using namespace Eval;
 using namespace Search;
@@ -14,7 +17,21 @@ using namespace Board;
 using namespace UCI;
 
 using Transposition::Entry;
-using Transposition::TT;
+using Transposition::ThreadTT;
+
+// Checks the limits once every POLL_INTERVAL nodes, see search.h
+INLINE void poll_limits(const Position& pos)
+{
+	if (pos.nodes >= Ctx->nextPoll)
+	{
+		Ctx->nextPoll = pos.nodes + POLL_INTERVAL;
+		if (Ctx->limit.nodes)
+			Ctx->nextPoll = min<U64>(Ctx->nextPoll, Ctx->limit.nodes);
+		check_time();
+		if (!Ctx->silent)
+			print_live_info();
+	}
+}
 
 /**********************************************/
 /**************** Search Engine *****************/
@@ -25,7 +42,7 @@ Value Search::search(Position& pos, SearchInfo* ss, Value alpha, Value beta, Dep
 	const bool isPV = (NT == PV || NT == ROOT);
 	const bool isRoot = NT == ROOT;
 
-	StateInfo nextSt;
+	StateInfo& nextSt = *ss->nextSt; // our child's state. Never used by a deeper ply
 	Entry *tte; // transposition table
 	U64 key;
 	Move ttMv, mv, excludedMv, bestMv, threatMv; // mv is temp
@@ -49,13 +66,19 @@ Value Search::search(Position& pos, SearchInfo* ss, Value alpha, Value beta, Dep
 	(ss+1)->skipNullMv = false;
 	(ss+1)->reduction = DEPTH_ZERO;
 	(ss+2)->killerMvs[0] = (ss+2)->killerMvs[1] = MOVE_NULL;
+	STAT_INC(NODES);
+	TRACE_NODE(isRoot ? Trace::ROOT_NODE : isPV ? Trace::PV_NODE : Trace::NON_PV_NODE);
 
 	if (!isRoot)
 	{
+		poll_limits(pos);
+
 		//####### Aborted search and immediate draw  #######//
 		// We don't use the full 3-repetition check.
-		if (Signal.stop || pos.is_draw<false>() || ss->ply > MAX_PLY)
-			return DrawValue[pos.turn];
+		if (Ctx->signal.stop)
+			return TRACED(ABORTED, Ctx->drawValue[pos.turn]);
+		if (pos.is_draw<false>() || ss->ply > MAX_PLY)
+			return TRACED(DRAW, Ctx->drawValue[pos.turn]);
 
 		//####### Mate distance pruning. #######//
 		// Even if we mate at the next move our score
@@ -67,7 +90,7 @@ Value Search::search(Position& pos, SearchInfo* ss, Value alpha, Value beta, Dep
 		alpha = max(mated_value(ss->ply), alpha);
 		beta = min(mate_value(ss->ply + 1), beta);
 		if (alpha >= beta)
-			return alpha;
+			return TRACED(MATE_DISTANCE, alpha);
 	}
 	//else if (pos.is_draw<true>()) // Enable full 3-repetition draw check only at Root
 	//	return DrawValue[pos.turn];
@@ -78,8 +101,10 @@ Value Search::search(Position& pos, SearchInfo* ss, Value alpha, Value beta, Dep
 	// TT value, so we use a different position key in case of an excluded move.
 	excludedMv = ss->excludedMv;
 	key = excludedMv ? (pos.key() ^ Zobrist::exclusion) : pos.key();
-	tte = TT.probe(key);
-	ttMv = isRoot ? RootMoveList[0].pv[0] : 
+	tte = ThreadTT->probe(key);
+	STAT_INC(TT_PROBES);
+	if (tte)	STAT_INC(TT_HITS);
+	ttMv = isRoot ? Ctx->rootMoveList[Ctx->pvIdx].pv[0] : 
 				tte ? tte->move : MOVE_NULL;
 	ttVal = tte ? tt2value(tte->value, ss->ply) : VALUE_NULL;
 
@@ -93,7 +118,7 @@ Value Search::search(Position& pos, SearchInfo* ss, Value alpha, Value beta, Dep
 		ttVal >= beta ? (tte->bound & BOUND_LOWER) // lower bound or exact
 							: (tte->bound & BOUND_UPPER) )) // upper bound or exact
 	{
-		TT.update_generation(tte);
+		ThreadTT->update_generation(tte);
 		ss->currentMv = ttMv; // might be NULL
 
 		// Update killer heuristics
@@ -106,7 +131,8 @@ Value Search::search(Position& pos, SearchInfo* ss, Value alpha, Value beta, Dep
 			ss->killerMvs[0] = ttMv; // overwrite the first killer entry (old)
 		}
 
-		return ttVal;
+		STAT_INC(TT_CUTOFFS);
+		return TRACED(TT_CUTOFF, ttVal);
 	}
 
 
@@ -132,7 +158,7 @@ Value Search::search(Position& pos, SearchInfo* ss, Value alpha, Value beta, Dep
 		else // No TT entry found. Write and store a new entry
 		{
 			eval = ss->staticEval = evaluate(pos, ss->staticMargin);
-			TT.store(key, VALUE_NULL, BOUND_NULL, DEPTH_NULL, MOVE_NULL, 
+			ThreadTT->store(key, VALUE_NULL, BOUND_NULL, DEPTH_NULL, MOVE_NULL, 
 						ss->staticEval, ss->staticMargin);
 		}
 
@@ -147,7 +173,7 @@ Value Search::search(Position& pos, SearchInfo* ss, Value alpha, Value beta, Dep
 			&& is_normal(mv) )
 		{
 			Square to = get_to(mv);
-			Gains.update(pos, to, to, 
+			Ctx->gains.update(pos, to, to, 
 				-(ss-1)->staticEval - ss->staticEval); // eval difference. (ss-1) Eval is negated because side changed.
 		}
 
@@ -161,12 +187,16 @@ Value Search::search(Position& pos, SearchInfo* ss, Value alpha, Value beta, Dep
 			// No pawns ready to promote.
 			&& !(pos.Pawnmap[pos.turn] & rank_mask(relative_rank<RANK_N>(pos.turn, RANK_7))) )
 		{
+			STAT_INC(RAZOR_TRIES);
 			Value redBeta = beta - razor_margin(depth); // reduced beta
 			Value val = qsearch<NON_PV, false>(pos, ss, redBeta-1, redBeta);
 			if (val < redBeta)
+			{
+				STAT_INC(RAZOR_CUTOFFS);
 				// Logically we should return (v + razor_margin(depth)), but
 					// surprisingly this did slightly weaker in tests.
-						return val;
+						return TRACED(RAZOR, val);
+			}
 		}
 
 
@@ -180,7 +210,10 @@ Value Search::search(Position& pos, SearchInfo* ss, Value alpha, Value beta, Dep
 			&& abs(beta) < VALUE_MATE_IN_MAX_PLY
 			&& abs(eval) < VALUE_KNOWN_WIN
 			&& pos.non_pawn_material(pos.turn) )
-			return eval - futility_margin(depth, (ss-1)->futilityMvCnt);
+		{
+			STAT_INC(STATIC_NULL_CUTOFFS);
+			return TRACED(STATIC_NULL, eval - futility_margin(depth, (ss-1)->futilityMvCnt));
+		}
 
 
 		//####### Null move pruning with verification search #######//
@@ -196,6 +229,7 @@ Value Search::search(Position& pos, SearchInfo* ss, Value alpha, Value beta, Dep
 			&& pos.non_pawn_material(pos.turn) )
 		{
 			ss->currentMv = MOVE_NULL;
+			STAT_INC(NULL_TRIES);
 
 			// Null move dynamic reduction based on depth
 			Depth R = 3 * ONE_PLY + depth / 4;
@@ -219,15 +253,22 @@ Value Search::search(Position& pos, SearchInfo* ss, Value alpha, Value beta, Dep
 					nullVal = beta;
 
 				if (depth < 12 * ONE_PLY)
-					return nullVal;
+				{
+					STAT_INC(NULL_CUTOFFS);
+					return TRACED(NULL_MOVE, nullVal);
+				}
 
 				// Do verification search at high depths
+				STAT_INC(NULL_VERIFICATIONS);
 				ss->skipNullMv = true;
 				Value val = search<NON_PV>(pos, ss, alpha, beta, depth-R, false);
 				ss->skipNullMv = false;
 
 				if (val >= beta)
-					return nullVal;
+				{
+					STAT_INC(NULL_CUTOFFS);
+					return TRACED(NULL_MOVE, nullVal);
+				}
 			}
 			else
 			{
@@ -244,7 +285,7 @@ Value Search::search(Position& pos, SearchInfo* ss, Value alpha, Value beta, Dep
 					&& threatMv != MOVE_NULL
 					&& (ss-1)->reduction
 					&& allows(pos, (ss-1)->currentMv, threatMv) )
-					return alpha; // fail-low score
+					return TRACED(NULL_THREAT, alpha); // fail-low score
 			}
 		}
 
@@ -255,12 +296,13 @@ Value Search::search(Position& pos, SearchInfo* ss, Value alpha, Value beta, Dep
 			&& (isPV || ss->staticEval + 256 >= beta) )
 		{
 			Depth d = depth  - 2 * ONE_PLY - (isPV ? DEPTH_ZERO : depth / 4);
+			STAT_INC(IID_SEARCHES);
 
 			ss->skipNullMv = true;
 			search<isPV ? PV : NON_PV>(pos, ss, alpha, beta, d, true);
 			ss->skipNullMv = false;
 
-			tte = TT.probe(key);
+			tte = ThreadTT->probe(key);
 			ttMv = tte ? tte->move : MOVE_NULL; // iterative deepening result
 		}
 
@@ -273,11 +315,11 @@ Value Search::search(Position& pos, SearchInfo* ss, Value alpha, Value beta, Dep
 	//####### Retrieve info from the RefutationStats table #######//
 	// prevTo will be later used to update Refutations table
 	Square prevTo = get_to((ss-1)->currentMv);
-	pair<Move, Move> refutEntry = Refutations.get(pos, prevTo, prevTo);
+	pair<Move, Move> refutEntry = Ctx->refutations.get(pos, prevTo, prevTo);
 	Move refutationMvs[2] = { refutEntry.first, refutEntry.second };
 
 	//####### Init a MoveSorter with the refutation entry #######//
-	MoveSorter Msorter(pos, ttMv, depth, History, refutationMvs, ss);
+	MoveSorter Msorter(pos, ttMv, depth, Ctx->history, refutationMvs, ss);
 
 	isImproved = ss->staticEval >= (ss-2)->staticEval
 		|| ss->staticEval == VALUE_NULL
@@ -295,6 +337,12 @@ Value Search::search(Position& pos, SearchInfo* ss, Value alpha, Value beta, Dep
 	/****************************************/
 	//####### Move generation and looping  #######//
 	CheckInfo ci = pos.check_info();
+	// Index the root moves still to be searched. Entries left over from other
+	// moves are caught by the pv[0] comparison in the loop below
+	if (isRoot)
+		for (size_t i = Ctx->pvIdx; i < Ctx->rootMoveList.size(); i++)
+			Ctx->rootIndex[Ctx->rootMoveList[i].pv[0]] = byte(i);
+
 	// Loop through all pseudo legals until no more or beta cutoff
 	while ((mv = Msorter.next_move()) != MOVE_NULL)
 	{
@@ -303,18 +351,28 @@ Value Search::search(Position& pos, SearchInfo* ss, Value alpha, Value beta, Dep
 
 		// At root obey the "searchmoves" option and skip moves not listed in Root
 		// Move List, as a consequence any illegal move is also skipped. 
-		// Rmv (iterator-pointer) records the location of mv, if present, in RootMoveList
+		// With MultiPV, the lines already found in this iteration are skipped too.
+		// Rmv points to mv, if present, in RootMoveList. Found by Ctx->rootIndex
+		// instead of a linear scan, which a 200-move root would pay for every move.
 		// If mv returns a good value, Rmv will be updated accordingly after all the search.
 		// Rmv will be referenced later on
-		decltype(RootMoveList.begin()) Rmv;
-		// If find() returns the end iterator, then the element isn't found
-		if ( isRoot &&
-			(Rmv = std::find(RootMoveList.begin(), RootMoveList.end(), mv)) 
-			== RootMoveList.end())
-			continue;
+		RootMove *Rmv = nullptr;
+		if (isRoot)
+		{
+			size_t idx = Ctx->rootIndex[mv];
+			if (idx < Ctx->pvIdx || idx >= Ctx->rootMoveList.size()
+					|| Ctx->rootMoveList[idx].pv[0] != mv)
+				continue;
+			Rmv = &Ctx->rootMoveList[idx];
+		}
 
 		moveCnt ++;
 
+		// Only the root pays for the clock read, a few dozen times per iteration
+		if (isRoot && !Ctx->silent && now() - Ctx->searchTime > 3000)
+			sync_print("info depth " << depth / ONE_PLY << " currmove " << move2uci(mv)
+				<< " currmovenumber " << moveCnt);
+
 		extDepth = DEPTH_ZERO; // extended depth
 		isCaptOrPromo = !pos.is_quiet(mv);
 		renderCheck = pos.is_check(mv, ci);  // Whether this move checks the opp
@@ -339,6 +397,7 @@ Value Search::search(Position& pos, SearchInfo* ss, Value alpha, Value beta, Dep
 			&& pos.pseudo_is_legal(mv, ci.pinned)
 			&& abs(ttVal) < VALUE_KNOWN_WIN )
 		{
+			STAT_INC(SINGULAR_TRIES);
 			Value redBeta = ttVal - depth;
 			ss->excludedMv = mv;
 			ss->skipNullMv = true;
@@ -347,7 +406,10 @@ Value Search::search(Position& pos, SearchInfo* ss, Value alpha, Value beta, Dep
 			ss->excludedMv = MOVE_NULL;
 
 			if (value < redBeta)
+			{
+				STAT_INC(SINGULAR_EXTENSIONS);
 				extDepth = ONE_PLY;
+			}
 		}
 
 		// Update depth: must be done after Singular Extension
@@ -365,7 +427,10 @@ Value Search::search(Position& pos, SearchInfo* ss, Value alpha, Value beta, Dep
 				&& moveCnt >= FutilityMoveCounts[isImproved][depth]
 			// A threat move is created when a null move search fails low
 			&& (!threatMv || !refutes(pos, mv, threatMv)) )
+			{
+				STAT_INC(FUTILITY_MOVE_COUNT);
 				continue;
+			}
 
 			// Value based pruning
 			// We illogically ignore reduction condition depth >= 3*ONE_PLY for predicted depth,
@@ -374,10 +439,11 @@ Value Search::search(Position& pos, SearchInfo* ss, Value alpha, Value beta, Dep
 
 			futilityVal = ss->staticEval + ss->staticMargin 
 					+ futility_margin(predictDepth, moveCnt)
-					+ Gains.get(pos, get_from(mv), get_to(mv));
+					+ Ctx->gains.get(pos, get_from(mv), get_to(mv));
 
 			if (futilityVal < beta)
 			{
+				STAT_INC(FUTILITY_VALUE);
 				best = max(best, futilityVal);
 				continue;
 			}
@@ -385,7 +451,10 @@ Value Search::search(Position& pos, SearchInfo* ss, Value alpha, Value beta, Dep
 			// Prune moves with negative SEE at low depths
 			if ( predictDepth < 4 * ONE_PLY
 				&& see_sign(pos, mv) < 0 )
+			{
+				STAT_INC(FUTILITY_SEE);
 				continue;
+			}
 
 			// We have not pruned the move that will be searched, but remember how
 			// far in the move list we are to be more aggressive in the child node.
@@ -434,10 +503,12 @@ Value Search::search(Position& pos, SearchInfo* ss, Value alpha, Value beta, Dep
 
 			Depth d = max(newDepth - ss->reduction, ONE_PLY);
 
+			STAT_INC(LMR_SEARCHES);
 			value = -search<NON_PV>(pos, ss+1, -alpha-1, -alpha, d, true);
 
 			// This bool decides if we fail high and must re-search at full
 			fullDepthSearch = ( value > alpha && ss->reduction != DEPTH_ZERO);
+			if (fullDepthSearch)	STAT_INC(LMR_RESEARCHES);
 			ss->reduction = DEPTH_ZERO; // complete reduction and reset
 		}
 		else
@@ -475,13 +546,13 @@ Value Search::search(Position& pos, SearchInfo* ss, Value alpha, Value beta, Dep
 		// was aborted because the user interrupted the search or because we
 		// ran out of time. In this case, the return value of the search cannot
 		// be trusted, and we don't update the best move and/or PV.
-		if (Signal.stop)
-			return value; // avoid returning INFINITE
+		if (Ctx->signal.stop)
+			return TRACED(ABORTED, value); // avoid returning INFINITE
 
 		//####### See if we've got new best moves #######//
 		if (isRoot)
 		{
-			// Rmv (an iterator-pointer) records the location of mv in RootMoveList. 
+			// Rmv (a pointer) records the location of mv in RootMoveList. 
 			// Obtained at the beginning of this next_move() iteration
 			if (isPvMove || value > alpha) // PV more or new best move?
 			{
@@ -493,7 +564,7 @@ Value Search::search(Position& pos, SearchInfo* ss, Value alpha, Value beta, Dep
 				// the best move changes frequently, we allocate some more time.
 				// Done by Timer.unstable_pv_adjust() in iterative deepening
 				if (!isPvMove) // means value > alpha, our new best move
-					BestMoveChanges ++;
+					Ctx->bestMoveChanges ++;
 			}
 			else
 				// All other moves but the PV are set to the lowest value, this
@@ -513,7 +584,11 @@ Value Search::search(Position& pos, SearchInfo* ss, Value alpha, Value beta, Dep
 				if (isPV && value < beta)
 					alpha = value;  // update alpha. Always have alpha < beta
 				else // value >= beta, fail high
+				{
+					STAT_INC(FAIL_HIGHS);
+					if (moveCnt == 1)	STAT_INC(FAIL_HIGHS_FIRST);
 					break; // Beta cut off. Exit the MoveSorter loop. 
+				}
 			}
 		}
 	} // EndWhile of MoveSorter.next_move(). Move generation and make/unmake moves complete.
@@ -525,8 +600,8 @@ Value Search::search(Position& pos, SearchInfo* ss, Value alpha, Value beta, Dep
 	// case of Signals.stop are set, but this is
 	// harmless because return value is discarded anyhow in the parent nodes.
 	if (moveCnt == 0)
-		return excludedMv ? alpha 
-					: inCheck ? mated_value(ss->ply) : DrawValue[pos.turn];
+		return TRACED(NO_MOVES, excludedMv ? alpha 
+					: inCheck ? mated_value(ss->ply) : Ctx->drawValue[pos.turn]);
 
 	// If we have pruned all the moves without searching return a fail-low score
 	if (best == -VALUE_INFINITE)
@@ -537,7 +612,7 @@ Value Search::search(Position& pos, SearchInfo* ss, Value alpha, Value beta, Dep
 	BoundType ttBound = best >= beta ? BOUND_LOWER
 		: isPV && bestMv ? BOUND_EXACT : BOUND_UPPER;
 
-	TT.store(key, value2tt(best, ss->ply),
+	ThreadTT->store(key, value2tt(best, ss->ply),
 				ttBound, depth, bestMv, ss->staticEval, ss->staticMargin);
 
 
@@ -556,19 +631,19 @@ Value Search::search(Position& pos, SearchInfo* ss, Value alpha, Value beta, Dep
 		// played non-capture moves.
 		// Common value used for history heuristics is depth-squared
 		Value bonus = depth * depth;
-		History.update(pos, get_from(bestMv), get_to(bestMv), bonus);
+		Ctx->history.update(pos, get_from(bestMv), get_to(bestMv), bonus);
 		for (int i = 0; i < quietCnt - 1; i++)
 		{
 			Move qm = quietMvsSearched[i];
-			History.update(pos, get_from(qm), get_to(qm), -bonus);
+			Ctx->history.update(pos, get_from(qm), get_to(qm), -bonus);
 		}
 
 		if ( (ss-1)->currentMv != MOVE_NULL)
-			Refutations.update(pos, prevTo, prevTo, bestMv);
+			Ctx->refutations.update(pos, prevTo, prevTo, bestMv);
 	}
 
 	//####### ALL DONE #######//
-	return best;
+	return TRACED(SEARCHED, best);
 }
 
 // Explicit instantiation
@@ -591,7 +666,7 @@ Value Search::qsearch(Position& pos, SearchInfo* ss, Value alpha, Value beta, De
 {
 	const bool isPV = (NT == PV);
 
-	StateInfo nextSt;
+	StateInfo& nextSt = *ss->nextSt;
 	Entry *tte; // transposition table
 	U64 key;
 	Move ttMv, mv, bestMv; // mv is temp
@@ -605,10 +680,15 @@ Value Search::qsearch(Position& pos, SearchInfo* ss, Value alpha, Value beta, De
 
 	ss->currentMv = bestMv = MOVE_NULL;
 	ss->ply = (ss-1)->ply + 1;
+	STAT_INC(QNODES);
+	TRACE_NODE(isPV ? Trace::QS_PV_NODE : Trace::QS_NON_PV_NODE);
 
-	//####### Instant draw or maximum ply reached #######//
+	//####### Aborted search, instant draw or maximum ply reached #######//
+	poll_limits(pos);
+	if (Ctx->signal.stop)
+		return TRACED(ABORTED, Ctx->drawValue[pos.turn]);
 	if (pos.is_draw<false>() || ss->ply > MAX_PLY)
-		return DrawValue[pos.turn];
+		return TRACED(DRAW, Ctx->drawValue[pos.turn]);
 
 	// Decide whether or not to include checks, this fixes also the type of
 	// TT entry depth that we are going to use. Note that in qsearch we use
@@ -618,7 +698,9 @@ Value Search::qsearch(Position& pos, SearchInfo* ss, Value alpha, Value beta, De
 
 	//####### Transposition Lookup #######//
 	key = pos.key();
-	tte = TT.probe(key);
+	tte = ThreadTT->probe(key);
+	STAT_INC(TT_PROBES);
+	if (tte)	STAT_INC(TT_HITS);
 	ttMv = tte ? tte->move : MOVE_NULL;
 	ttVal = tte ? tt2value(tte->value, ss->ply) : VALUE_NULL;
 
@@ -628,7 +710,8 @@ Value Search::qsearch(Position& pos, SearchInfo* ss, Value alpha, Value beta, De
 							(tte->bound & BOUND_UPPER) )) // upper bound or exact
 	{
 		ss->currentMv = ttMv; // can be MOVE_NULL
-		return ttVal;
+		STAT_INC(TT_CUTOFFS);
+		return TRACED(TT_CUTOFF, ttVal);
 	}
 
 	//####### Evaluate statically #######//
@@ -652,11 +735,12 @@ Value Search::qsearch(Position& pos, SearchInfo* ss, Value alpha, Value beta, De
 		// Return immediately if static value produces a beta cutoff. Write to TT also.
 		if (best >= beta)
 		{
+			STAT_INC(QS_STAND_PATS);
 			if (!tte)
-				TT.store(key, value2tt(best, ss->ply), 
+				ThreadTT->store(key, value2tt(best, ss->ply), 
 							BOUND_LOWER, DEPTH_NULL, MOVE_NULL, 
 							ss->staticEval, ss->staticMargin);
-			return best;
+			return TRACED(STAND_PAT, best);
 		}
 
 		if (isPV && best > alpha)
@@ -671,7 +755,7 @@ Value Search::qsearch(Position& pos, SearchInfo* ss, Value alpha, Value beta, De
 	// Because the depth is <= 0 here, only captures, queen promotions and checks
 	// (only if depth >= DEPTH_QS_CHECKS) will be generated.
 	// the last argument is the recapture square
-	MoveSorter Msorter(pos, ttMv, depth, History, get_to((ss-1)->currentMv));
+	MoveSorter Msorter(pos, ttMv, depth, Ctx->history, get_to((ss-1)->currentMv));
 
 	//####### Iterate through the moves until no more or a beta cutoff #####//
 	CheckInfo ci = pos.check_info();
@@ -689,11 +773,12 @@ Value Search::qsearch(Position& pos, SearchInfo* ss, Value alpha, Value beta, De
 			&& !pos.create_passed_pawn(mv) )
 		{
 			futilityVal = futilityBase 
-				+ PIECE_VALUE[EG][pos.boardPiece[get_to(mv)]]
+				+ PIECE_VALUE[EG][pos.piece_on(get_to(mv))]
 			+ is_ep(mv) ? EG_PAWN : VALUE_ZERO;
 
 			if (futilityVal < beta) // pruned
 			{
+				STAT_INC(QS_FUTILITY);
 				best = max(best, futilityVal);
 				continue;
 			}
@@ -704,6 +789,7 @@ Value Search::qsearch(Position& pos, SearchInfo* ss, Value alpha, Value beta, De
 			if ( futilityBase < beta
 				&& see(pos, mv, beta - futilityBase) <= 0 )
 			{
+				STAT_INC(QS_FUTILITY);
 				best = max(best, futilityBase);
 				continue;
 			}
@@ -721,7 +807,10 @@ Value Search::qsearch(Position& pos, SearchInfo* ss, Value alpha, Value beta, De
 			&& mv != ttMv
 			&& !is_promo(mv)
 			&& see_sign(pos, mv) < 0 )
+		{
+			STAT_INC(QS_SEE_PRUNES);
 			continue;
+		}
 
 		//####### Prune useless checks #######//
 		if (  !isPV
@@ -731,7 +820,10 @@ Value Search::qsearch(Position& pos, SearchInfo* ss, Value alpha, Value beta, De
 			&& pos.is_quiet(mv)  // not capture or promotion
 			&& ss->staticEval + MG_PAWN / 4 < beta
 			&& !is_check_dangerous(pos, mv, futilityBase, beta) )
+		{
+			STAT_INC(QS_CHECK_PRUNES);
 			continue;
+		}
 
 		// Guarantee legality before we make the move
 		if (!pos.pseudo_is_legal(mv, ci.pinned))
@@ -746,6 +838,10 @@ Value Search::qsearch(Position& pos, SearchInfo* ss, Value alpha, Value beta, De
 			: -qsearch<NT, false>(pos, ss+1, -beta, -alpha, depth - ONE_PLY);
 		pos.unmake_move(mv);
 
+		// Aborted search: don't let an untrusted value reach the TT
+		if (Ctx->signal.stop)
+			return TRACED(ABORTED, value);
+
 		// Do we have a new best move?
 		if (value > best)
 		{
@@ -760,10 +856,10 @@ Value Search::qsearch(Position& pos, SearchInfo* ss, Value alpha, Value beta, De
 				}
 				else // Fail high - beta cutoff
 				{
-					TT.store(key, value2tt(value, ss->ply), 
+					ThreadTT->store(key, value2tt(value, ss->ply), 
 								BOUND_LOWER, ttDepth, mv, 
 								ss->staticEval, ss->staticMargin);
-					return value;
+					return TRACED(SEARCHED, value);
 				}
 			}
 		}
@@ -773,12 +869,12 @@ Value Search::qsearch(Position& pos, SearchInfo* ss, Value alpha, Value beta, De
 	// All legal moves have been searched. A special case: If we're in check
 	// and no legal moves were found, it is checkmate.
 	if (UsInCheck && best == -VALUE_INFINITE)
-		return mated_value(ss->ply); // plies to mate from Root
+		return TRACED(NO_MOVES, mated_value(ss->ply)); // plies to mate from Root
 
 	// Write to Transposition table
-	TT.store( key, value2tt(best, ss->ply), 
+	ThreadTT->store( key, value2tt(best, ss->ply), 
 				isPV && best > alpha  ? BOUND_EXACT : BOUND_UPPER,
 				ttDepth, bestMv, ss->staticEval, ss->staticMargin);
 
-	return best;
+	return TRACED(SEARCHED, best);
 }
\ No newline at end of file
@@ -3,14 +3,15 @@
 
 #include "position.h"
 #include "material.h"
+#include "pawnshield.h"
+#include "eval.h"
 #include "ttable.h"
 #include "movesort.h"
 #include "timer.h"
 
 namespace Search
 {
-	void init(); // Lookup tables, Transposition reset and TimeKeeper
-	void think(); // External main interface
+	void init(); // Lookup tables and TimeKeeper
 
 	/// The SearchInfo keeps track of the information we need to remember from
 	/// nodes shallower and deeper in the tree during the search. Each search thread
@@ -26,8 +27,11 @@ namespace Search
 		Value staticMargin;
 		bool skipNullMv;
 		int futilityMvCnt;
+		StateInfo *nextSt; // the state made by this ply's moves, in the StateStack
 	};
 	typedef SearchInfo SearchStack[MAX_PLY + 6];
+	// StateInfo of every ply, allocated together instead of scattered across
+	// the search() frames. Keeps the st_prev chain walked by is_draw() compact
 	typedef StateInfo StateStack[MAX_PLY + 6];
 
 	
@@ -35,7 +39,7 @@ namespace Search
 	// threshold, we don't start the next iteration. 
 	// Can be set by UCI option "Time Usage"
 	extern double IterativeTimePercentThreshold; 
-	void iterative_deepen(Position& pos); // called in think()
+	void iterative_deepen(Position& pos); // called in run()
 
 	enum NodeType { ROOT, PV, NON_PV};
 
@@ -74,13 +78,14 @@ namespace Search
 	/// case of moves which fail low). Score is normally set at -VALUE_INFINITE for
 	/// all non-pv moves.
 	/// pv[] is null terminated because we might print out a stalemate (encoded as MOVE_NULL)
+	/// pv[] has a fixed capacity, so that the root search loop never touches the heap.
 	struct RootMove
 	{
-		RootMove(Move m) : score(-VALUE_INFINITE), prevScore(-VALUE_INFINITE)
-			{ pv.push_back(m); pv.push_back(MOVE_NULL); }
+		RootMove(Move m) : score(-VALUE_INFINITE), prevScore(-VALUE_INFINITE), depth(0)
+			{ pv[0] = m; pv[1] = MOVE_NULL; }
 
-		// We use std::stable_sort to sort in descending order. Thus need to overload '<' in reverse.
-		bool operator<(const RootMove& m) const { return score > m.score; }
+		// We use the stable insertion_sort() in utils.h, which sorts in descending order
+		bool operator<(const RootMove& m) const { return score < m.score; }
 		bool operator==(const Move& m) const { return pv[0] == m; }
 
 		// Extract PV from a transposition entry
@@ -90,45 +95,121 @@ namespace Search
 
 		Value score;
 		Value prevScore;
-		vector<Move> pv; // will be null terminated (MOVE_NULL).
+		Depth depth; // of the last iteration completed with this move at the root
+		Move pv[MAX_PLY + 1]; // will be null terminated (MOVE_NULL).
 	};
 
 
-	/*** Globals shared through the program, not just search-related functions */
-	extern LimitListener Limit;
-	// the program will re-read the value every time 
-	// instead of using a backup copy in the register
-	extern volatile SignalListener Signal;
-	extern Position RootPos;
-	extern Color RootColor;
-	extern vector<RootMove> RootMoveList;
-	extern U64 SearchTime; // start time of our search on the current move
-	extern TimeKeeper Timer;
-
 	// SetupStates are set by UCI command 'position' with a list
 	// of moves played on the internal board.
 	// Needed for functions like pos.is_draw(), which needs to trace
 	// back in state history.
 	typedef auto_ptr<stack<StateInfo>> SetupStatePtr;
-	extern SetupStatePtr SetupStates;
-  
-	// When playing handicap, limit the depth
-	// range from 0*2 to 10*2 - 10 being ELO unlimited
-	extern Depth handicap;
+
+	// Most lines a "MultiPV" search reports. Bounds the buffer of UCI::pv2uci()
+	const int MAX_MULTI_PV = 32;
+
+	/// Context holds everything one search owns: its limits, root moves and clock,
+	/// its playing style, and the tables it fills while searching. The TT is shared
+	/// unless 'tt' points to a table of the context's own.
+	/// Every search thread, like an Engine's (the UCI one included) or an 'analyze'
+	/// worker, binds its own context, so the searches run side by side.
+	struct Context
+	{
+		Context();
+
+		LimitListener limit;
+		// the program will re-read the value every time 
+		// instead of using a backup copy in the register
+		volatile SignalListener signal;
+		Position rootPos;
+		Color rootColor;
+		vector<RootMove> rootMoveList;
+		U64 searchTime; // start time of our search on the current move
+		U64 lastInfo; // when the last live info line was printed, see print_live_info()
+		TimeKeeper timer;
+		SetupStatePtr setupStates;
+		// When playing handicap, limit the depth
+		// range from 0*2 to 10*2 - 10 being ELO unlimited
+		Depth handicap;
+		int contempt; // "Contempt Factor" in centipawns, see update_contempt_factor()
+		Eval::Weights evalWeights;
+		// The TT this context searches with. The shared one unless the owner sets another
+		Transposition::Table *tt;
+		// No UCI 'info' output. Set by threads that collect the results themselves
+		bool silent;
+		// Called by the searching thread after each completed iteration
+		std::function<void()> onIteration;
+		int completedDepth; // of the last finished iteration, in plies
+		// "MultiPV": the best multiPV root moves each get an exact score and a PV.
+		// Every iteration searches them in turn, see iterative_deepen()
+		int multiPV;
+		size_t pvIdx; // the line being searched. Root moves before it are skipped
+		// "Warm Requery": a search of the same root as the last one, e.g. another
+		// 'searchmoves' subset, keeps the tables and starts from the depth its root
+		// moves already reached. warmMoves remembers them, see iterative_deepen()
+		bool warm;
+		U64 warmKey; // of the root warmMoves belong to
+		vector<RootMove> warmMoves;
+
+		// Used only by search-related functions
+		float bestMoveChanges;
+		Value drawValue[COLOR_N]; // set by contempt factor
+		HistoryStats history;
+		GainStats gains;
+		RefutationStats refutations;
+		U64 nextPoll; // node count of the next limit check, see SearchUtils::POLL_INTERVAL
+		// Root move -> its index in rootMoveList, rebuilt by every root search.
+		// Tells the root move loop in O(1) whether a move is to be searched
+		byte rootIndex[1 << 16];
+		Material::EntryTable materialTable;
+		Pawnshield::EntryTable pawnTable;
+
+		// Sets the playing style (evaluation weights, contempt and power level) from the
+		// UCI options. Options named in 'overrides' take its values instead
+		void read_options(const map<string, int>& overrides = map<string, int>());
+	};
+
+	// The names of the UCI options read_options() takes
+	const int STYLE_OPTION_N = 6;
+	extern const char *StyleOptions[STYLE_OPTION_N];
+
+	// The context of the threads that never bind one, e.g. 'perft'
+	extern Context MainContext;
+	// The context of the calling thread. MainContext unless the thread binds another
+	extern THREAD_LOCAL Context *Ctx;
+	// Makes 'cx' the context of the calling thread, evaluation tables included
+	void bind_context(Context& cx);
+
+	// Searches Ctx->rootPos within Ctx->limit on the calling thread.
+	// An Engine adds the book, the ponder wait and the UCI output around it
+	void run();
+	// "Warm Requery" bookkeeping of run() and iterative_deepen()
+	Depth warm_start();
+	void warm_save();
 	
 } // namespace Search
 
+/// Speculative pondering on the opponent's other likely replies, see ponder.cpp.
+/// Driven by one Engine at a time. Only stop() may be called from other threads
+namespace Ponder
+{
+	// Launches 'replies' helper threads, each on one of the best replies to
+	// 'parent' other than 'predicted', which the engine ponders on. They search in 'tt'
+	void start(const Position& parent, Move predicted, int replies, Transposition::Table *tt);
+	void stop(); // raises the helpers' stop signals and returns at once
+	void finish(); // stops them and waits until none touches its position any more
+	// Hands the work of the helper that pondered 'pos' to 'into', to be resumed like
+	// a "Warm Requery". Ends all the helpers. False if none pondered 'pos'
+	bool adopt(const Position& pos, Search::Context& into);
+	void end(); // ends all the helpers
+	const vector<Move>& replies(); // after finish(): the ones the helpers took, best first
+}
+
 
 /**********************************************/
 namespace SearchUtils
 {
-	// Globals shared by search-related functions
-	extern float BestMoveChanges;
-	extern Value DrawValue[COLOR_N]; // set by contempt factor
-	extern HistoryStats History;
-	extern GainStats Gains;
-	extern RefutationStats Refutations;
-
 	/**** Search data tables and their access functions ****/
 	// Dynamic razoring margin based on depth
 	inline Value razor_margin(Depth d)	{ return 512 + 16 * d; }
@@ -179,6 +260,13 @@ namespace SearchUtils
 			: v <= VALUE_MATED_IN_MAX_PLY ? v + ply : v;
 	}
 
+	/*********** In-search limit polling *************/
+	// Reading the clock at every node would be too slow. Instead, search<>()
+	// and qsearch<>() call check_time() every POLL_INTERVAL nodes, which takes 
+	// well under 1 ms. A 'go nodes' limit is polled exactly. A search that
+	// isn't silent prints its live info there too, see print_live_info().
+	const U64 POLL_INTERVAL = 1024;
+
 	/*********** Other utility functions *************/
 	bool is_check_dangerous(const Position& pos, Move mv, Value futilityBase, Value beta);
 	bool allows(const Position& pos, Move mv1, Move mv2);
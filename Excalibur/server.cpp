@@ -0,0 +1,504 @@
+/*
+ *	Analysis server. Syntax: serve <socket> [--threads N] [--memory MB]
+ *	One long-lived process answers any number of clients on a local Unix domain
+ *	socket, so the tables are built and the TT is allocated only once.
+ *	Every connection is a session that speaks a subset of UCI:
+ *		position [startpos | fen <fen>] [moves ...]
+ *		setoption name <play style option or MultiPV> value <v>
+ *		go [depth D] [nodes N] [movetime T] [deadline T] [infinite] [searchmoves ...]
+ *		stop, isready, quit, and 'shutdown' to stop the server
+ *	A search answers with an 'info' line per iteration and a 'bestmove' line.
+ *	'deadline' is how long in ms the client can wait for the bestmove, counted from
+ *	the time we read the 'go'. The searches of all sessions wait in one queue,
+ *	earliest deadline first, then those without one in order of arrival, for
+ *	a fixed pool of workers. A search starts with whatever time is left.
+ *	--memory is the budget for all the hash tables: the pawn and material tables
+ *	of the workers come off first, the shared TT gets the rest.
+ *	A single thread polls the listening socket and every session for input.
+ */
+#include "search.h"
+#include "uci.h"
+#include "thread.h"
+#include <thread>
+#include <memory>
+#include <queue>
+
+#ifndef _WIN32
+#  include <sys/socket.h>
+#  include <sys/stat.h>
+#  include <sys/un.h>
+#  include <poll.h>
+#  include <unistd.h>
+#  include <signal.h>
+#  include <errno.h>
+#endif
+
+using namespace Search;
+
+#ifndef _WIN32
+
+namespace Server
+{
+
+const U64 NoDeadline = ~0ULL;
+
+struct Job;
+
+struct Session
+{
+	Session(int fd) : fd(fd), fen(FEN_START) {}
+	~Session() { close(fd); }
+	// Sends a line to the client. Called by the poller and the workers
+	void send_line(const string& line);
+	// The same, when the caller already holds writeLock
+	void write_line(const string& line);
+
+	int fd;
+	string input;  // the incomplete line. Poller only
+	Mutex writeLock;
+	// Set by the poller. Every search takes a copy
+	string fen;
+	vector<Move> moves;
+	map<string, int> options;  // play style and MultiPV
+	shared_ptr<Job> job;  // the unfinished search, under QueueLock
+};
+
+struct Job
+{
+	Job() : stopped(false), cx(nullptr) {}
+
+	shared_ptr<Session> session;
+	string fen;
+	vector<Move> moves;
+	map<string, int> options;
+	LimitListener limit;
+	vector<string> searchMoves;
+	U64 deadline, seq;
+	// Under QueueLock: 'stop' before a worker took the job, or the worker's context
+	bool stopped;
+	Context *cx;
+};
+
+// The top of the queue is the earliest deadline, then the earliest arrival
+struct Later
+{
+	bool operator()(const shared_ptr<Job>& a, const shared_ptr<Job>& b) const
+		{ return a->deadline != b->deadline ? a->deadline > b->deadline : a->seq > b->seq; }
+};
+
+Mutex QueueLock;
+ConditionVar QueueCond;
+priority_queue<shared_ptr<Job>, vector<shared_ptr<Job>>, Later> Queue;
+bool Running;
+U64 NextSeq;
+Transposition::Table SharedTT;
+std::atomic<U64> Searches;
+
+void Session::send_line(const string& line)
+{
+	writeLock.lock();
+	write_line(line);
+	writeLock.unlock();
+}
+
+void Session::write_line(const string& line)
+{
+	string buf = line + "\n";
+	// A client that's gone only gives an error: SIGPIPE is ignored
+	for (size_t sent = 0; sent < buf.size(); )
+	{
+		ssize_t n = send(fd, buf.data() + sent, buf.size() - sent, 0);
+		if (n <= 0 && errno != EINTR)
+			return;
+		sent += max<ssize_t>(n, 0);
+	}
+}
+
+// Stops the session's search, queued or running
+void stop(Session& session)
+{
+	QueueLock.lock();
+	if (session.job)
+	{
+		if (session.job->cx)
+			session.job->cx->signal.stop = true;
+		else
+			session.job->stopped = true;  // the worker will find it stopped
+	}
+	QueueLock.unlock();
+}
+
+struct ServeWorker : public Thread
+{
+	ServeWorker();
+	virtual void execute();
+	void search();
+
+	Context cx;
+	shared_ptr<Job> job;
+	// The position of the job before the search takes a copy, and its moves
+	Position setupPos;
+	vector<StateInfo> states;
+};
+
+ServeWorker::ServeWorker()
+{
+	cx.silent = true;
+	cx.tt = &SharedTT;
+	cx.onIteration = [this] { job->session->send_line(UCI::pv2uci(cx.rootPos, cx.completedDepth)); };
+}
+
+void ServeWorker::execute()
+{
+	bind_context(cx);
+	while (true)
+	{
+		QueueLock.lock();
+		while (Queue.empty() && Running)
+			QueueCond.wait(QueueLock);
+		if (!Running)
+		{
+			QueueLock.unlock();
+			return;
+		}
+		job = Queue.top();
+		Queue.pop();
+		job->cx = &cx;
+		cx.signal.stopOnPonderhit = false;
+		cx.signal.stop = job->stopped;
+		QueueLock.unlock();
+
+		search();
+		job.reset();
+	}
+}
+
+void ServeWorker::search()
+{
+	setupPos.parse_fen(job->fen);
+	states.resize(job->moves.size());
+	for (size_t i = 0; i < job->moves.size(); i++)
+	{
+		Move mv = job->moves[i];
+		setupPos.make_move(mv, states[i]);
+	}
+	cx.rootPos = setupPos;  // the copy keeps the st_prev chain, so the search sees repetitions
+	cx.rootMoveList.clear();
+	MoveBuffer mbuf;
+	ScoredMove *it, *end = cx.rootPos.gen_moves<LEGAL>(mbuf);
+	for (it = mbuf; it != end; ++it)
+	{
+		bool searched = job->searchMoves.empty();
+		for (string mvstr : job->searchMoves)
+			searched |= UCI::uci2move(cx.rootPos, mvstr) == it->move;
+		if (searched)
+			cx.rootMoveList.push_back(RootMove(it->move));
+	}
+	if (cx.rootMoveList.empty())  // none of the searchmoves is legal
+		for (it = mbuf; it != end; ++it)
+			cx.rootMoveList.push_back(RootMove(it->move));
+
+	cx.read_options(job->options);
+	cx.multiPV = job->options.count("MultiPV") ? job->options["MultiPV"] : 1;
+	cx.limit = job->limit;
+	cx.searchTime = now();
+	if (job->deadline != NoDeadline)
+	{
+		Msec left = job->deadline > cx.searchTime ? job->deadline - cx.searchTime : 1;
+		cx.limit.moveTime = cx.limit.moveTime ? min(cx.limit.moveTime, left) : left;
+		cx.limit.infinite = false;
+	}
+	run();
+
+	const RootMove& rm = cx.rootMoveList[0];
+	Session& session = *job->session;
+	ostringstream oss;
+	oss << "bestmove " << UCI::move2uci(rm.pv[0]);
+	if (rm.pv[0] != MOVE_NULL && rm.pv[1] != MOVE_NULL)
+		oss << " ponder " << UCI::move2uci(rm.pv[1]);
+
+	// The session is free for the next 'go' once the job is cleared. Its output
+	// has to wait until our bestmove is out
+	session.writeLock.lock();
+	QueueLock.lock();
+	job->cx = nullptr;
+	session.job.reset();
+	QueueLock.unlock();
+	if (rm.pv[0] == MOVE_NULL)  // checkmate or stalemate
+		session.write_line(string("info depth 0 score ")
+			+ UCI::score2uci(cx.rootPos.checker_map() ? -VALUE_MATE : VALUE_DRAW));
+	session.write_line(oss.str());
+	session.writeLock.unlock();
+	Searches ++;
+}
+
+// Runs one command of a session. False if the session ends
+bool command(const shared_ptr<Session>& session, const string& line, bool& shutdown)
+{
+	istringstream iss(line);
+	string cmd, str;
+	iss >> cmd;
+
+	if (cmd == "position")
+	{
+		string fen;
+		iss >> str;
+		if (str == "startpos")
+		{
+			fen = FEN_START;
+			iss >> str;  // "moves" if any
+		}
+		else if (str == "fen")
+			while (iss >> str && str != "moves")  fen += str + " ";
+
+		UCI::EpdPosition epd;
+		vector<string> mvstrs;
+		while (iss >> str)
+			mvstrs.push_back(str);
+		if (!UCI::parse_epd(fen, epd))
+		{
+			session->send_line("info string bad position");
+			return true;
+		}
+		Position pos(epd.fen);
+		vector<StateInfo> states(mvstrs.size());
+		vector<Move> moves;
+		for (string mvstr : mvstrs)
+		{
+			Move mv = UCI::uci2move(pos, mvstr);
+			if (mv == MOVE_NULL)
+			{
+				session->send_line("info string illegal move " + mvstr);
+				return true;
+			}
+			pos.make_move(mv, states[moves.size()]);
+			moves.push_back(mv);
+		}
+		session->fen = epd.fen;
+		session->moves = moves;
+	}
+
+	else if (cmd == "setoption")
+	{
+		string name, val;
+		iss >> str;  // "name"
+		while (iss >> str && str != "value")  // the name may contain spaces
+			name += (name.empty() ? "" : " ") + str;
+		iss >> val;
+		if ((name != "MultiPV" && std::find(StyleOptions, StyleOptions + STYLE_OPTION_N, name) == StyleOptions + STYLE_OPTION_N)
+			|| !is_int(!val.empty() && val[0] == '-' ? val.substr(1) : val)  // "Contempt Factor" can be negative
+			|| !UCI::OptMap[name].accepts(val))
+			session->send_line("info string option not supported: " + name + " " + val);
+		else
+			session->options[name] = str2int(val);
+	}
+
+	else if (cmd == "go")
+	{
+		shared_ptr<Job> job(new Job);
+		LimitListener& limit = job->limit;
+		limit.clear();
+		int deadline = 0;
+		while (iss >> str)
+		{
+			if (str == "depth")  iss >> limit.depth;
+			else if (str == "nodes")  iss >> limit.nodes;
+			else if (str == "movetime")  iss >> limit.moveTime;
+			else if (str == "deadline")  iss >> deadline;
+			else if (str == "infinite")  limit.infinite = true;
+			else if (str == "searchmoves")
+				while (iss >> str)  job->searchMoves.push_back(str);
+		}
+		limit.depth = max(min(limit.depth, MAX_PLY - 1), 0);
+		limit.nodes = max(limit.nodes, 0);
+		limit.moveTime = max<Msec>(limit.moveTime, 0);
+		if (!(limit.depth || limit.nodes || limit.moveTime))
+			limit.infinite = true;  // until 'stop' or the deadline
+		job->session = session;
+		job->fen = session->fen;
+		job->moves = session->moves;
+		job->options = session->options;
+		job->deadline = deadline > 0 ? now() + deadline : NoDeadline;
+
+		QueueLock.lock();
+		bool busy = bool(session->job);
+		if (!busy)
+		{
+			job->seq = NextSeq++;
+			session->job = job;
+			Queue.push(job);
+			QueueCond.signal();
+		}
+		QueueLock.unlock();
+		if (busy)
+			session->send_line("info string busy: stop the search or wait for its bestmove");
+	}
+
+	else if (cmd == "stop")
+		stop(*session);
+	else if (cmd == "isready")
+		session->send_line("readyok");
+	else if (cmd == "quit")
+		return false;
+	else if (cmd == "shutdown")
+		shutdown = true;
+	else if (!cmd.empty())
+		session->send_line("info string unknown command: " + cmd);
+	return true;
+}
+
+// Reads what the client sent and runs the complete lines. False if the session ends
+bool receive(const shared_ptr<Session>& session, bool& shutdown)
+{
+	char buf[4096];
+	ssize_t n = recv(session->fd, buf, sizeof(buf), 0);
+	if (n <= 0)
+		return n < 0 && errno == EINTR;
+	session->input.append(buf, n);
+	size_t eol;
+	while (!shutdown && (eol = session->input.find('\n')) != string::npos)
+	{
+		string line = session->input.substr(0, eol);
+		session->input.erase(0, eol + 1);
+		if (!line.empty() && line.back() == '\r')
+			line.pop_back();
+		if (!command(session, line, shutdown))
+			return false;
+	}
+	return true;
+}
+
+} // namespace Server
+
+#endif // _WIN32
+
+
+namespace UCI
+{
+
+int serve(istream& args)
+{
+#ifdef _WIN32
+	sync_print("info string serve needs Unix domain sockets, not supported on Windows");
+	return 1;
+#else
+	using namespace Server;
+	string path, opt, val;
+	int threads = 0;
+	U64 memoryMB = 256;
+	bool ok = bool(args >> path) && path.compare(0, 2, "--") != 0;
+	while (ok && args >> opt)
+	{
+		ok = args >> val && is_int(val) && str2int(val) > 0;
+		if (!ok)  break;
+		if (opt == "--threads")  threads = str2int(val);
+		else if (opt == "--memory")  memoryMB = stoull(val);
+		else  ok = false;
+	}
+	sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	if (!ok || path.size() >= sizeof(addr.sun_path))
+	{
+		sync_print("Usage: serve <socket> [--threads N] [--memory MB]");
+		return 1;
+	}
+
+	if (threads < 1)  // all cores
+		threads = max(1u, std::thread::hardware_concurrency());
+	U64 tables = U64(threads) * (Material::EntryTable::Bytes + Pawnshield::EntryTable::Bytes);
+	if ((memoryMB << 20) < tables + (1 << 20))
+	{
+		sync_print("info string serve: " << memoryMB << " MB is not enough for "
+			<< threads << " threads, give at least " << (tables >> 20) + 2 << " MB");
+		return 1;
+	}
+	SharedTT.set_size(((memoryMB << 20) - tables) >> 20);
+	SharedTT.clear();
+
+	// A stale socket file from an earlier server is in the way
+	struct stat st;
+	if (stat(path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode))
+		unlink(path.c_str());
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path.c_str());
+	int listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (listenFd < 0 || ::bind(listenFd, (sockaddr *) &addr, sizeof(addr)) < 0 || listen(listenFd, 64) < 0)
+	{
+		sync_print("info string cannot listen on " << path << ": " << strerror(errno));
+		if (listenFd >= 0)
+			close(listenFd);
+		return 1;
+	}
+	signal(SIGPIPE, SIG_IGN);
+
+	Running = true;
+	NextSeq = 0;
+	Searches = 0;
+	vector<ServeWorker *> workers;
+	for (int i = 0; i < threads; i++)
+		workers.push_back(new_thread<ServeWorker>());
+	sync_print("info string serve: listening on " << path << ", " << threads << " threads, "
+		<< (SharedTT.bytes() >> 20) << " MB TT + " << (tables >> 20) << " MB pawn and material tables");
+
+	vector<shared_ptr<Session>> sessions;
+	U64 sessionCnt = 0;
+	bool shutdown = false;
+	while (!shutdown)
+	{
+		vector<pollfd> fds(1 + sessions.size());
+		fds[0].fd = listenFd;
+		for (size_t i = 0; i < sessions.size(); i++)
+			fds[i + 1].fd = sessions[i]->fd;
+		for (pollfd& p : fds)
+			p.events = POLLIN, p.revents = 0;
+		if (poll(fds.data(), fds.size(), -1) < 0)
+		{
+			if (errno == EINTR)  continue;
+			break;
+		}
+
+		for (size_t i = sessions.size(); i-- > 0 && !shutdown; )
+			if (fds[i + 1].revents && !receive(sessions[i], shutdown))
+			{
+				// A running search still holds the session, and closes it when done
+				stop(*sessions[i]);
+				sessions.erase(sessions.begin() + i);
+			}
+		if (fds[0].revents & POLLIN)
+		{
+			int fd = accept(listenFd, nullptr, nullptr);
+			if (fd >= 0)
+			{
+				sessions.push_back(shared_ptr<Session>(new Session(fd)));
+				sessionCnt ++;
+			}
+		}
+	}
+
+	QueueLock.lock();
+	Running = false;
+	// A queued job and its session hold each other: break the cycle,
+	// or the session and its socket would never be closed
+	while (!Queue.empty())
+	{
+		Queue.top()->session->job.reset();
+		Queue.pop();
+	}
+	for (auto& session : sessions)
+		if (session->job && session->job->cx)
+			session->job->cx->signal.stop = true;
+	for (int i = 0; i < threads; i++)
+		QueueCond.signal();
+	QueueLock.unlock();
+	for (ServeWorker *w : workers)
+		del_thread(w);
+	sessions.clear();
+	close(listenFd);
+	unlink(path.c_str());
+
+	sync_print("info string serve: " << sessionCnt << " sessions, " << Searches << " searches");
+	return 0;
+#endif // _WIN32
+}
+
+} // namespace UCI
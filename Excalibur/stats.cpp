@@ -0,0 +1,141 @@
+#include "stats.h"
+#include "thread.h"
+
+namespace SearchStats
+{
+
+#ifdef STATS
+THREAD_LOCAL U64 Local[COUNTER_N];
+#endif
+
+// Shared by all threads, protected by 'lock'
+U64 Last[COUNTER_N];
+U64 Total[COUNTER_N];
+Mutex lock;
+
+const char *CounterName[COUNTER_N] = 
+{
+	"nodes", "qnodes",
+	"tt_probes", "tt_hits", "tt_cutoffs",
+	"fail_highs", "fail_highs_first",
+	"razor_tries", "razor_cutoffs",
+	"static_null_cutoffs",
+	"null_tries", "null_cutoffs", "null_verifications",
+	"iid_searches",
+	"singular_tries", "singular_extensions",
+	"futility_move_count", "futility_value", "futility_see",
+	"lmr_searches", "lmr_researches",
+	"qs_stand_pats", "qs_futility", "qs_see_prunes", "qs_check_prunes",
+	"material_probes", "material_hits",
+	"pawn_probes", "pawn_hits"
+};
+
+bool enabled()
+{
+#ifdef STATS
+	return true;
+#else
+	return false;
+#endif
+}
+
+void clear()
+{
+#ifdef STATS
+	memset(Local, 0, sizeof(Local));
+#endif
+}
+
+void publish()
+{
+#ifdef STATS
+	lock.lock();
+	memcpy(Last, Local, sizeof(Last));
+	for (int i = 0; i < COUNTER_N; i++)
+		Total[i] += Local[i];
+	lock.unlock();
+#endif
+}
+
+void reset_total()
+{
+	lock.lock();
+	memset(Total, 0, sizeof(Total));
+	lock.unlock();
+}
+
+// Derived rates in percent
+struct Rate { const char *name; Counter num, den; };
+const Rate Rates[] =
+{
+	{ "tt_hit_rate", TT_HITS, TT_PROBES },
+	{ "tt_cutoff_rate", TT_CUTOFFS, TT_PROBES },
+	{ "first_move_fail_high_rate", FAIL_HIGHS_FIRST, FAIL_HIGHS },
+	{ "null_cutoff_rate", NULL_CUTOFFS, NULL_TRIES },
+	{ "razor_cutoff_rate", RAZOR_CUTOFFS, RAZOR_TRIES },
+	{ "lmr_research_rate", LMR_RESEARCHES, LMR_SEARCHES },
+	{ "material_hit_rate", MATERIAL_HITS, MATERIAL_PROBES },
+	{ "pawn_hit_rate", PAWN_HITS, PAWN_PROBES }
+};
+const int RATE_N = sizeof(Rates) / sizeof(Rate);
+
+inline double percent(U64 num, U64 den)
+	{ return den ? 100.0 * num / den : 0.0; }
+
+string report(bool json, bool total)
+{
+	if (!enabled())
+		return json ? "{\"enabled\":false}"
+			: "Search statistics are not compiled in. Rebuild with 'make STATS=1'";
+
+	U64 c[COUNTER_N];
+	lock.lock();
+	memcpy(c, total ? Total : Last, sizeof(c));
+	lock.unlock();
+	U64 allNodes = c[NODES] + c[QNODES];
+
+	ostringstream oss;
+	oss << fixed << setprecision(2);
+	if (json)
+	{
+		oss << "{\"enabled\":true,\"scope\":\"" << (total ? "total" : "last") << "\"";
+		for (int i = 0; i < COUNTER_N; i++)
+			oss << ",\"" << CounterName[i] << "\":" << c[i];
+		oss << ",\"qnode_share\":" << percent(c[QNODES], allNodes);
+		for (int i = 0; i < RATE_N; i++)
+			oss << ",\"" << Rates[i].name << "\":" << percent(c[Rates[i].num], c[Rates[i].den]);
+		oss << "}";
+	}
+	else
+	{
+		oss << (total ? "Statistics of all searches" : "Statistics of the last search") << "\n";
+		for (int i = 0; i < COUNTER_N; i++)
+			oss << setw(26) << CounterName[i] << " = " << c[i] << "\n";
+		oss << setw(26) << "qnode_share" << " = " << percent(c[QNODES], allNodes) << " %\n";
+		for (int i = 0; i < RATE_N; i++)
+			oss << setw(26) << Rates[i].name << " = " 
+				<< percent(c[Rates[i].num], c[Rates[i].den]) << " %\n";
+	}
+	return oss.str();
+}
+
+string summary()
+{
+	U64 c[COUNTER_N];
+	lock.lock();
+	memcpy(c, Last, sizeof(c));
+	lock.unlock();
+
+	ostringstream oss;
+	oss << fixed << setprecision(1)
+		<< "stats qnodes " << percent(c[QNODES], c[NODES] + c[QNODES])
+		<< "% tthit " << percent(c[TT_HITS], c[TT_PROBES])
+		<< "% fhfirst " << percent(c[FAIL_HIGHS_FIRST], c[FAIL_HIGHS])
+		<< "% nullcut " << percent(c[NULL_CUTOFFS], c[NULL_TRIES])
+		<< "% lmrre " << percent(c[LMR_RESEARCHES], c[LMR_SEARCHES])
+		<< "% futility " << c[FUTILITY_MOVE_COUNT] + c[FUTILITY_VALUE] + c[FUTILITY_SEE]
+		<< " qsfutility " << c[QS_FUTILITY] + c[QS_SEE_PRUNES];
+	return oss.str();
+}
+
+} // namespace SearchStats
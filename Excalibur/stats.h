@@ -0,0 +1,57 @@
+/*
+ *	Search statistics: how often each pruning, reduction and table probe fires.
+ *	Compiled in only with -DSTATS (make STATS=1). Otherwise STAT_INC() expands
+ *	to nothing and the search doesn't pay a single instruction for it.
+ *	Every searching thread counts into its own thread local array, which is
+ *	published to the shared snapshot when its search ends.
+ */
+
+#ifndef __stats_h__
+#define __stats_h__
+
+#include "utils.h"
+
+namespace SearchStats
+{
+	enum Counter
+	{
+		NODES, QNODES,  // calls to search() and qsearch()
+		TT_PROBES, TT_HITS, TT_CUTOFFS,
+		FAIL_HIGHS, FAIL_HIGHS_FIRST,  // beta cutoffs, and those on the first move tried
+		RAZOR_TRIES, RAZOR_CUTOFFS,
+		STATIC_NULL_CUTOFFS,
+		NULL_TRIES, NULL_CUTOFFS, NULL_VERIFICATIONS,
+		IID_SEARCHES,
+		SINGULAR_TRIES, SINGULAR_EXTENSIONS,
+		FUTILITY_MOVE_COUNT, FUTILITY_VALUE, FUTILITY_SEE,  // move pruning in search()
+		LMR_SEARCHES, LMR_RESEARCHES,
+		QS_STAND_PATS, QS_FUTILITY, QS_SEE_PRUNES, QS_CHECK_PRUNES,
+		MATERIAL_PROBES, MATERIAL_HITS,
+		PAWN_PROBES, PAWN_HITS,
+		COUNTER_N
+	};
+
+#ifdef STATS
+	extern THREAD_LOCAL U64 Local[COUNTER_N];
+#  define STAT_INC(counter) (++SearchStats::Local[SearchStats::counter])
+#else
+#  define STAT_INC(counter) ((void)0)
+#endif
+
+	// Compiled with -DSTATS?
+	bool enabled();
+	// Resets the calling thread's counters. Called when a search starts
+	void clear();
+	// Copies the calling thread's counters to the last-search snapshot
+	// and adds them to the running totals. Called when a search ends
+	void publish();
+	// Clears the running totals
+	void reset_total();
+
+	// A full table, or a single JSON object for the dashboards
+	string report(bool json, bool total);
+	// One-line digest of the last search, for 'info string'
+	string summary();
+}
+
+#endif // __stats_h__
@@ -1,5 +1,5 @@
 /*
- *	External interface Search::init() and ::think()
+ *	External interface Search::init() and ::run()
  *	also does all the preparation work for search.cpp
  *	including SearchUtils namespace definition: search-related utilities
  */
@@ -8,6 +8,9 @@
 #include "uci.h"
 #include "thread.h"
 #include "openbook.h"
+#include "stats.h"
+#include "profile.h"
+#include "trace.h"
 
 using namespace Search;
 using namespace SearchUtils;
@@ -18,41 +21,32 @@ using namespace UCI;
 
 using Transposition::Entry;
 using Transposition::TT;
+using Transposition::ThreadTT;
 
 /**********************************************/
 // Search related global variables shared across the entire program
-// Some of them will be updated by Thread or UCI processor
+// The search state proper lives in a Context, one for each search thread.
+// MainContext serves the threads that never bind their own
 // 
 namespace Search
 {
 	// Instantiate extern'ed variables
-	volatile SignalListener Signal;
-	LimitListener Limit;
+	Context MainContext;
+	THREAD_LOCAL Context *Ctx = &MainContext;
 
-	SetupStatePtr SetupStates;
-	vector<RootMove> RootMoveList;
-	Position RootPos;
-	Color RootColor;
-
-	TimeKeeper Timer;
-	U64 SearchTime;
 	double IterativeTimePercentThreshold = 0.67;
-
-	Depth handicap = 20; 
 }  // namespace Search
 
+// Threads that never bind a context evaluate with the main tables
+THREAD_LOCAL Material::EntryTable *Material::Table = &Search::MainContext.materialTable;
+THREAD_LOCAL Pawnshield::EntryTable *Pawnshield::Table = &Search::MainContext.pawnTable;
+THREAD_LOCAL Transposition::Table *Transposition::ThreadTT = &Transposition::TT;
+
 /**********************************************/
 // Utility globals used only by search-related functions
 // 
 namespace SearchUtils
 {
-	// Instantiate extern'ed variables
-	float BestMoveChanges;
-	Value DrawValue[COLOR_N]; // set by contempt factor
-	HistoryStats History;
-	GainStats Gains;
-	RefutationStats Refutations;
-
 	// Tables by Search::init()
 	Value FutilityMargins[16][64]; // [depth][moveNumber]
 	int FutilityMoveCounts[2][32]; // [isImproved][depth]
@@ -64,12 +58,52 @@ namespace SearchUtils
 /* Search namespace external interface */
 /**********************************************/
 
-// Init various search lookup tables and TimeKeeper. Called at program startup
+Search::Context::Context() : rootColor(W), searchTime(0), lastInfo(0), handicap(20), contempt(0),
+	tt(&TT), silent(false), completedDepth(0), multiPV(1), pvIdx(0), warm(false), warmKey(0), bestMoveChanges(0), nextPoll(0)
+{
+	memset(rootIndex, 0, sizeof(rootIndex));
+	evalWeights.set(100, 100, 100, 100);
+	limit.clear();
+	signal.stopOnPonderhit = signal.stop = false;
+	drawValue[W] = drawValue[B] = VALUE_DRAW;
+	history.clear();
+	gains.clear();
+	refutations.clear();
+}
+
+const char *Search::StyleOptions[STYLE_OPTION_N] = { "Mobility", "Pawn Shield", "King Safety",
+									"Aggressiveness", "Contempt Factor", "Power Level" };
+
+// The UCI options that make up a playing style. 'overrides' replaces some of them
+void Search::Context::read_options(const map<string, int>& overrides)
+{
+	auto option = [&](const string& name) -> int
+	{
+		auto it = overrides.find(name);
+		return it != overrides.end() ? it->second : (int) OptMap[name];
+	};
+	evalWeights.set(option("Mobility"), option("Pawn Shield"),
+		option("King Safety"), option("Aggressiveness"));
+	contempt = option("Contempt Factor");
+	handicap = option("Power Level") * 2;
+}
+
+void Search::bind_context(Context& cx)
+{
+	Ctx = &cx;
+	Transposition::ThreadTT = cx.tt;
+	Material::Table = &cx.materialTable;
+	Pawnshield::Table = &cx.pawnTable;
+}
+
+// Init various search lookup tables and TimeKeeper. Called at program startup.
+// The shared TT isn't allocated here: every Engine has its own, and the
+// commands that search in the shared one size it when they start
 void Search::init()
 {
 	TimeKeeper::init(); // Init Timer's heuristic data
 
-	TT.set_size(OptMap["Hash"]); // set Transposition table size
+	MainContext.read_options();
 
 	Depth d; // full, one ply = 2
 	Depth hd; // half, one ply = 1
@@ -107,85 +141,56 @@ void Search::init()
 }
 
 
-// External interface to the main search engine. Started by UCI 'go'.
-// Search from RootPos and print out "bestmove"
-// Gives out the one move we decide to play
-// 
-void Search::think()
+// Searches Ctx->rootPos within the context's limits on the calling thread.
+// Engine::Impl::think() wraps it with the book, the ponder wait and the UCI output
+void Search::run()
 {
-	RootColor = RootPos.turn;
-
-	// Allocate the optimal time for the current one move
-	Timer.talloc(RootColor, RootPos.ply());
-
-	// No legal moves available. Either we're checkmated, or stalemate. 
-	if (RootMoveList.empty())
+	Ctx->rootColor = Ctx->rootPos.turn;
+	Ctx->completedDepth = 0;
+	if (Ctx->rootMoveList.empty())
 	{
-		RootMoveList.push_back(MOVE_NULL);
-		sync_print("info depth 0 score " 
-			<< score2uci(RootPos.checker_map() ? -VALUE_MATE : VALUE_DRAW) );
-		goto finished;
+		Ctx->rootMoveList.push_back(MOVE_NULL);
+		return;
 	}
+	update_contempt_factor();
+	Ctx->nextPoll = 0; // the search checks the limits at its first node
+	iterative_deepen(Ctx->rootPos);
+	Trace::flush();  // the worker threads may not end for a while
+	if (Ctx->warm)
+		warm_save();
+}
 
-	if (  OptMap["Use Opening Book"]
-	&& RootPos.st->cntInternalFiftyMove < 27
-	&& !Limit.infinite && !Limit.mateInX)
+// Restores what the earlier searches of this root found out about the root moves
+// and sorts the best known first. Returns the depth every one of them has been
+// searched to: 0 if one is new to this root
+Depth Search::warm_start()
+{
+	Depth start = MAX_PLY;
+	for (RootMove& rm : Ctx->rootMoveList)
 	{
-		Move bookMv = Polyglot::probe(RootPos);
-
-		// Iterator to see if bookMv is in the list of moves we are to consider
-		decltype(RootMoveList.begin()) Rmv;
-
-		if (bookMv != MOVE_NULL
-			&& (Rmv = std::find(RootMoveList.begin(), RootMoveList.end(), bookMv))
-									!= RootMoveList.end())
-		{
-			std::swap(RootMoveList[0], *Rmv);
-			goto finished; // already made the book move
-		}
+		auto it = std::find(Ctx->warmMoves.begin(), Ctx->warmMoves.end(), rm.pv[0]);
+		if (it != Ctx->warmMoves.end())
+			rm = *it;
+		start = min(start, rm.depth);
 	}
+	insertion_sort<RootMove>(Ctx->rootMoveList.data(), Ctx->rootMoveList.data() + Ctx->rootMoveList.size());
+	return start;
+}
 
-	update_contempt_factor();
-
-	// Set Clock check interval to avoid lagging. Clock thread checks for remaining 
-	// available time regularly, as allocated by Timer.talloc() at the beginning
-	Clock->ms = Limit.use_timer() ? 
-						min(100, max(Timer.optimum()/16, ClockThread::Resolution)) : 
-				Limit.nodes ? 2 * ClockThread::Resolution : 100;  
-	
-	Clock->signal(); // wake up the recurring clock
-
-	/* **************************
-	 *	Start the main iterative deepening search engine
-	 * **************************/
-	iterative_deepen(RootPos);
-
-	Clock->ms = 0; // stops the clock
-
-	/**********************************************/
-finished:  // goto label
-	// If the search is stopped midway, the following code would never be reached
-	sync_print("info nodes " << RootPos.nodes << " time " << now() - SearchTime);
-
-	// When we reach max depth we arrive here even without Signal.stop is raised,
-	// but if we are pondering or in infinite search, according to UCI protocol,
-	// we shouldn't print the best move until the GUI sends a "stop" or "ponderhit"
-	// command. We simply wait here until GUI sends one of those commands (that
-	// raise Signal.stop).
-	if (!Signal.stop && (Limit.ponder || Limit.infinite))
+// Remembers the root moves of the search just finished for the next warm query.
+// Per move, the deepest result wins; at equal depth, an exact score
+void Search::warm_save()
+{
+	for (const RootMove& rm : Ctx->rootMoveList)
 	{
-		Signal.stopOnPonderhit = true;
-		Main->wait_until(Signal.stop);
+		if (rm.depth == 0)
+			continue;
+		auto it = std::find(Ctx->warmMoves.begin(), Ctx->warmMoves.end(), rm.pv[0]);
+		if (it == Ctx->warmMoves.end())
+			Ctx->warmMoves.push_back(rm);
+		else if (rm.depth > it->depth || (rm.depth == it->depth && rm.score != -VALUE_INFINITE))
+			*it = rm;
 	}
-
-	// We print bestmove to console - ask the GUI to play the move!
-	// This is the only place we print bestmove
-	// could be MOVE_NULL if we search on a stalemate position.
-	// The bestmove is expressed in UCI long algebraic notation. 
-	// pv[0] will be played. pv[1] is our prediction of opp's move, which
-	// will be pondered upon. 
-	sync_print("bestmove " << move2uci(RootMoveList[0].pv[0])
-			<<  " ponder " << move2uci(RootMoveList[0].pv[1]) );
 }
 
 
@@ -200,127 +205,174 @@ void Search::iterative_deepen(Position& pos)
 {
 	SearchStack sstack; SearchInfo *ss = sstack + 2; // To allow dereferencing (ss - 2)
 	memset(ss - 2, 0, 5 * sizeof(SearchInfo)); // from ss - 2 to ss + 2
+	StateStack ststack;
+	for (int i = 0; i < MAX_PLY + 6; i++)
+		sstack[i].nextSt = ststack + i;
 
 	Depth depth = 0;
-	BestMoveChanges = 0;
+	Ctx->bestMoveChanges = 0;
 	Value best, alpha, beta, delta; // alpha's the lower limit and beta's the upper
 	best = alpha = delta = -VALUE_INFINITE;
 	beta = VALUE_INFINITE; 
 
 	(ss-1)->currentMv = MOVE_NULL; // Skip update gains.
 
-	// clear the recording tables
-	TT.new_generation();
-	History.clear();
-	Gains.clear();
-	Refutations.clear();
+	// A warm re-query of the last root keeps the recording tables and starts at
+	// the depth all its root moves have been searched to. Otherwise clear them
+	if (Ctx->warm && Ctx->warmKey == pos.key())
+	{
+		depth = warm_start();
+		if (Ctx->limit.depth)
+			depth = min(depth, Ctx->limit.depth);
+		depth = max(depth - 1, 0); // the loop pre-increments
+	}
+	else
+	{
+		ThreadTT->new_generation();
+		Ctx->history.clear();
+		Ctx->gains.clear();
+		Ctx->refutations.clear();
+		Ctx->warmKey = pos.key();
+		Ctx->warmMoves.clear();
+	}
 
 	// Iterative deepening loop until requested to stop or target depth reached
-	while (++depth <= MAX_PLY && !Signal.stop && (!Limit.depth || depth <= Limit.depth))
+	while (++depth <= MAX_PLY && !Ctx->signal.stop && (!Ctx->limit.depth || depth <= Ctx->limit.depth))
 	{
 		// Exponential decay PV variability weight
-		BestMoveChanges *= 0.75f;
+		Ctx->bestMoveChanges *= 0.75f;
 
 		// Save last iteration's score
-		// RootMoveList won't be empty because that's already handled by Search::think()
-		for (int i = 0; i < RootMoveList.size(); i++)
-			RootMoveList[i].prevScore = RootMoveList[i].score;
-
-		// Reset aspiration window starting size, 
-		// centered on the score from the previous iteration (+-delta)
-		if (depth >= 5)
+		// RootMoveList won't be empty because that's already handled by Search::run()
+		for (int i = 0; i < Ctx->rootMoveList.size(); i++)
+			Ctx->rootMoveList[i].prevScore = Ctx->rootMoveList[i].score;
+
+		// MultiPV: search the best lines in turn, each one with its own aspiration
+		// window and without the lines before it. The moves behind the last line only
+		// need to be proven worse than it, so the cost is far less than K searches.
+		size_t pvSize = min<size_t>(Ctx->multiPV, Ctx->rootMoveList.size());
+		for (Ctx->pvIdx = 0; Ctx->pvIdx < pvSize && !Ctx->signal.stop; Ctx->pvIdx++)
 		{
-			delta = 16;
-			alpha = max(-VALUE_INFINITE, RootMoveList[0].prevScore - delta);
-			beta = min(VALUE_INFINITE, RootMoveList[0].prevScore + delta);
-		}
+			RootMove *line = Ctx->rootMoveList.data() + Ctx->pvIdx;
 
-		// Start with a small aspiration window and, in case of fail high/low,
-		// research with bigger window until not failing high/low anymore.
-		while (true)
-		{
-			best = search<ROOT>(pos, ss, alpha, beta, depth * ONE_PLY, false);
-			
-			// Bring to front the best move. It is critical that sorting is
-			// done with a stable algorithm because all the values but the first
-			// and eventually the new best one are set to -VALUE_INFINITE and
-			// we want to keep the same order for all the moves but the new
-			// PV that goes to the front. 
-			std::stable_sort(RootMoveList.begin(), RootMoveList.end());
-
-			// Write PV back to transposition table in case the relevant
-			// entries have been overwritten during the search.
-			RootMoveList[0].pv2tt(pos);
-
-			// If search has been stopped return immediately. Sorting and
-			// storing PV to TT is safe because those are values from the last iteration
-			if (Signal.stop)
-				return;
-
-			// When fail high/low give some update before re-searching
-			if ( (best <= alpha || best >= beta)
-				&& now() - SearchTime > 3000)
-				sync_print(pv2uci(pos, depth, alpha, beta));
-
-			// If we fail low/high, increase the aspiration window and re-search
-			// The aspiration window size will be increased exponentially
-			if (best <= alpha) // fail low
+			// Reset aspiration window starting size, 
+			// centered on the score from the previous iteration (+-delta)
+			if (depth >= 5 && line->prevScore != -VALUE_INFINITE)
 			{
-				alpha = max(best - delta, -VALUE_INFINITE);
-				// Send out signals
-				Signal.stopOnPonderhit = false;
+				delta = 16;
+				alpha = max(-VALUE_INFINITE, line->prevScore - delta);
+				beta = min(VALUE_INFINITE, line->prevScore + delta);
+			}
+			else
+			{
+				alpha = -VALUE_INFINITE;
+				beta = VALUE_INFINITE;
 			}
-			else if (best >= beta) // fail high
-				beta = min(best + delta, VALUE_INFINITE);
-
-			else // we've found the EXACT best value
-				break;
-
-			delta += delta / 2;  // Increase the window size by an exponent of 1.5
 
-		} // end of aspiration loop
+			// Start with a small aspiration window and, in case of fail high/low,
+			// research with bigger window until not failing high/low anymore.
+			while (true)
+			{
+				best = search<ROOT>(pos, ss, alpha, beta, depth * ONE_PLY, false);
+				
+				// Bring to front the best move. It is critical that sorting is
+				// done with a stable algorithm because all the values but the first
+				// and eventually the new best one are set to -VALUE_INFINITE and
+				// we want to keep the same order for all the moves but the new
+				// PV that goes to the front. Insertion sort is stable, in-place, and
+				// cheap here because the list is already sorted except for the new PV.
+				insertion_sort<RootMove>(line, Ctx->rootMoveList.data() + Ctx->rootMoveList.size());
+
+				// Write PV back to transposition table in case the relevant
+				// entries have been overwritten during the search.
+				for (size_t i = 0; i <= Ctx->pvIdx; i++)
+					Ctx->rootMoveList[i].pv2tt(pos);
+
+				// If search has been stopped, the lines found so far are sorted below.
+				// Sorting and storing PV to TT is safe because those are values from the last iteration
+				if (Ctx->signal.stop)
+					break;
+
+				// When fail high/low give some update before re-searching
+				if ( (best <= alpha || best >= beta)
+					&& !Ctx->silent && now() - Ctx->searchTime > 3000)
+					sync_print(pv2uci(pos, depth, alpha, beta));
+
+				// If we fail low/high, increase the aspiration window and re-search
+				// The aspiration window size will be increased exponentially
+				if (best <= alpha) // fail low
+				{
+					alpha = max(best - delta, -VALUE_INFINITE);
+					// Send out signals
+					Ctx->signal.stopOnPonderhit = false;
+				}
+				else if (best >= beta) // fail high
+					beta = min(best + delta, VALUE_INFINITE);
+
+				else // we've found the EXACT best value
+					break;
+
+				delta += delta / 2;  // Increase the window size by an exponent of 1.5
+
+			} // end of aspiration loop
+
+			// The new line might be better than one found before it
+			insertion_sort<RootMove>(Ctx->rootMoveList.data(), line + 1);
+		}
+		// pvIdx stays past the last line: pv2uci() shows them all as searched
+		if (Ctx->signal.stop)
+			return;
+		best = Ctx->rootMoveList[0].score;
 		
 
 		/******* Succeed. No fail low or high! ********/
-		sync_print(pv2uci(pos, depth));
+		Ctx->completedDepth = depth;
+		for (RootMove& rm : Ctx->rootMoveList)
+			rm.depth = depth;
+		if (!Ctx->silent)
+			sync_print(pv2uci(pos, depth));
+		if (Ctx->onIteration)
+			Ctx->onIteration();
 
 		// Have we found a mate-in-N ? Then stop. 
 		// Limit.mate will be flagged by UCI "go mate" command
-		if ( Limit.mateInX
+		if ( Ctx->limit.mateInX
 			&& best >= VALUE_MATE_IN_MAX_PLY
-			&& VALUE_MATE - best <= 2 * Limit.mateInX)
-			Signal.stop = true;
+			&& VALUE_MATE - best <= 2 * Ctx->limit.mateInX)
+			Ctx->signal.stop = true;
 
 		// Under time control scenario:
 		// Decide if we have time for the next iteration. See if we can stop searching now
-		if (Limit.use_timer() && !Signal.stopOnPonderhit)
+		if (Ctx->limit.use_timer() && !Ctx->signal.stopOnPonderhit)
 		{
 			bool stopjug = false; // Can we stop searching?
 
 			// If PV is unstable, we need extra time
 			if (depth > 4 && depth < 50)
-				Timer.unstable_pv_adjust(BestMoveChanges);
+				Ctx->timer.unstable_pv_adjust(Ctx->bestMoveChanges);
 
 			// Stop searching if we seem to have insufficient time for the next iteration
 			// Global const threshold decides the percentage of remaining time below which
 			// we'd choose not to start the next iteration. Typically set to 60-70%
 			// 'handicap from 1*2 to 10*2 (max) to limit search time
-			if (now() - SearchTime > Timer.optimum() * IterativeTimePercentThreshold)
+			if (now() - Ctx->searchTime > Ctx->timer.optimum() * IterativeTimePercentThreshold)
 				stopjug = true;
 
 			// Play handicap: limit search depth. When level 10 we don't limit anything
-			if (handicap != 20 && depth >= handicap)
+			if (Ctx->handicap != 20 && depth >= Ctx->handicap)
 				stopjug = true;
 
-			// Stop early if one move seems much better than others
+			// Stop early if one move seems much better than others.
+			// Not when the other lines are asked for too
 			if (  !stopjug 
+				&& Ctx->multiPV == 1
 				&& depth >= 12 
 				&& best > VALUE_MATED_IN_MAX_PLY
-				&& ( RootMoveList.size() == 1  // has only 1 legal move at root
-						|| now() - SearchTime > Timer.optimum() * 0.2))
+				&& ( Ctx->rootMoveList.size() == 1  // has only 1 legal move at root
+						|| now() - Ctx->searchTime > Ctx->timer.optimum() * 0.2))
 			{
 				Value redBeta = best - 2 * MG_PAWN;  // reduced beta
-				ss->excludedMv = RootMoveList[0].pv[0]; // exclude the PV move
+				ss->excludedMv = Ctx->rootMoveList[0].pv[0]; // exclude the PV move
 				ss->skipNullMv = true;
 				Value val = search<NON_PV>(pos, ss, redBeta - 1, redBeta, (depth - 3) * ONE_PLY, true);
 				ss->skipNullMv = false;
@@ -334,15 +386,15 @@ void Search::iterative_deepen(Position& pos)
 			{
 				// If we are in ponder state, don't stop the search now (as requested by UCI)
 				// until UCI sends 'ponderhit' or 'stop'
-				if (Limit.ponder)
-					Signal.stopOnPonderhit = true;
+				if (Ctx->limit.ponder)
+					Ctx->signal.stopOnPonderhit = true;
 				else
-					Signal.stop = true;
+					Ctx->signal.stop = true;
 			}
 		}  // #endif we use time managment
 		// When pondering, we also ponder handicap
-		else if (handicap != 20 && Limit.ponder && depth >= handicap)
-			Signal.stop = true;
+		else if (Ctx->handicap != 20 && Ctx->limit.ponder && depth >= Ctx->handicap)
+			Ctx->signal.stop = true;
 
 	} // end of the main iter deepening while-loop
 }
@@ -355,15 +407,15 @@ void Search::iterative_deepen(Position& pos)
 // 3rkb1r/pQ2nppp/2p5/8/3P4/q1p1R3/2P3PP/4R2K w k - 6 1
 void Search::update_contempt_factor()
 {
-	if (OptMap["Contempt Factor"])
+	if (Ctx->contempt)
 	{
-		double cf = OptMap["Contempt Factor"] * MG_PAWN / 100.0;
-		cf *= (double)Material::game_phase(RootPos) / PHASE_MG;
-		DrawValue[RootColor] = VALUE_DRAW - cf;
-		DrawValue[~RootColor] = VALUE_DRAW + cf;
+		double cf = Ctx->contempt * MG_PAWN / 100.0;
+		cf *= (double)Material::game_phase(Ctx->rootPos) / PHASE_MG;
+		Ctx->drawValue[Ctx->rootColor] = VALUE_DRAW - cf;
+		Ctx->drawValue[~Ctx->rootColor] = VALUE_DRAW + cf;
 	}
 	else
-		DrawValue[W] = DrawValue[B] = VALUE_DRAW;
+		Ctx->drawValue[W] = Ctx->drawValue[B] = VALUE_DRAW;
 }
 
 
@@ -383,14 +435,13 @@ void RootMove::tt2pv(Position& pos)
 	const Entry *tte; // TT entry
 	int ply = 0;
 	Move mv = pv[0]; // preserve the first move
-	pv.clear();
+	U64 nodes = pos.nodes; // walking the PV doesn't count as searching
 
 	do 
 	{
-		ply ++;
-		pv.push_back(mv);
+		pv[ply++] = mv;
 		pos.make_move(mv, *st++);
-		tte = TT.probe(pos.key());
+		tte = ThreadTT->probe(pos.key());
 
 	} while ( tte
 		&& pos.is_pseudo(mv = tte->move) // must maintain a local copy. TT can change
@@ -398,9 +449,10 @@ void RootMove::tt2pv(Position& pos)
 		&& ply < MAX_PLY
 		&& (!pos.is_draw<false>() || ply < 2) );
 
-	pv.push_back(MOVE_NULL); // must be null-terminated
+	pv[ply] = MOVE_NULL; // must be null-terminated
 
 	while (ply--) pos.unmake_move(pv[ply]); // restore the state
+	pos.nodes = nodes;
 }
 
 // Called at the end of a search iteration, and
@@ -413,13 +465,14 @@ void RootMove::pv2tt(Position& pos)
 
 	const Entry *tte; // TT entry
 	int ply = 0;
+	U64 nodes = pos.nodes;
 
 	do 
 	{
-		tte = TT.probe(pos.key());
+		tte = ThreadTT->probe(pos.key());
 
 		if (!tte || tte->move != pv[ply]) // Overwrite bad entries
-			TT.store(pos.key(), VALUE_NULL, BOUND_NULL, 
+			ThreadTT->store(pos.key(), VALUE_NULL, BOUND_NULL, 
 			DEPTH_NULL, pv[ply], VALUE_NULL, VALUE_NULL);
 
 		pos.make_move(pv[ply++], *st++);
@@ -427,6 +480,7 @@ void RootMove::pv2tt(Position& pos)
 	} while (pv[ply] != MOVE_NULL);
 
 	while (ply--) pos.unmake_move(pv[ply]); // restore the state
+	pos.nodes = nodes;
 }
 
 
@@ -440,7 +494,7 @@ bool SearchUtils::is_check_dangerous(const Position& pos, Move mv, Value futilit
 	Color opp = ~pos.turn;
 	Square from = get_from(mv);
 	Square to = get_to(mv);
-	PieceType pt = pos.boardPiece[from];
+	PieceType pt = pos.piece_on(from);
 	Square ksq = pos.king_sq(opp);
 	Bit oppMap = pos.piece_union(opp);
 	Bit kingAtk = king_attack(ksq);
@@ -464,7 +518,7 @@ bool SearchUtils::is_check_dangerous(const Position& pos, Move mv, Value futilit
 	Bit newAtked = (oppMap ^ setbit(ksq)) & newAtk & ~pos.attack_map(pt, from, occ);
 	while (newAtked)
 	{
-		if (futilityBase + PIECE_VALUE[EG][pos.boardPiece[pop_lsb(newAtked)]] >= beta)
+		if (futilityBase + PIECE_VALUE[EG][pos.piece_on(pop_lsb(newAtked))] >= beta)
 			return true;  // fail high -  pruned
 	}
 
@@ -492,7 +546,7 @@ bool SearchUtils::allows(const Position& pos, Move mv1, Move mv2)
 		return true;
 
 	// mv2's destination is defended by mv1's piece. Note that mv1 is already played!!
-	Bit mv1Atk = piece_attack(pos.boardPiece[to1], pos.boardColor[to1], to1, pos.Occupied ^ setbit(from2));
+	Bit mv1Atk = piece_attack(pos.piece_on(to1), pos.color_on(to1), to1, pos.Occupied ^ setbit(from2));
 	if (mv1Atk & setbit(to2)) // defended
 		return true;
 
@@ -525,13 +579,13 @@ bool SearchUtils::refutes(const Position& pos, Move mv1, Move mv2)
 	// threater piece, don't prune moves which defend it.
 	// from2 == threater;  to2 == threatened
 	if (pos.is_capture(mv2)
-		&& ( PIECE_VALUE[MG][pos.boardPiece[from2]] >= PIECE_VALUE[MG][pos.boardPiece[to2]]
-	|| pos.boardPiece[from2] == KING) )
+		&& ( PIECE_VALUE[MG][pos.piece_on(from2)] >= PIECE_VALUE[MG][pos.piece_on(to2)]
+	|| pos.piece_on(from2) == KING) )
 	{
 		// New occ as if the defender and threater are moving
 		Bit occ = pos.Occupied ^ setbit(from1) ^ setbit(to1) ^ setbit(from2);
-		PieceType defender = pos.boardPiece[from1];
-		Color defColor = pos.boardColor[from1];
+		PieceType defender = pos.piece_on(from1);
+		Color defColor = pos.color_on(from1);
 
 		// Defender attacks to2, the threatened square
 		if (piece_attack(defender, defColor, to1, occ) & setbit(to2))
@@ -1,36 +1,53 @@
 #include "thread.h"
 #include "search.h"
+#include "uci.h"
 using namespace Search;
 
-// External interface to 2 global threads
+// cout is redirected here while the OutputThread is alive.
+// There's no put area: every write goes straight to OutputThread::write()
+class OutputBuffer : public std::streambuf
+{
+protected:
+	int overflow(int c)
+	{
+		if (c != EOF)
+			{ char ch = c; ThreadPool::Output->write(&ch, 1); }
+		return c;
+	}
+	std::streamsize xsputn(const char* s, std::streamsize n)
+		{ ThreadPool::Output->write(s, n); return n; }
+	// endl and flush only wake up the OutputThread
+	int sync() { ThreadPool::Output->signal(); return 0; }
+};
+
+// External interface to the global threads
 namespace ThreadPool
 {
 	// Instantiate externs
-	MainThread *Main;
-	ClockThread *Clock;
+	InputThread *Input;
+	OutputThread *Output;
+
+	OutputBuffer outBuf;
+	std::streambuf *stdoutBuf;  // original cout buffer
 
 	// will be called at program startup
-	void init()
+	void init(bool readInput)
 	{
-		Clock = new_thread<ClockThread>();
-		Main = new_thread<MainThread>();
+		Output = new_thread<OutputThread>();
+		stdoutBuf = cout.rdbuf(&outBuf);
+		Input = readInput ? new_thread<InputThread>() : nullptr;
 	}
 	// will be called at program exit
 	void terminate()
 	{
-		del_thread<ClockThread>(Clock);
-		del_thread<MainThread>(Main);
-	}
-
-	ConditionVar mainWaitCond;
-	void wait_until_main_finish()
-	{
-		Main->mutex.lock();
-		while (Main->searching)
-			mainWaitCond.wait(Main->mutex);
-		Main->mutex.unlock();
+		// The InputThread exits by itself after reading 'quit' or EOF
+		if (Input)
+			del_thread<InputThread>(Input);
+		// flushes whatever is left
+		cout.flush();
+		del_thread<OutputThread>(Output);
+		cout.rdbuf(stdoutBuf);
 	}
-
 } // namespace ThreadPool
 
 
@@ -57,64 +74,126 @@ void Thread::wait_until(volatile bool& cond)
 	mutex.unlock();
 }
 
-// MainThread wakes up when there's a new search
-void MainThread::execute()
-{
-	while (true)
-	{
-		mutex.lock();
-		searching = false;
-		while (!searching && exist)
-		{
-			// Main has finished searching. Return to IO
-			// ask wait_until_main_finish() to stop waiting
-			ThreadPool::mainWaitCond.signal();
-			sleepCond.wait(mutex);
-		}
-		mutex.unlock();
-
-		if (!exist)	return;
-
-		// Main search engine starts. 
-		Search::think();
-	}
-}
-
-
 // UCI 'movetime' is also an Xboard time control: each move should take maximum ms
 // Thus we have to subtract 80 ms (xboard's time resolution) to workaround the bug.
 // Now we set to 0 to keep the standard.
 const int MoveTimeThreshold = 0;
-// Checks the system time for ClockThread
+// Checks the system time for the search of the calling thread
 void check_time()
 {
-	if (Limit.ponder)
+	if (Ctx->limit.ponder)
 		return;
 
-	U64 lapse = now() - SearchTime;
+	U64 lapse = now() - Ctx->searchTime;
 
-	bool timeRunOut = lapse > Timer.maximum() - 2 * ClockThread::Resolution;
+	bool timeRunOut = lapse > Ctx->timer.maximum() - 2 * TimeResolution;
 
-	if ( (Limit.use_timer() && timeRunOut) 
+	if ( (Ctx->limit.use_timer() && timeRunOut) 
 			// UCI 'movetime' requires that we search exactly x msec
-		|| ( Limit.moveTime && lapse >= Limit.moveTime - MoveTimeThreshold)
+		|| ( Ctx->limit.moveTime && lapse >= Ctx->limit.moveTime - MoveTimeThreshold)
 			// UCI 'nodes' requires that we search exactly x nodes
-		|| (Limit.nodes && RootPos.nodes >= Limit.nodes) )
-		Signal.stop = true;
+		|| (Ctx->limit.nodes && Ctx->rootPos.nodes >= Ctx->limit.nodes) )
+		Ctx->signal.stop = true;
 }
 
-// Launch a clock thread
-void ClockThread::execute()
+void print_live_info()
 {
-	while (exist) // will stop at program termination.
+	U64 time = now();
+	if (time - max(Ctx->lastInfo, Ctx->searchTime) < InfoInterval || Ctx->signal.stop)
+		return;
+	Ctx->lastInfo = time;
+
+	U64 nodes = Ctx->rootPos.nodes, lapse = time - Ctx->searchTime;
+	sync_print("info nodes " << nodes << " nps " << nodes * 1000 / lapse
+		<< " hashfull " << Transposition::ThreadTT->hashfull() << " time " << lapse);
+}
+
+// Reads stdin until 'quit' or EOF
+void InputThread::execute()
+{
+	string line, cmd;
+	while (getline(cin, line))
+	{
+		istringstream(line) >> cmd;
+		cmd = str2lower(cmd);
+
+		// Stop the search right away if it's the one the command refers to.
+		// The processor will still get the line and handle it as usual,
+		// applying it twice is harmless.
+		if ((cmd == "stop" || cmd == "ponderhit") && goQueued == goLaunched)
+			UCI::stop_search(cmd == "ponderhit");
+		else if (cmd == "go")
+			++goQueued;
+
+		// The processor is far behind. Shouldn't really happen
+		while (!lines.push(line))
+		{
+			mutex.lock();
+			sleepCond.timed_wait(mutex, 1);
+			mutex.unlock();
+		}
+		signal();
+
+		if (cmd == "quit")
+			break;
+	}
+
+	mutex.lock();
+	eof = true;
+	sleepCond.signal();
+	mutex.unlock();
+}
+
+bool InputThread::read_line(string& line)
+{
+	// The previous command has been fully processed,
+	// so every 'go' read so far has launched its search.
+	goLaunched = goRead;
+
+	mutex.lock();
+	while (lines.empty() && !eof)
+		sleepCond.wait(mutex);
+	mutex.unlock();
+
+	if (!lines.pop(line))
+		return false;
+
+	string cmd;
+	istringstream(line) >> cmd;
+	if (str2lower(cmd) == "go")
+		++goRead;
+	return true;
+}
+
+
+// Appends to the pending output. Called by cout from any thread
+void OutputThread::write(const char* s, size_t n)
+{
+	mutex.lock();
+	pending.append(s, n);
+	mutex.unlock();
+}
+
+// Writes out everything that has accumulated since the last round in a single go
+void OutputThread::execute()
+{
+	string out;
+	while (true)
 	{
 		mutex.lock();
-		// If ms is 0, the clock waits indefinitely until woken up again
-		if (exist)
-			sleepCond.timed_wait(mutex, ms != 0 ? ms : INT_MAX);
+		while (pending.empty() && exist)
+			sleepCond.wait(mutex);
+		out.swap(pending);
+		bool alive = exist;
 		mutex.unlock();
 
-		if (ms) // if not 0, check time regularly
-			check_time();
+		if (!out.empty())
+		{
+			fwrite(out.data(), 1, out.size(), stdout);
+			fflush(stdout);
+			out.clear();  // keeps the capacity
+		}
+
+		if (!alive)	return;
 	}
 }
\ No newline at end of file
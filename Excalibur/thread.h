@@ -2,6 +2,9 @@
 #ifndef __thread_h__
 #define __thread_h__
 #include "utils.h"
+#include "trace.h"
+#include <atomic>
+#include <cstdio>
 
 #ifdef _WIN32  // windows
 
@@ -82,8 +85,10 @@ public:
 #ifdef _WIN32
 		int tm = ms;
 #else
+		// The deadline is absolute wall clock time, unlike our monotonic now()
 		timespec ts, *tm = &ts;
-		U64 time = now() + ms;
+		U64 time = std::chrono::duration_cast<std::chrono::milliseconds>(
+			std::chrono::system_clock::now().time_since_epoch()).count() + ms;
 
 		ts.tv_sec = time / 1000;
 		ts.tv_nsec = (time % 1000) * 1000000LL;
@@ -98,6 +103,45 @@ private:
 	ConditionSignal c;
 };
 
+// Lock-free ring buffer with exactly one producer and one consumer thread.
+// Size must be a power of 2. The counters wrap around harmlessly.
+template<typename T, unsigned Size>
+class RingQueue
+{
+public:
+	RingQueue() : head(0), tail(0) {}
+
+	bool empty() const
+		{ return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire); }
+
+	// Producer only. Returns false if the queue is full
+	bool push(const T& t)
+	{
+		unsigned tl = tail.load(std::memory_order_relaxed);
+		if (tl - head.load(std::memory_order_acquire) == Size)
+			return false;
+		buf[tl & (Size - 1)] = t;
+		tail.store(tl + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Consumer only. Returns false if the queue is empty
+	bool pop(T& t)
+	{
+		unsigned hd = head.load(std::memory_order_relaxed);
+		if (hd == tail.load(std::memory_order_acquire))
+			return false;
+		t = std::move(buf[hd & (Size - 1)]);
+		head.store(hd + 1, std::memory_order_release);
+		return true;
+	}
+
+private:
+	static_assert((Size & (Size - 1)) == 0, "RingQueue size must be a power of 2");
+	T buf[Size];
+	std::atomic<unsigned> head, tail;
+};
+
 // Thread wrapper
 struct Thread
 {
@@ -117,44 +161,65 @@ struct Thread
 	volatile bool exist;  // monitor if the thread is already dead
 };
 
-// Main thread
-struct MainThread : public Thread
+// Reads stdin on its own thread, so that 'stop' and 'ponderhit' reach the search
+// even while the UCI processor is busy with a long command.
+// Lines are handed over to the processor through a lock-free queue.
+struct InputThread : public Thread
 {
-	MainThread() : searching(true) {}
+	InputThread() : eof(false), goQueued(0), goLaunched(0), goRead(0) {}
 	virtual void execute();
-	// avoid a race condition with 'searching'
-	volatile bool searching;
+	// Called by the UCI processor only. Blocks until the next line arrives.
+	// Returns false once stdin is closed and every line has been consumed.
+	bool read_line(string& line);
+
+	RingQueue<string, 256> lines;
+	volatile bool eof;
+	// 'go' commands queued by the reader vs. already launched by the processor.
+	// A stop signal can only be applied early if it cannot hit a search that
+	// hasn't started yet: 'go' would reset Signal.stop and the stop would be lost.
+	std::atomic<int> goQueued, goLaunched;
+	int goRead;  // processor side
 };
 
-// Clock
-struct ClockThread : public Thread
+// Coalesces everything written to cout and flushes it from its own thread.
+// Search threads only append to a memory buffer, never wait for the console.
+struct OutputThread : public Thread
 {
-	// This is the minimum interval in ms between two check_time() calls
-	static const Msec Resolution = 5; // clock resolution
-	ClockThread() : ms(0) {}
 	virtual void execute();
-	Msec ms;
+	void write(const char* s, size_t n);
+
+	string pending;  // protected by 'mutex'
 };
 
-/* External interface that takes care of 2 global threads */
+// The longest time in ms a search may go without calling check_time()
+const Msec TimeResolution = 5;
+// Interval in ms between two live 'info nodes nps hashfull' lines
+const Msec InfoInterval = 1000;
+// Raises the stop signal when the time or node limit of the search context is reached.
+// Called by every search itself every few nodes, see SearchUtils::POLL_INTERVAL
+void check_time();
+// Called along with check_time() by the searches that aren't silent. Prints their
+// progress at most every InfoInterval, so that long iterations still show their nodes,
+// nps and hashfull
+void print_live_info();
+
+/* External interface that takes care of the global threads */
 namespace ThreadPool
 {
-	extern MainThread *Main;
-	extern ClockThread *Clock;
+	extern InputThread *Input;
+	extern OutputThread *Output;
 
 	// will be called at program startup
-	void init();
+	// Without readInput, stdin is left alone (command line mode)
+	void init(bool readInput = true);
 	// will be called at program exit
 	void terminate();
-
-	// Waits for the main thread to sleep/ exit search and then returns
-	extern ConditionVar mainWaitCond;
-	void wait_until_main_finish();
 }
 
 
-// A necessary wrapper for the thread execution function
-inline long launch_routine(Thread* th) { th->execute(); return 0; }
+// A necessary wrapper for the thread execution function.
+// The thread's trace ring goes with it
+inline long launch_routine(Thread* th) { th->execute(); Trace::release(); return 0; }
 // external ctor of Thread class, otherwise invalid pure function call
 template<typename ThreadType>
 ThreadType* new_thread()
@@ -168,8 +233,12 @@ ThreadType* new_thread()
 template<typename ThreadType>
 inline void del_thread(ThreadType*& th) // ref to pointer
 {
-	th->signal();
+	// Clear the flag under the lock, or the thread might check it
+	// just before we signal and then sleep forever
+	th->mutex.lock();
 	th->exist = false;
+	th->sleepCond.signal();
+	th->mutex.unlock();
 	thread_join(th->handle);
 	delete th;
 	th = nullptr;
@@ -184,6 +253,8 @@ inline ostream& operator<<(ostream& os, SyncIO sync)
 	return os;
 }
 
+// While the OutputThread is alive, cout only fills a memory buffer.
+// endl merely wakes up the OutputThread, which does the actual console IO.
 #define sync_print(msg) \
 	cout << io_lock << msg << endl << io_unlock
 
@@ -2,7 +2,7 @@
 #include "uci.h"
 #include "search.h"
 
-using namespace Search; // For "Limit" the Global LimitListener
+using namespace Search; // For the limit of the search context
 using UCI::OptMap;
 
 // This lookup table will be filled at Search::init() (program startup)
@@ -75,7 +75,7 @@ inline Msec min_total(Msec base, Msec inc, int mtgMax, int curPly)
 	return max(minTotal, 0); // guarantee non-negative
 }
 
-// Computes and allocates tOptimal and tMax at each Search::think()
+// Computes and allocates tOptimal and tMax before each search
 // word play on 'malloc' and 'calloc'
 // For each move we need to make, compute only once and store as private fields.
 // 
@@ -84,24 +84,24 @@ void TimeKeeper::talloc(Color us, int curPly)
 	// Clear the unstable PV adjustment
 	tUnstablePV = 0;
 
-	// If the UCI Limit.movesToGo is 0, we default mtg to 50
+	// If the UCI movesToGo is 0, we default mtg to 50
 	// In fact, if UCI doesn't specify 'movestogo', it means we have to complete infinite
 	// moves (until mate) in the remaining time - sudden death
-	int mtg = Limit.movesToGo ? min(Limit.movesToGo, 50) : 50;
+	int mtg = Ctx->limit.movesToGo ? min(Ctx->limit.movesToGo, 50) : 50;
 
 	// Compute our total available time (without increments)
 	// deduct some time for emergency situations
 	// of course must be non-negative
-	Msec totalBase = max(Limit.time[us] - 160 - 70 * min(mtg, 40),  0);
-	Msec inc = Limit.increment[us];
+	Msec totalBase = max(Ctx->limit.time[us] - 160 - 70 * min(mtg, 40),  0);
+	Msec inc = Ctx->limit.increment[us];
 
 	// Read from UCI optionmap: minimum time
 	int tMin = OptMap["Min Thinking Time"];
 
 	// Shouldn't cross the hard deadline
-	tOptimal = min(Limit.time[us], 
+	tOptimal = min(Ctx->limit.time[us], 
 				tMin + min_total<true>(totalBase, inc, mtg, curPly));
-	tMax = min(Limit.time[us], 
+	tMax = min(Ctx->limit.time[us], 
 				tMin + min_total<false>(totalBase, inc, mtg, curPly));
 
 	// Read from UCI: give more time if we're allowed to ponder
@@ -114,7 +114,7 @@ void TimeKeeper::talloc(Color us, int curPly)
 }
 
 
-// If the PV is unstable (reflected by the 'BestMoveChanges' variable in search.cpp)
+// If the PV is unstable (reflected by the context's 'bestMoveChanges' in search.cpp)
 // we need to alloc more time to compensate for our indecision
 void TimeKeeper::unstable_pv_adjust(float bestMoveChanges)
 {
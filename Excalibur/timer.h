@@ -16,11 +16,11 @@
 /// to be "sudden death": we need to play ALL remaining moves, 
 /// regardless of how many might be, within T.
 
-class TimeKeeper // single instance in search.cpp : TimeKeeper Timer;
+class TimeKeeper // one per search context: Search::Context::timer
 {
 public:
 	static void init(); // init the ply_weight lookup table. Called at Search::init()
-	// Computes and allocates (like 'malloc') tOptimal and tMax at each Search::think()
+	// Computes and allocates (like 'malloc') tOptimal and tMax before each search
 	void talloc(Color us, int curPly);
 	// compute on the fly and adjust tOptimal if PV is unstable
 	void unstable_pv_adjust(float bestMoveChanges);
@@ -0,0 +1,136 @@
+#include "trace.h"
+#include "thread.h"
+
+namespace Trace
+{
+
+const char *NodeKindName[NODE_KIND_N] =
+	{ "root", "pv", "non_pv", "qs_pv", "qs_non_pv" };
+
+const char *ReasonName[REASON_N] =
+{
+	"searched", "aborted", "draw", "mate_distance", "tt_cutoff",
+	"razor", "static_null", "null_move", "null_threat", "no_moves", "stand_pat"
+};
+
+volatile bool Enabled = false;
+
+const uint VERSION = 1;
+const uint RING_SIZE = 1 << 16;  // records per thread: 1 MB
+const size_t FILE_CHUNK = 16 << 20;  // the file grows by this much at least
+
+// Allocated on the first record of a thread, and freed by release() when it exits
+struct Ring
+{
+	Record rec[RING_SIZE];
+	uint count;
+};
+THREAD_LOCAL Ring *Local = nullptr;
+
+// Shared by all threads, protected by 'lock'
+Mutex lock;
+MappedFile File;
+U64 Written, Dropped, Capacity;  // in records
+
+inline FileHeader *header() { return (FileHeader *) File.data(); }
+inline size_t file_bytes(U64 records)
+	{ return sizeof(FileHeader) + size_t(records) * sizeof(Record); }
+
+bool enabled()
+{
+#ifdef TRACE
+	return true;
+#else
+	return false;
+#endif
+}
+
+string start(string filePath, int maxMB)
+{
+	if (!enabled())
+		return "tracing is not compiled in. Build with make TRACE=1";
+	stop();
+
+	lock.lock();
+	Written = Dropped = 0;
+	Capacity = (U64(maxMB) << 20) / sizeof(Record);
+	try { File.create(filePath, file_bytes(min<U64>(Capacity, FILE_CHUNK / sizeof(Record)))); }
+	catch (FileNotFoundException& e)
+	{
+		lock.unlock();
+		return e.what();
+	}
+	memcpy(header()->magic, "EXTR", 4);
+	header()->version = VERSION;
+	header()->records = 0;
+	lock.unlock();
+
+	Enabled = true;
+	return "";
+}
+
+void flush()
+{
+	Ring *ring = Local;
+	if (!ring || ring->count == 0)
+		return;
+
+	lock.lock();
+	// Records of a search that outlived 'trace off' are discarded
+	if (File.data())
+	{
+		U64 n = min<U64>(ring->count, Capacity - Written);
+		if (file_bytes(Written + n) > File.size()
+			&& !File.resize(min(file_bytes(Capacity),
+						max(File.size() * 2, file_bytes(Written + n) + FILE_CHUNK))))
+			n = 0;  // out of disk space: keep what we have
+		if (File.data())
+		{
+			memcpy(File.data() + file_bytes(Written), ring->rec, size_t(n) * sizeof(Record));
+			Written += n;
+			header()->records = Written;
+		}
+		Dropped += ring->count - n;
+	}
+	lock.unlock();
+
+	ring->count = 0;
+}
+
+void release()
+{
+	flush();
+	delete Local;
+	Local = nullptr;
+}
+
+void append(const Record& rec)
+{
+	Ring *ring = Local ? Local : (Local = new Ring());
+	ring->rec[ring->count++] = rec;
+	if (ring->count == RING_SIZE)
+		flush();
+}
+
+string stop()
+{
+	Enabled = false;
+	flush();
+
+	lock.lock();
+	if (!File.is_open())
+	{
+		lock.unlock();
+		return "trace is off";
+	}
+	File.resize(file_bytes(Written));  // cut the unused tail
+	File.close();
+	ostringstream oss;
+	oss << "trace: " << Written << " nodes written";
+	if (Dropped)
+		oss << ", " << Dropped << " dropped over the size limit";
+	lock.unlock();
+	return oss.str();
+}
+
+} // namespace Trace
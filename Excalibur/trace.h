@@ -0,0 +1,132 @@
+/*
+ *	Search tree trace recorder, for offline analysis of slow searches.
+ *	Compiled in only with -DTRACE (make TRACE=1). Otherwise the macros expand
+ *	to nothing and the search doesn't pay for it. Compiled in, a node costs
+ *	one test of a flag until tracing is switched on by the 'trace' command.
+ *	Every search() and qsearch() node appends one 16-byte Record to its
+ *	thread's ring. A full ring is copied to a memory-mapped file, which
+ *	the 'tracereader' tool aggregates.
+ *
+ *	File layout, little-endian:
+ *	- 16 byte FileHeader
+ *	- Records, in the order the nodes return (children before their parent).
+ *	  Record::node gives the order in which they were entered.
+ */
+
+#ifndef __trace_h__
+#define __trace_h__
+
+#include "utils.h"
+#include "move.h"
+
+namespace Trace
+{
+	enum NodeKind { ROOT_NODE, PV_NODE, NON_PV_NODE, QS_PV_NODE, QS_NON_PV_NODE, NODE_KIND_N };
+
+	// Why the node returned
+	enum Reason
+	{
+		SEARCHED,  // went through the move loop, or a qsearch cutoff
+		ABORTED,  // Signal.stop
+		DRAW,  // repetition, 50 moves or MAX_PLY
+		MATE_DISTANCE,
+		TT_CUTOFF,
+		RAZOR,
+		STATIC_NULL,
+		NULL_MOVE,
+		NULL_THREAT,  // null move failed low on a move connected to the parent's reduction
+		NO_MOVES,  // mate or stalemate
+		STAND_PAT,
+		REASON_N
+	};
+
+	struct Record
+	{
+		uint node;  // low 32 bits of Position::nodes when the node was entered
+		Move move;  // the move that led here. MOVE_NULL at the root or after a null move
+		short alpha, beta;  // the window on entry
+		short result;  // the returned value
+		short depth;  // in Depth units, ONE_PLY == 2
+		byte ply;
+		byte kind;  // NodeKind | Reason << 4
+
+		NodeKind node_kind() const { return NodeKind(kind & 0xF); }
+		Reason reason() const { return Reason(kind >> 4); }
+	};
+
+	static_assert(sizeof(Record) == 16, "Trace::Record must be exactly 16 bytes");
+
+	struct FileHeader
+	{
+		char magic[4];  // "EXTR"
+		uint version;
+		U64 records;
+	};
+
+	extern const char *NodeKindName[NODE_KIND_N];
+	extern const char *ReasonName[REASON_N];
+
+	// Switched by start() and stop(). Read at every node
+	extern volatile bool Enabled;
+
+	// Compiled with -DTRACE?
+	bool enabled();
+
+	// Starts tracing into a new file, at most maxMB megabytes.
+	// Returns an error message, or "" on success
+	string start(string filePath, int maxMB);
+	// Flushes the calling thread and closes the file. Returns a summary
+	string stop();
+	// Copies the calling thread's ring to the file. Called when a search ends
+	void flush();
+	// Flushes and frees the calling thread's ring. Called when a thread exits
+	void release();
+	// Appends to the calling thread's ring
+	void append(const Record& rec);
+
+	// Records the node on exit. Lives on the stack frame of the node
+	class NodeRecorder
+	{
+	public:
+		NodeRecorder(U64 nodes, Move move, Value alpha, Value beta, Depth depth, int ply, NodeKind kind)
+			: active(Enabled)
+		{
+			if (!active)  return;
+			rec.node = uint(nodes);
+			rec.move = move;
+			rec.alpha = short(alpha);
+			rec.beta = short(beta);
+			rec.depth = short(depth);
+			rec.ply = byte(ply);
+			rec.kind = byte(kind);
+		}
+
+		Value exit(Reason reason, Value result)
+		{
+			if (active)
+			{
+				rec.result = short(result);
+				rec.kind |= reason << 4;
+				append(rec);
+			}
+			return result;
+		}
+
+	private:
+		bool active;
+		Record rec;
+	};
+}
+
+#ifdef TRACE
+  // At the top of search() and qsearch(), once ss->ply is set. 'kind' is a Trace::NodeKind
+#  define TRACE_NODE(kind) \
+	Trace::NodeRecorder traceRec(pos.nodes, (ss-1)->currentMv, alpha, beta, depth, ss->ply, kind)
+  // return TRACED(reason, value);
+#  define TRACED(reason, value) traceRec.exit(Trace::reason, value)
+#else
+#  define TRACE_NODE(kind)
+#  define TRACED(reason, value) (value)
+#endif
+
+#endif // __trace_h__
@@ -0,0 +1,146 @@
+/*
+ *	Aggregates a search tree trace written by the 'trace' command (make TRACE=1).
+ *	Build with 'make tracereader'. Usage: ./tracereader <file> [dump N]
+ *	Prints the root iterations, then the nodes by kind, by exit reason and by ply.
+ *	'dump N' also lists the first N nodes in the order they were entered.
+ */
+#include "trace.h"
+#include "uci.h"
+
+using namespace Trace;
+
+// Fail-high, fail-low and exact counts of a group of nodes
+struct Tally
+{
+	U64 nodes, high, low;
+	void add(const Record& r)
+	{
+		nodes ++;
+		if (r.result >= r.beta)  high ++;
+		else if (r.result <= r.alpha)  low ++;
+	}
+};
+
+string percent(U64 part, U64 whole)
+{
+	ostringstream oss;
+	oss << fixed << setprecision(1) << (whole ? 100.0 * part / whole : 0.0) << "%";
+	return oss.str();
+}
+
+void print_tally(string name, const Tally& t, U64 total)
+{
+	cout << setw(14) << name << setw(12) << t.nodes << setw(8) << percent(t.nodes, total)
+		<< setw(10) << percent(t.high, t.nodes) << setw(10) << percent(t.low, t.nodes)
+		<< setw(10) << percent(t.nodes - t.high - t.low, t.nodes) << endl;
+}
+
+void print_tally_title(string name)
+{
+	cout << "\n" << setw(14) << name << setw(12) << "nodes" << setw(8) << "share"
+		<< setw(10) << "high" << setw(10) << "low" << setw(10) << "exact" << endl;
+}
+
+void dump(const Record *recs, U64 n, U64 count)
+{
+	// Records are stored as the nodes return. Sort them back into entering order
+	vector<U64> order(n);
+	for (U64 i = 0; i < n; i++)  order[i] = i;
+	stable_sort(order.begin(), order.end(), [recs](U64 a, U64 b)
+		{ return recs[a].node != recs[b].node ? recs[a].node < recs[b].node : recs[a].ply < recs[b].ply; });
+
+	cout << "\n" << setw(10) << "node" << setw(5) << "ply" << "  " << left << setw(11) << "kind"
+		<< setw(7) << "move" << right << setw(7) << "depth" << setw(8) << "alpha" << setw(8) << "beta"
+		<< setw(8) << "result" << "  reason" << endl;
+	for (U64 i = 0; i < min(n, count); i++)
+	{
+		const Record& r = recs[order[i]];
+		cout << setw(10) << r.node << setw(5) << int(r.ply) << "  "
+			<< left << setw(11) << NodeKindName[r.node_kind()]
+			<< setw(7) << (r.move ? UCI::move2uci(r.move) : "-") << right
+			<< setw(7) << double(r.depth) / ONE_PLY << setw(8) << r.alpha << setw(8) << r.beta
+			<< setw(8) << r.result << "  " << ReasonName[r.reason()] << endl;
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc < 2)
+	{
+		cout << "Usage: tracereader <file> [dump N]" << endl;
+		return 1;
+	}
+	MappedFile file;
+	try { file.open(argv[1]); }
+	catch (FileNotFoundException& e)
+	{
+		cout << e.what() << endl;
+		return 1;
+	}
+	const FileHeader *header = (const FileHeader *) file.data();
+	if (file.size() < sizeof(FileHeader) || memcmp(header->magic, "EXTR", 4) != 0)
+	{
+		cout << argv[1] << " is not a search trace" << endl;
+		return 1;
+	}
+	const Record *recs = (const Record *) (file.data() + sizeof(FileHeader));
+	U64 n = min<U64>(header->records, (file.size() - sizeof(FileHeader)) / sizeof(Record));
+	cout << argv[1] << ": " << n << " nodes, format version " << header->version << endl;
+
+	Tally kinds[NODE_KIND_N] = {}, plies[MAX_PLY + 2] = {};
+	U64 reasons[NODE_KIND_N][REASON_N] = {};
+	U64 lastNode = 0;
+	for (U64 i = 0; i < n; i++)
+	{
+		const Record& r = recs[i];
+		kinds[r.node_kind()].add(r);
+		plies[min<int>(r.ply, MAX_PLY + 1)].add(r);
+		reasons[r.node_kind()][r.reason()] ++;
+		lastNode = max<U64>(lastNode, r.node);
+	}
+
+	// The root nodes, one per iteration and aspiration window.
+	// Nodes entered until the next root node belong to this one
+	vector<const Record *> roots;
+	for (U64 i = 0; i < n; i++)
+		if (recs[i].node_kind() == ROOT_NODE)
+			roots.push_back(recs + i);
+	if (!roots.empty())
+	{
+		cout << "\n" << setw(6) << "depth" << setw(8) << "alpha" << setw(8) << "beta"
+			<< setw(8) << "score" << setw(12) << "nodes" << "  reason" << endl;
+		for (size_t i = 0; i < roots.size(); i++)
+		{
+			const Record& r = *roots[i];
+			U64 next = i + 1 < roots.size() ? roots[i + 1]->node : lastNode + 1;
+			cout << setw(6) << r.depth / ONE_PLY << setw(8) << r.alpha << setw(8) << r.beta
+				<< setw(8) << r.result << setw(12) << next - r.node << "  " << ReasonName[r.reason()] << endl;
+		}
+	}
+
+	print_tally_title("kind");
+	for (int k = 0; k < NODE_KIND_N; k++)
+		print_tally(NodeKindName[k], kinds[k], n);
+
+	cout << "\n" << setw(14) << "reason";
+	for (int k = 0; k < NODE_KIND_N; k++)
+		cout << setw(11) << NodeKindName[k];
+	cout << endl;
+	for (int re = 0; re < REASON_N; re++)
+	{
+		cout << setw(14) << ReasonName[re];
+		for (int k = 0; k < NODE_KIND_N; k++)
+			cout << setw(11) << reasons[k][re];
+		cout << endl;
+	}
+
+	print_tally_title("ply");
+	for (int p = 0; p <= MAX_PLY + 1; p++)
+		if (plies[p].nodes)
+			print_tally(int2str(p), plies[p], n);
+
+	if (argc >= 4 && string(argv[2]) == "dump")
+		dump(recs, n, max(0, str2int(argv[3])));
+
+	return 0;
+}
@@ -84,4 +84,14 @@ namespace Transposition
 		replace->store(key0, v, bt, d, m, generation, s_val, s_margin);
 	}
 
+	int Table::hashfull() const
+	{
+		// Keys spread evenly over the clusters: any slice is a fair sample
+		uint n = min<uint>(1000, hashMask + ClusterSize), cnt = 0;
+		for (uint i = 0; i < n; i++)
+			if (table[i].key && table[i].generation == generation)
+				cnt ++;
+		return cnt * 1000 / n;
+	}
+
 }
\ No newline at end of file
@@ -18,6 +18,9 @@ namespace Transposition
 	class Table; // forward decl
 	// Global shared transposition table instance
 	extern Table TT; 
+	// The table of the calling thread's search context: TT unless the
+	// context brings its own. See Search::bind_context()
+	extern THREAD_LOCAL Table *ThreadTT;
 
 	struct Entry
 	{
@@ -50,10 +53,13 @@ namespace Transposition
 	class Table
 	{
 	public:
+		Table() : table(nullptr), hashMask(0), generation(0) {}
 		~Table() { free(table); }
 		void new_generation() { generation++; }
 
 		void set_size(U64 mbSize);
+		/// Memory in use: set_size() rounds down to a power of 2
+		U64 bytes() const { return U64(hashMask + ClusterSize) * sizeof(Entry); }
 		Entry* probe(U64 key) const;
 
 		/// TranspositionTable::first_entry() returns a pointer to the first entry of
@@ -74,6 +80,10 @@ namespace Transposition
 
 		void store(U64 key, Value v, BoundType type, int d, Move m, Value s_val, Value s_margin);
 
+		/// Permill of the table used by the current search, for UCI 'hashfull'.
+		/// Estimated from the first 1000 entries, so it's cheap enough to poll.
+		int hashfull() const;
+
 	private:
 		Entry* table;  // size on MB scale
 		uint hashMask;
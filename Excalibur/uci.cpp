@@ -1,38 +1,41 @@
 #include "uci.h"
 #include "thread.h"
 #include "search.h"
-#include "openbook.h"
 #include "eval.h"
+#include "stats.h"
+#include "trace.h"
+#include "engine.h"
+#include <atomic>
 
 using namespace Search;
 using namespace ThreadPool;
-using Transposition::TT;
 
 namespace UCI
 {
 // Instantiate global option map
 map<string, Option> OptMap;
 
+// The engine the UCI commands drive. Set while process() runs
+std::atomic<Excalibur::Engine *> UciEngine(nullptr);
+
+// Hands an option on to the engine, see Excalibur::Engine::set_option()
+void forward(const string& name)
+{
+	if (Excalibur::Engine *engine = UciEngine)
+		engine->set_option(name, (string) OptMap[name]);
+}
+
 // on-demand ChangeListeners
-void changer_hash_size() { TT.set_size(OptMap["Hash"]); } // auto cast to int
-void changer_clear_hash() { TT.clear(); }
-void changer_eval_weights() { Eval::init(); } // refresh weights
+void changer_hash_size() { forward("Hash"); }
+void changer_clear_hash() { if (Excalibur::Engine *engine = UciEngine) engine->new_game(); }
+void changer_play_style() // eval weights, contempt and power
+	{ for (const char *name : StyleOptions) forward(name); }
+void changer_warm_requery() { forward("Warm Requery"); }
+void changer_speculative_ponder() { forward("Speculative Ponder"); }
 void changer_time_usage() 
 	{ Search::IterativeTimePercentThreshold = OptMap["Time Usage"] * 1.0 / 100; }
-void changer_contempt_factor()
-	{ Search::update_contempt_factor(); }
-void changer_book_load() // Also randomize Rkiss
-{  
-	if ((bool)OptMap["Use Opening Book"])
-	{
-		Polyglot::load((string)OptMap["Book File"]);
-		RKiss::init_seed(now() % 2000); 
-	}
-}
-void changer_book_variation()
-	{ Polyglot::AllowBookVariation = (bool)OptMap["Book Variation"]; }
-void changer_power()  // skill level
-	{ Search::handicap = OptMap["Power Level"] * 2; }
+void changer_book_load() { forward("Book File"); forward("Use Opening Book"); }
+void changer_book_variation() { forward("Book Variation"); }
 
 // Initialize default UCI options
 void init_options()
@@ -41,21 +44,27 @@ void init_options()
 	OptMap["Hash"] = Option(128, 1, 8192, changer_hash_size); // spinner. Not shown
 	OptMap["Clear Hash"] = Option(changer_clear_hash); // button. Not shown
 	OptMap["Ponder"] = Option(true); // checkbox. Not shown. Alloc more time if we're allowed to ponder
+	// Number of best lines to search and report. See Search::iterative_deepen()
+	OptMap["MultiPV"] = Option(1, 1, MAX_MULTI_PV);
+	// Repeated searches of one root (e.g. 'searchmoves' subsets) resume each other
+	OptMap["Warm Requery"] = Option(false, changer_warm_requery);
+	// Opponent's replies pondered on helper threads besides the predicted one. See ponder.cpp
+	OptMap["Speculative Ponder"] = Option(0, 0, 8, changer_speculative_ponder);
 
 	// Evaluation weights 
-	OptMap["Mobility"] = Option(100, 0, 200, changer_eval_weights);
-	OptMap["Pawn Shield"] = Option(100, 0, 200, changer_eval_weights);
-	OptMap["King Safety"] = Option(100, 0, 200, changer_eval_weights);
-	OptMap["Aggressiveness"] = Option(100, 0, 200, changer_eval_weights);
+	OptMap["Mobility"] = Option(100, 0, 200, changer_play_style);
+	OptMap["Pawn Shield"] = Option(100, 0, 200, changer_play_style);
+	OptMap["King Safety"] = Option(100, 0, 200, changer_play_style);
+	OptMap["Aggressiveness"] = Option(100, 0, 200, changer_play_style);
 
 	// Timing
 	OptMap["Time Allocation"] = Option(100, 1, 500);
 	OptMap["Time Usage"] = Option(64, 1, 100, changer_time_usage); 
 	OptMap["Min Thinking Time"] = Option(20, 0, 5000); // spinner. Measured in ms
 
-	OptMap["Contempt Factor"] = Option(0, -50, 50, changer_contempt_factor); // spinner. Measured in centipawn
+	OptMap["Contempt Factor"] = Option(0, -50, 50, changer_play_style); // spinner. Measured in centipawn
 	// If not 10, plays handicap. 1 <= depth <= power * 2
-	OptMap["Power Level"] = Option(10, 0, 10, changer_power); 
+	OptMap["Power Level"] = Option(10, 0, 10, changer_play_style); 
 
 	// Opening book options
 	OptMap["Use Opening Book"] = Option(false, changer_book_load);
@@ -67,9 +76,7 @@ void init_options()
 // If this option has a ChangeListener, apply the changer.
 Option& Option::operator=(const string& newval)
 {
-	if ( (type != "button" && newval.empty()) // no appropriate input
-		|| (type == "check" && newval != "true" && newval != "false") // invalid checkbox
-		|| (type == "spin" && !(minval <= str2int(newval) && str2int(newval) <= maxval)) ) // spinner out of range
+	if (!accepts(newval))
 		return *this; // do nothing
 
 	if (type != "button")
@@ -81,6 +88,13 @@ Option& Option::operator=(const string& newval)
 	return *this;
 }
 
+bool Option::accepts(const string& newval) const
+{
+	return !( (type != "button" && newval.empty()) // no appropriate input
+		|| (type == "check" && newval != "true" && newval != "false") // invalid checkbox
+		|| (type == "spin" && !(minval <= str2int(newval) && str2int(newval) <= maxval)) ); // spinner out of range
+}
+
 // Print all the default option values (in the global OptMap) to the GUI
 // Force display in the same sequence we add them to avoid GUI mess. 
 template<bool Default>
@@ -136,7 +150,7 @@ class PerftThread : public Thread
 // uses the global helper struct PerftHelper
 void PerftThread::execute()
 {
-	Signal.stop = false;
+	Ctx->signal.stop = false;
 	try
 	{
 		switch (PH.type)
@@ -150,10 +164,11 @@ void PerftThread::execute()
 		case 2: PH.useHash ?
 				  perft_verifier<true>(PH.epdFile, PH.epdId)
 				: perft_verifier<false>(PH.epdFile, PH.epdId); break;
+		case 3: sorter_speedometer(PH.posperft, PH.depth); break;
 		}
 	} catch (FileNotFoundException e) // must be an exception pointer
-	{ cout << e.what() << endl; Signal.stop = true; }
-	Signal.stop = true;
+	{ cout << e.what() << endl; Ctx->signal.stop = true; }
+	Ctx->signal.stop = true;
 }
 
 // handy macro for 'perft' command
@@ -163,6 +178,14 @@ void PerftThread::execute()
 #define kill_perft del_thread<PerftThread>(pth)
 
 
+// The engine sorts out whether 'ponderhit' ends the search
+void stop_search(bool ponderhit)
+{
+	if (Excalibur::Engine *engine = UciEngine)
+		ponderhit ? engine->ponderhit() : engine->stop();
+}
+
+
 /*******************************************************************/
 /*******************	UCI protocol main processor **********************/
 /*******************************************************************/
@@ -194,14 +217,29 @@ GUI -> engine: go...
  **/
 void process()
 {
+	// The engine searches and prints its 'info'. We print its best move
+	Excalibur::Engine engine(OptMap["Hash"]);
+	engine.set_option("UCI Info", "true");
+	UciEngine = &engine;
+	auto print_bestmove = [](const Excalibur::SearchResult& res)
+	{
+		// MOVE_NULL if we search on a stalemate position. pv[1] is our prediction
+		// of the opponent's move, which will be pondered upon
+		string none = move2uci(MOVE_NULL);
+		sync_print("bestmove " << (res.bestMove.empty() ? none : res.bestMove)
+			<< " ponder " << (res.ponderMove.empty() ? none : res.ponderMove));
+	};
+
+	// The same position as the engine's, for the commands that don't search
 	Position pos;
+	SetupStatePtr setupStates(new stack<StateInfo>());
 	string str, cmd, strlast;
 	PerftThread *pth = nullptr;
 	DBG_FILE_INIT("UCI_log.txt"); // debugging output
 
 do
 {
-	if (!getline(cin, str))  // waiting for input. EOF means quit
+	if (!Input->read_line(str))  // waiting for input. EOF means quit
 		str = "quit";
 	DBG_FOUT(str);
 	if (str == ".") // repeat the last command
@@ -217,28 +255,12 @@ do
 	// stop signals
 	if (cmd == "quit" || cmd == "stop" || cmd == "ponderhit")
 	{
-		if (pth && !Signal.stop) // Show abort perft message
+		if (pth && !Ctx->signal.stop) // Show abort perft message
 			sync_print("aborting perft ...");
 
-		// In case Signal.stopOnPonderhit is set we are
-		// waiting for 'ponderhit' to stop the search (for instance because we
-		// already ran out of time), otherwise we should continue searching but
-		// switching from pondering to normal search.
-		if (cmd != "ponderhit" || Signal.stopOnPonderhit)
-		{
-			Signal.stop = true;
-
-			// Might be waiting for a stop signal before it 
-			// prints out the bestmoves. Possible scenario:
-			// we've searched all the way up to the maximal depth (like mate)
-			// in pondering mode. Then we have to wait for a 'ponderhit'
-			// or 'stop' before we print the bestmoves, as required by UCI
-			Main->signal();
-		}
-		else
-			Limit.ponder = false;
+		stop_search(cmd == "ponderhit");
 
-		if (pth)	kill_perft;  // Kill the perft thread
+		if (pth)	{ Ctx->signal.stop = true; kill_perft; }  // Kill the perft thread
 	}
 
 	/**********************************************/
@@ -246,67 +268,38 @@ do
 	/**********************************************/
 	else if (cmd == "go")
 	{
-		vector<Move> searchMoveList;
-
-		// Clear the LimitListener in namespace Search first
-		Limit.clear();  
+		Excalibur::Limits limits;
+		limits.multiPV = OptMap["MultiPV"];
 
 		while (iss >> str) // all supported sub-cmd after 'go'
 		{
 			// Restrict search to these moves only
 			if (str == "searchmoves")
 				while (iss >> str)
-					searchMoveList.push_back(uci2move(pos, str));
+					limits.searchMoves.push_back(str);
 			// Main time left for both sides
-			else if (str == "wtime")	iss >> Limit.time[W];
-			else if (str == "btime")		iss >> Limit.time[B];
+			else if (str == "wtime")	iss >> limits.time[W];
+			else if (str == "btime")		iss >> limits.time[B];
 			// Time increments per move
-			else if (str == "winc")		iss >> Limit.increment[W];
-			else if (str == "binc")		iss >> Limit.increment[B];
+			else if (str == "winc")		iss >> limits.increment[W];
+			else if (str == "binc")		iss >> limits.increment[B];
 			// There're x moves left until the next time control
-			else if (str == "movestogo")		iss >> Limit.movesToGo;
+			else if (str == "movestogo")		iss >> limits.movesToGo;
 			// Search x plies only
-			else if (str == "depth")		iss >> Limit.depth;
+			else if (str == "depth")		iss >> limits.depth;
 			// Search up to x nodes
-			else if (str == "nodes")		iss >> Limit.nodes;
+			else if (str == "nodes")		iss >> limits.nodes;
 			// Search for a mate in x moves
-			else if (str == "mate")		iss >> Limit.mateInX;
+			else if (str == "mate")		iss >> limits.mate;
 			// Search for exactly x msec
-			else if (str == "movetime")	iss >> Limit.moveTime;
+			else if (str == "movetime")	iss >> limits.moveTime;
 			// Search until 'stop'. Otherwise never exit
-			else if (str == "infinite")		Limit.infinite = true;
+			else if (str == "infinite")		limits.infinite = true;
 			// Start searching in pondering mode
-			else if (str == "ponder")		Limit.ponder;
+			else if (str == "ponder")		limits.ponder = true;
 		}
 
-		// We need to wait until Main thread finishes searching
-		ThreadPool::wait_until_main_finish();
-
-		//** Most of the variables below are globals critical to search.cpp **//
-		// Main is idle now. Reset all signals
-		Signal.stopOnPonderhit = Signal.stop = false;
-
-		// Start our clock: SearchTime global var in the search.cpp records the 
-		// starting point at which we begin thinking on the current move.
-		// "How much time has elapsed" can be answered by subtraction: now() - SearchTime
-		SearchTime = now();
-
-		// Search::SetupStates are set in UCI command 'position'
-		RootMoveList.clear();
-		RootPos = pos;
-
-		// Check whether searchMoveList has all legal moves
-		MoveBuffer mbuf;
-		ScoredMove *it, *end = pos.gen_moves<LEGAL>(mbuf);
-		for (it = mbuf, end->move = MOVE_NULL; it != end; ++it)
-			if ( searchMoveList.empty() // no 'searchmoves' cmd specified. We add all legal moves as RootMove
-				// if a legal move is found within the UCI specified searchmoves, add it
-				|| std::find(searchMoveList.begin(), searchMoveList.end(), it->move) != searchMoveList.end())
-				RootMoveList.push_back(RootMove(it->move));
-
-		// Wake up and start our business!
-		Main->searching = true;
-		Main->signal();
+		engine.analyze(limits, Excalibur::InfoCallback(), print_bestmove);
 	}
 
 
@@ -327,21 +320,28 @@ do
 		else // sub-command not supported
 			continue;
 
-		pos.parse_fen(fen);
+		Position newPos(fen);
+		SetupStatePtr newStates(new stack<StateInfo>());
 		
 		// Optional UCI-format move list after 'moves' sub-cmd
-		// Parse the move list and play them on the internal board
-		// First we clear the global SetupStates variable in Search namespace
-		SetupStates = SetupStatePtr(new stack<StateInfo>());
-
+		// Parse the move list and play them on the internal board, up to the first illegal one
+		vector<string> moves;
 		Move mv;
-		while (iss >> str && (mv = uci2move(pos, str)) != MOVE_NULL )
+		while (iss >> str && (mv = uci2move(newPos, str)) != MOVE_NULL )
 		{
-			SetupStates->push(StateInfo());
+			moves.push_back(str);
+			newStates->push(StateInfo());
 			// play the move with the most recently created state.
-			pos.make_move(mv, SetupStates->top());
+			newPos.make_move(mv, newStates->top());
 		}
 
+		if (!engine.set_position(fen, moves))
+			sync_print("info string bad position: " << fen);
+		else
+		{
+			pos = newPos;
+			setupStates = newStates;
+		}
 	}  // cmd 'position'
 
 
@@ -351,9 +351,9 @@ do
 		sync_print(engine_id << options2str<true>() << "uciok");
 
 	/**********************************************/
-	// Starts a new game. Do nothing actually. 
+	// Starts a new game: clears the hash table and the search history
 	else if (cmd == "ucinewgame")
-		{ /* accomodate UCI protocol */ }
+		engine.new_game();
 	else if (cmd == "isready")
 		sync_print("readyok");
 
@@ -388,7 +388,7 @@ do
 	else if (cmd == "perft")
 	{
 		if (pth) // never run 2 perfts at the same time
-			if (!Signal.stop) { sync_print("perft is running"); continue; }
+			if (!Ctx->signal.stop) { sync_print("perft is running"); continue; }
 			else kill_perft;
 
 			PH.posperft = pos; // Shared "pos"
@@ -404,8 +404,9 @@ do
 				bool again = true, first = true;
 				while (again)
 				{
-					cout << "depth: ";
-					getline(cin, response);
+					cout << "depth: " << flush;
+					if (!Input->read_line(response))
+						response = "quit";
 					if ( !pth && ((!first && response.empty()) || istringstream(response) >> PH.depth) )
 					{ start_perft(0); kill_perft; } // blocks here
 					else
@@ -435,6 +436,12 @@ do
 					// Run from a specific id-gentest
 					else { PH.epdId = args[1]; start_perft(2); }
 				}
+				// Benchmark MoveSorter alone on the perft tree of "pos", default depth 3
+				else if (opt == "sort")
+				{
+					PH.depth = (size > 1 && is_int(args[1])) ? str2int(args[1]) : 3;
+					start_perft(3);
+				}
 				// Resize, disable or clear the perft hash
 				else if (opt == "hash" && size == 2)
 				{
@@ -454,6 +461,68 @@ do
 	}  // cmd 'perft'
 
 
+	/**********************************************/
+	// Fixed depth search of the built-in positions. Syntax: bench [depth] [threads] [hash]
+	else if (cmd == "bench")
+		bench(iss);
+
+	/**********************************************/
+	// Opening book tools. Syntax: book build <pgn> <out> [maxply] [threads]
+	else if (cmd == "book")
+		book(iss);
+
+	/**********************************************/
+	// EPD batch analysis. Syntax: analyze <epd> [--threads N] --depth D|--nodes N|--movetime T [--out file]
+	else if (cmd == "analyze")
+		analyze(iss);
+
+	/**********************************************/
+	// Self-play between two option sets. Syntax: see match.cpp
+	else if (cmd == "match")
+		match(iss);
+
+	/**********************************************/
+	// Training data: self-play generator, reader and shuffler. Syntax: see gensfen.cpp
+	else if (cmd == "gensfen")
+		gensfen(iss);
+
+	/**********************************************/
+	// Analysis server on a Unix domain socket. Syntax: see server.cpp
+	else if (cmd == "serve")
+		serve(iss);
+
+	/**********************************************/
+	// Search statistics (make STATS=1). Syntax: stats [json] [total | reset]
+	else if (cmd == "stats")
+	{
+		bool json = false, total = false;
+		while (iss >> str)
+		{
+			if (str == "json")	json = true;
+			else if (str == "total")	total = true;
+			else if (str == "reset")	{ SearchStats::reset_total(); total = true; }
+		}
+		sync_print(SearchStats::report(json, total));
+	}
+
+	/**********************************************/
+	// Search tree trace (make TRACE=1). Syntax: trace <file> [max MB] | trace off
+	// Records every node of the following searches. Read it with ./tracereader
+	else if (cmd == "trace")
+	{
+		if (!(iss >> str))
+			sync_print("Usage: trace <file> [max MB] | trace off");
+		else if (str == "off")
+			sync_print("info string " << Trace::stop());
+		else
+		{
+			string maxMB;
+			iss >> maxMB;
+			string err = Trace::start(str, is_int(maxMB) ? max(1, str2int(maxMB)) : 1024);
+			sync_print("info string " << (err.empty() ? "tracing to " + str : err));
+		}
+	}
+
 	/**********************************************/
 	// Display the board as an ASCII graph
 	else if (cmd == "d" || cmd == "disp")  // full display
@@ -500,8 +569,8 @@ do
 
 } while (cmd != "quit"); // infinite stdin loop
 
-	// Cannot quit while search is searching
-	ThreadPool::wait_until_main_finish();
+	// The engine prints its best move before it goes
+	UciEngine = nullptr;
 
 } // main UCI::process() function
 
@@ -513,15 +582,28 @@ do
 
 // UCI long algebraic notation
 string move2uci(Move mv)
+{
+	char buf[8];
+	move2uci(mv, buf);
+	return buf;
+}
+
+// Writes the move into buf, which needs room for 6 chars, null included.
+// Returns the end of the string so that calls can be chained.
+char* move2uci(Move mv, char* buf)
 {
 	if (mv == MOVE_NULL)
-		return "null";
+		return buf + sprintf(buf, "null");
 
-	string mvstr = sq2str(get_from(mv));
-	mvstr += sq2str(get_to(mv));
+	Square from = get_from(mv), to = get_to(mv);
+	*buf++ = 'a' + sq2file(from);
+	*buf++ = '1' + sq2rank(from);
+	*buf++ = 'a' + sq2file(to);
+	*buf++ = '1' + sq2rank(to);
 	if (is_promo(mv))
-		mvstr += PIECE_FEN[B][get_promo(mv)]; // must be lower case
-	return mvstr;
+		*buf++ = PIECE_FEN[B][get_promo(mv)][0]; // must be lower case
+	*buf = '\0';
+	return buf;
 }
 
 // Similar to move2uci but used only for debugging
@@ -561,6 +643,71 @@ Move uci2move(const Position& pos, string& mvstr)
 	return MOVE_NULL; // not valid
 }
 
+// Parse the SAN into its parts, then look for the one legal move that fits.
+// Accepts the usual sloppiness of PGN files: missing or extra check marks,
+// "0-0" castling, "e8Q" promotions and annotations like "!?"
+Move san2move(const Position& pos, string san)
+{
+	while (!san.empty() && strchr("+#!?", san.back()))
+		san.pop_back();
+	if (san.size() < 2)
+		return MOVE_NULL;
+
+	bool castle = san == "O-O" || san == "0-0";
+	bool castleLong = san == "O-O-O" || san == "0-0-0";
+	PieceType pt = PAWN, promo = NON;
+	int fromFile = -1, fromRank = -1;
+	Square to = SQ_NULL;
+
+	if (!castle && !castleLong)
+	{
+		size_t i = 0;
+		const char *names = " PNBRQK";
+		if (strchr(names + 2, san[0]))
+			pt = PieceType(strchr(names, san[i++]) - names);
+
+		// Promotion at the end: "=Q" or just "Q"
+		size_t n = san.size();
+		if (pt == PAWN && strchr("NBRQ", san[n - 1]))
+		{
+			promo = PieceType(strchr(names, san[--n]) - names);
+			if (san[n - 1] == '=')  --n;
+		}
+		if (n < i + 2 || san[n-2] < 'a' || san[n-2] > 'h' || san[n-1] < '1' || san[n-1] > '8')
+			return MOVE_NULL;
+		to = str2sq(san.substr(n - 2, 2));
+
+		// Whatever is left between the piece and the destination: disambiguation and 'x'
+		for (; i < n - 2; i++)
+			if (san[i] >= 'a' && san[i] <= 'h')  fromFile = san[i] - 'a';
+			else if (san[i] >= '1' && san[i] <= '8')  fromRank = san[i] - '1';
+	}
+
+	Move found = MOVE_NULL;
+	MoveBuffer mbuf;
+	ScoredMove *it, *end = pos.gen_moves<LEGAL>(mbuf);
+	for (it = mbuf, end->move = MOVE_NULL; it != end; ++it)
+	{
+		Move mv = it->move;
+		Square from = get_from(mv);
+		if (is_castle(mv))
+		{
+			if ((castle && get_to(mv) > from) || (castleLong && get_to(mv) < from))
+				return mv;
+			continue;
+		}
+		if (castle || castleLong || get_to(mv) != to || pos.piece_on(from) != pt
+			|| (fromFile >= 0 && sq2file(from) != fromFile)
+			|| (fromRank >= 0 && sq2rank(from) != fromRank)
+			|| (is_promo(mv) ? get_promo(mv) != promo : promo != NON))
+			continue;
+		if (found != MOVE_NULL)
+			return MOVE_NULL;  // ambiguous
+		found = mv;
+	}
+	return found;
+}
+
 
 // Sent after the command 'info score '
 // UCI protocol:
@@ -576,19 +723,23 @@ Move uci2move(const Position& pos, string& mvstr)
 //		
 string score2uci(Value val, Value alpha, Value beta)
 {
-	ostringstream oss;
+	char buf[32];
+	score2uci(val, alpha, beta, buf);
+	return buf;
+}
 
+// Writes the score into buf (32 chars is plenty). Returns the end of the string
+char* score2uci(Value val, Value alpha, Value beta, char* buf)
+{
 	// We aren't mated or giving mate. Print out the centipawn value
 	if (abs(val) < VALUE_MATE_IN_MAX_PLY)
-		oss << "cp " << val * 100 / MG_PAWN;
+		buf += sprintf(buf, "cp %d", val * 100 / MG_PAWN);
 
 	else //Mated or giving mate: calculate how many full moves to mate - divide the ply by 2
-		oss << "mate " << (val > 0 ? VALUE_MATE - val + 1 : -VALUE_MATE - val) / 2;
-
-	oss << ( val >= beta ? " lowerbound" 
-			: val <= alpha ? " upperbound" : "" );
+		buf += sprintf(buf, "mate %d", (val > 0 ? VALUE_MATE - val + 1 : -VALUE_MATE - val) / 2);
 
-	return oss.str();
+	return buf + sprintf(buf, "%s", val >= beta ? " lowerbound" 
+			: val <= alpha ? " upperbound" : "");
 }
 
 
@@ -601,7 +752,7 @@ string move2san(Position& pos, Move mv)
 	Square from = get_from(mv);
 	Square to = get_to(mv);
 	Color us = pos.turn;
-	PieceType pt = pos.boardPiece[from];
+	PieceType pt = pos.piece_on(from);
 
 	Bit disambig, tmp;
 	string san = "";
@@ -691,25 +842,53 @@ string move2san(Position& pos, Move mv)
 //		x nodes per second searched, the engine should send this info regularly
 //		
 //	Needs global variable info from Search:: namespace
-string pv2uci(const Position& pos, Depth depth, Value alpha, Value beta)
+//	
+//	With "MultiPV", every line gets an 'info multipv N ...', one per text line.
+//	Those not searched yet in the current iteration show the last one's depth and score.
+//	
+//	The lines are formatted into a buffer that is reused by every call, so that
+//	printing the PV never allocates. Each thread has its own buffer, so
+//	the result is valid until the next call on the same thread.
+THREAD_LOCAL char PvBuffer[MAX_MULTI_PV * (128 + 6 * MAX_PLY)];
+
+const char* pv2uci(const Position& pos, Depth depth, Value alpha, Value beta)
 {
-	ostringstream oss;
-	U64 lapse = now() - SearchTime + 1; // plus 1 to avoid division by 0
-	Value val = RootMoveList[0].score;
-
-	oss << "info depth " << depth
-		<< " score " << score2uci(val, alpha, beta)
-		<< " nodes " << pos.nodes
-		<< " nps " << pos.nodes * 1000 / lapse
-		<< " time " << lapse
-		<< " pv";
+	char *p = PvBuffer;
+	U64 lapse = now() - Ctx->searchTime + 1; // plus 1 to avoid division by 0
+	size_t pvSize = min<size_t>(Ctx->multiPV, Ctx->rootMoveList.size());
 
-	// Prints out the PV in UCI long algebraic notation
-	// RootMoveList is null terminated. 
-	for (int i = 0; RootMoveList[0].pv[i] != MOVE_NULL; i++)
-		oss << " " << move2uci(RootMoveList[0].pv[i]);
+	for (size_t n = 0; n < pvSize; n++)
+	{
+		const RootMove& rm = Ctx->rootMoveList[n];
+		bool updated = n <= Ctx->pvIdx;
+		if (!updated && depth == 1)
+			continue;
+		if (p != PvBuffer)
+			*p++ = '\n';
+
+		p += sprintf(p, "info ");
+		if (Ctx->multiPV > 1)
+			p += sprintf(p, "multipv %d ", int(n + 1));
+		p += sprintf(p, "depth %d score ", updated ? depth : depth - 1);
+		// Only the line being searched can fail high or low
+		p = n == Ctx->pvIdx ? score2uci(rm.score, alpha, beta, p)
+			: score2uci(updated ? rm.score : rm.prevScore, -VALUE_INFINITE, VALUE_INFINITE, p);
+		p += sprintf(p, " nodes %llu nps %llu time %llu pv", 
+			(unsigned long long) pos.nodes, 
+			(unsigned long long) (pos.nodes * 1000 / lapse),
+			(unsigned long long) lapse);
+
+		// Prints out the PV in UCI long algebraic notation
+		// The PV is null terminated. 
+		for (int i = 0; rm.pv[i] != MOVE_NULL; i++)
+		{
+			*p++ = ' ';
+			p = move2uci(rm.pv[i], p);
+		}
+	}
+	*p = 0;
 
-	return oss.str();
+	return PvBuffer;
 }
 
 
@@ -89,6 +89,7 @@ namespace UCI
 		operator string() const { return currentVal; }
 
 		Option& operator=(const string& val);  // assign a new value
+		bool accepts(const string& val) const;  // would operator= take it?
 
 		// all the available UCI options (in the global OptMap) sent to the GUI
 		// <true> shows all default values. <false> shows all current values.
@@ -108,18 +109,70 @@ namespace UCI
 	// Init default options
 	void init_options();
 
-	// Main stdin processor (infinite loop)
+	// Main stdin processor (infinite loop). The commands drive an Excalibur::Engine (engine.h)
 	void process();
 
+	// Runs the built-in benchmark. Syntax: bench [depth] [threads] [hash]
+	// Returns the process exit status: 0 on success
+	int bench(istream& args);
+	// The positions searched by bench. Also the corpus of the microbenchmarks
+	extern const char *BenchFens[];
+	extern const int BENCH_FEN_N;
+
+	// Opening book tools. Syntax: book build <pgn> <out> [maxply] [threads]
+	// maxply defaults to 40, threads to all cores.
+	// Returns the process exit status: 0 on success
+	int book(istream& args);
+
+	// Batch analysis of an EPD or FEN file on all cores, one JSON line per position.
+	// Syntax: analyze <epd> [--threads N] --depth D|--nodes N|--movetime T [--out file]
+	// Returns the process exit status: 0 on success
+	int analyze(istream& args);
+	// Self-play match between two sets of the play style options, on all cores.
+	// Syntax: match <openings|startpos> [--games N] [--threads N] --depth D|--nodes N|--movetime T|--tc base+inc
+	//		[--first Name=Value ...] [--second Name=Value ...] [--sprt elo0 elo1] [--pgn file]
+	// Returns the process exit status: 0 on success
+	int match(istream& args);
+
+	// Self-play training data, appended as fixed-size TrainingRecords (packedpos.h).
+	// Syntax: gensfen <out> --depth D|--nodes N [--positions N] [--threads N] [--random N] [--openings file] [--seed S]
+	//         gensfen read <file> [count] [skip]
+	//         gensfen shuffle <in> <out> [--seed S] [--memory MB]
+	// Returns the process exit status: 0 on success
+	int gensfen(istream& args);
+	// Analysis server for many clients on a Unix domain socket, until a client sends 'shutdown'.
+	// Syntax: serve <socket> [--threads N] [--memory MB]
+	// Returns the process exit status: 0 on success
+	int serve(istream& args);
+	// A test suite position: 'bm' lists the best moves, 'am' the moves to avoid
+	struct EpdPosition
+	{
+		string fen, id;
+		vector<Move> bm, am;
+	};
+	// Reads "<board> <turn> <castling> <ep> [opcode operand...;]...". A plain FEN is fine too
+	bool parse_epd(string line, EpdPosition& epd);
+
+	// Hands 'stop' or 'ponderhit' on to the engine of process().
+	// Called by the processor, and early by the InputThread.
+	void stop_search(bool ponderhit);
+
 
 	/*** Printers to and from UCI notation ***/
 	Move uci2move(const Position& pos, string& mvstr);
+	// Parses a SAN move ("Nbd7", "exd8=Q+", "O-O"). MOVE_NULL if it isn't legal
+	Move san2move(const Position& pos, string san);
 	string move2uci(Move mv);
 	string score2uci(Value val, Value alpha = -VALUE_INFINITE, Value beta = VALUE_INFINITE);
+	// Same as above, but write into a caller-supplied buffer without allocating.
+	// Both return the end of the written string.
+	char* move2uci(Move mv, char* buf);
+	char* score2uci(Value val, Value alpha, Value beta, char* buf);
 	// Print the move in SAN (standard algebraic notation) to console or UCI
 	string move2san(Position& pos, Move mv);
 	// Formats and sends the PV to UCI protocol
-	string pv2uci(const Position& pos, Depth depth, Value alpha = -VALUE_INFINITE, Value beta = VALUE_INFINITE);
+	// The returned string is a per thread buffer, valid until the next call.
+	const char* pv2uci(const Position& pos, Depth depth, Value alpha = -VALUE_INFINITE, Value beta = VALUE_INFINITE);
 	// Only for debugging
 	string move2dbg(Move mv);
 }
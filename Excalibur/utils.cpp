@@ -247,6 +247,112 @@ string current_date_time()
 	return buf;
 }
 
+/* Memory-mapped file */
+#ifdef _WIN32
+#include <windows.h>
+void * const MappedFile::INVALID = INVALID_HANDLE_VALUE;
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+MappedFile::MappedFile() : ptr(nullptr), len(0), fd(INVALID)
+#ifdef _WIN32
+	, mapping(nullptr)
+#endif
+{}
+
+void MappedFile::open(string filePath)
+{
+	close();
+#ifdef _WIN32
+	fd = CreateFileA(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	LARGE_INTEGER fileSize;
+	if (fd == INVALID || !GetFileSizeEx(fd, &fileSize))
+		{ close(); throw FileNotFoundException(filePath); }
+	len = size_t(fileSize.QuadPart);
+#else
+	struct stat st;
+	if ((fd = ::open(filePath.c_str(), O_RDONLY)) == INVALID || fstat(fd, &st) != 0)
+		{ close(); throw FileNotFoundException(filePath); }
+	len = size_t(st.st_size);
+#endif
+	if (!map(false))
+		{ close(); throw FileNotFoundException(filePath); }
+}
+
+void MappedFile::create(string filePath, size_t size)
+{
+	close();
+#ifdef _WIN32
+	fd = CreateFileA(filePath.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, 
+		nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+#else
+	fd = ::open(filePath.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+#endif
+	if (fd == INVALID || !resize(size))
+		{ close(); throw FileNotFoundException(filePath); }
+}
+
+bool MappedFile::resize(size_t size)
+{
+	unmap();
+#ifdef _WIN32
+	LARGE_INTEGER pos;
+	pos.QuadPart = size;
+	bool ok = SetFilePointerEx(fd, pos, nullptr, FILE_BEGIN) && SetEndOfFile(fd);
+#else
+	bool ok = ftruncate(fd, off_t(size)) == 0;
+#endif
+	if (ok)
+		len = size;
+	// Remap even on failure, the old size is still there
+	return map(true) && ok;
+}
+
+bool MappedFile::map(bool write)
+{
+	if (len == 0)  // can't map an empty file, but it's a valid one
+		return true;
+#ifdef _WIN32
+	mapping = CreateFileMapping(fd, nullptr, write ? PAGE_READWRITE : PAGE_READONLY, 0, 0, nullptr);
+	if (mapping)
+		ptr = (char *) MapViewOfFile(mapping, write ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, 0);
+#else
+	void *p = mmap(nullptr, len, write ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+	ptr = p == MAP_FAILED ? nullptr : (char *) p;
+#endif
+	return ptr != nullptr;
+}
+
+void MappedFile::unmap()
+{
+#ifdef _WIN32
+	if (ptr)  UnmapViewOfFile(ptr);
+	if (mapping)  CloseHandle(mapping);
+	mapping = nullptr;
+#else
+	if (ptr)  munmap(ptr, len);
+#endif
+	ptr = nullptr;
+}
+
+void MappedFile::close()
+{
+	unmap();
+	if (fd != INVALID)
+#ifdef _WIN32
+		CloseHandle(fd);
+#else
+		::close(fd);
+#endif
+	fd = INVALID;
+	len = 0;
+}
+
 // Display the bitmap. Only for debugging
 Bit dispbit(Bit bitmap)
 {
@@ -230,24 +230,16 @@ inline Score operator/(Score s, int i)
 
 
 /****************** Timing ******************/
-// Platform-specific system time in ms
-#ifdef _WIN32  // Windows
-#  include <sys/timeb.h>
-inline U64 now()
+// Monotonic clock, counted from an arbitrary epoch. Unlike the wall clock 
+// (gettimeofday/_ftime) it never jumps when the system time is adjusted, 
+// so only use it to measure intervals. 
+#include <chrono>
+inline U64 now_us() // in microseconds
 {
-	_timeb t;
-	_ftime(&t);
-	return t.time * 1000LL + t.millitm;
+	return std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
 }
-#else   // Linux
-#  include <sys/time.h>
-inline U64 now()
-{
-	timeval t;
-	gettimeofday(&t, NULL);
-	return t.tv_sec * 1000LL + t.tv_usec / 1000;
-}
-#endif // !_WIN32
+inline U64 now() { return now_us() / 1000; } // in ms
 
 // Cross-platform portable date/time display
 string current_date_time();
@@ -258,11 +250,11 @@ string current_date_time();
 template<typename T>
 void insertion_sort(T* begin, T* end)
 {
-	T tmp, *p, *q;
+	T *p, *q;
 
 	for (p = begin + 1; p < end; ++p)
 	{
-		tmp = *p;
+		T tmp = *p;
 		for (q = p; q != begin && *(q-1) < tmp; --q)
 			*q = *(q-1);
 		*q = tmp;
@@ -312,6 +304,48 @@ struct BinaryIO
 };
 
 
+/*************** Memory-mapped file ***************/
+// The whole file is mapped into the address space. The OS pages it in
+// on demand and writes dirty pages back, so there's no stream buffering.
+class MappedFile
+{
+public:
+	MappedFile();
+	~MappedFile() { close(); }
+
+	// Maps an existing file read-only. Throws FileNotFoundException
+	void open(string filePath);
+	// Creates (or truncates) a file of 'size' bytes, mapped read-write.
+	// Throws FileNotFoundException
+	void create(string filePath, size_t size);
+	// Grows or shrinks a file opened by create(). The data may move.
+	// Returns false if the file can't be resized; the old mapping stays valid
+	bool resize(size_t size);
+	// Unmaps and closes. Pending writes go to the file
+	void close();
+
+	bool is_open() const { return ptr != nullptr || fd != INVALID; }
+	char *data() const { return ptr; }
+	size_t size() const { return len; }
+
+private:
+	bool map(bool writable);
+	void unmap();
+
+	char *ptr;
+	size_t len;
+#ifdef _WIN32
+	void *fd, *mapping; // HANDLEs
+	static void * const INVALID;
+#else
+	int fd;
+	static const int INVALID = -1;
+#endif
+	MappedFile(const MappedFile&); // non-copyable
+	MappedFile& operator=(const MappedFile&);
+};
+
+
 /*************** Prefetch ***************/
 /// prefetch() preloads the given address in L1/L2 cache. This is a non
 /// blocking function and do not stalls the CPU waiting for data to be
@@ -12,7 +12,8 @@ Position pos;
 
 string fenList[TEST_SIZE];  // 204 FEN literals
 
-TEST(Misc, Setup)
+// Runs before any test, whatever order the test cases are registered in
+void EngineEnvironment::SetUp()
 {
 	// initialize
 	Utils::init();
@@ -23,8 +24,8 @@ TEST(Misc, Setup)
 
 	// Read from FEN.epd
 	ifstream fin("FEN.epd");
+	ASSERT_TRUE(fin.is_open()) << "FEN.epd not found. Run from TestDrive/";
 	string fenstr;
-	int index = 0;
 	for (int i = 0; i < TEST_SIZE; i++)
 	{
 		getline(fin, fenstr);
@@ -168,9 +169,61 @@ TEST(Board, FEN)
 	{
 		// The FEN's in the test suite does not have fiftyMove and fullMove components.
 		int fiftyMove = RKiss::rand64() & 0xFF;
-		int fullMove = max(1, RKiss::rand64() & 0xFF); // mustn't be 0
+		int fullMove = max(1, int(RKiss::rand64() & 0xFF)); // mustn't be 0
 		string fen = fenList[i] + " " + int2str(fiftyMove) + " " + int2str(fullMove);
 		Position pp(fen);
 		ASSERT_EQ(fen, pp.to_fen());
 	}
 }
+
+// encode() then decode() must give back the same FEN and the same hash key
+TEST(Board, PackedRoundTrip)
+{
+	vector<string> fens;
+	for (int i = 0; i < TEST_SIZE; i++)
+		fens.push_back(fenList[i] + " 0 1");
+	fens.push_back("rnbqkbnr/ppp1pppp/8/8/3pP3/8/PPPP1PPP/RNBQKBNR b KQkq e3 0 3"); // ep
+	fens.push_back("rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPP1PPP/RNBQKBNR w KQkq f6 0 3");
+	fens.push_back("r3k2r/8/8/8/8/8/8/R3K2R w Kq - 0 1"); // partial castling rights
+	fens.push_back("r3k2r/8/8/8/8/8/8/R3K2R b Qk - 7 20");
+	fens.push_back("4k3/8/8/8/8/8/8/4K2R w K - 255 65535"); // largest counters
+	fens.push_back("4k3/8/8/8/8/8/8/R3K3 b Q - 99 4321");
+
+	PackedPosition packed;
+	Position decoded;
+	for (string& fen : fens)
+	{
+		Position pp(fen);
+		pp.encode(packed);
+		ASSERT_TRUE(decoded.decode(packed)) << fen;
+		ASSERT_EQ(fen, decoded.to_fen());
+		ASSERT_EQ(pp.key(), decoded.key()) << fen;
+		ASSERT_EQ(pp.pawn_key(), decoded.pawn_key()) << fen;
+		ASSERT_EQ(pp.material_key(), decoded.material_key()) << fen;
+	}
+}
+
+// decode() rejects what encode() can never write, and leaves the position alone
+TEST(Board, PackedMalformed)
+{
+	Position start;
+	PackedPosition good, bad;
+	start.encode(good);
+	Position pp(FEN_START);
+
+	bad = good;
+	bad.pieces[3] &= 0xF0; // a piece code with no piece type
+	ASSERT_FALSE(pp.decode(bad));
+	bad = good;
+	bad.pieces[5] |= 0x07;
+	ASSERT_FALSE(pp.decode(bad));
+	bad = good;
+	bad.occupied |= 0x0000FF0000000000ull; // 40 pieces
+	ASSERT_FALSE(pp.decode(bad));
+	bad = good;
+	bad.epSquare = SQ_NULL + 1;
+	ASSERT_FALSE(pp.decode(bad));
+
+	ASSERT_EQ(start.to_fen(), pp.to_fen());
+	ASSERT_EQ(start.key(), pp.key());
+}
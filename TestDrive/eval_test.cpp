@@ -0,0 +1,58 @@
+/* Static exchange evaluation tests */
+#include "tests.h"
+
+// SEE of the move 'from'-'to' in the position
+static Value see_of(string fen, string from, string to)
+{
+	Position pp(fen);
+	Move m;
+	set_from_to(m, str2sq(from), str2sq(to));
+	if (pp.piece_on(str2sq(from)) == PAWN && str2sq(to) == pp.st->epSquare)
+		set_ep(m);
+	return Eval::see(pp, m);
+}
+
+TEST(Eval, SeeSimple)
+{
+	// Undefended pawn
+	ASSERT_EQ(MG_PAWN, see_of("1k1r4/1pp4p/p7/4p3/8/P5P1/1PP4P/2K1R3 w - -", "e1", "e5"));
+	// Queen takes a pawn defended by a pawn
+	ASSERT_EQ(MG_PAWN - MG_QUEEN, see_of("k7/8/4p3/3p4/8/8/8/K2Q4 w - -", "d1", "d5"));
+	// Non-capture onto a square guarded by a pawn
+	ASSERT_EQ(-MG_KNIGHT, see_of("k7/8/3p4/8/8/3N4/8/K7 w - -", "d3", "c5"));
+	// Non-capture onto a safe square
+	ASSERT_EQ(0, see_of("k7/8/8/8/8/3N4/8/K7 w - -", "d3", "e5"));
+	// En-passant
+	ASSERT_EQ(MG_PAWN, see_of("4k3/8/8/3pP3/8/8/8/4K3 w - d6", "e5", "d6"));
+}
+
+TEST(Eval, SeeSequence)
+{
+	// Knight takes a pawn, followed by a long exchange on e5.
+	// Black recaptures with the knight, then bishop and queen stand behind
+	ASSERT_EQ(MG_PAWN - MG_KNIGHT,
+		see_of("1k1r3q/1ppn3p/p4b2/4p3/8/P2N2P1/1PP1R1BP/2K1Q3 w - -", "d3", "e5"));
+	// X-ray: the doubled rooks win the pawn
+	ASSERT_EQ(MG_PAWN, see_of("4r1k1/8/8/4p3/8/8/4R3/4R1K1 w - -", "e2", "e5"));
+	// Same without the second rook: the pawn is poisoned
+	ASSERT_EQ(MG_PAWN - MG_ROOK, see_of("4r1k1/8/8/4p3/8/8/4R3/6K1 w - -", "e2", "e5"));
+	// Bishop takes a rook. The queen won't recapture into the bishop battery
+	ASSERT_EQ(MG_ROOK, see_of("k7/8/5q2/8/3r4/2B5/1B6/K7 w - -", "c3", "d4"));
+	// Black to move, pawn takes a defended knight
+	ASSERT_EQ(MG_KNIGHT - MG_PAWN, see_of("k7/8/8/4p3/3N4/8/8/3RK3 b - -", "e5", "d4"));
+}
+
+TEST(Eval, SeeKing)
+{
+	// The king recaptures an undefended rook
+	ASSERT_EQ(MG_PAWN - MG_ROOK, see_of("8/8/8/3pk3/8/8/3R4/4K3 w - -", "d2", "d5"));
+	// but mustn't step into the second rook
+	ASSERT_EQ(MG_PAWN, see_of("8/8/8/3pk3/8/8/3R4/3RK3 w - -", "d2", "d5"));
+	// see_sign() agrees with see() on the losing exchanges
+	Position pp("k7/8/4p3/3p4/8/8/8/K2Q4 w - -");
+	Move m;
+	set_from_to(m, str2sq("d1"), str2sq("d5"));
+	ASSERT_LT(Eval::see_sign(pp, m), 0);
+	set_from_to(m, str2sq("d1"), str2sq("d4"));
+	ASSERT_GE(Eval::see_sign(pp, m), 0);
+}
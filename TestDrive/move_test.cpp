@@ -82,6 +82,40 @@ TEST(Moves, PseudoPerft)
 	if (showTitle)	 cout << "ALL PASSED" << endl;
 }
 
+// Full legal perft against the published node counts in perft/perft_suite.epd
+// "id" starts an entry, followed by its "epd" FEN and any number of "perft depth count"
+TEST(Moves, PerftSuite)
+{
+	ifstream fin("perft/perft_suite.epd");
+	ASSERT_TRUE(fin.is_open()) << "perft/perft_suite.epd not found. Run from TestDrive/";
+	string str, id, fen;
+	Position ptest;
+	int entries = 0;
+	while (getline(fin, str))
+	{
+		if (str.empty() || str[0] == '#') continue;
+		istringstream iss(str);
+		iss >> str;
+		if (str == "id")
+			iss >> id;
+		else if (str == "epd")
+		{
+			getline(iss >> ws, fen);
+			ptest.parse_fen(fen);
+			entries ++;
+		}
+		else if (str == "perft")
+		{
+			int depth;
+			U64 ans;
+			iss >> depth >> ans;
+			ASSERT_EQ(ans, ptest.perft<false>(depth)) 
+				<< id << " at depth " << depth << "\n" << fen;
+		}
+	}
+	ASSERT_GT(entries, 0);
+}
+
 TEST(Moves, Checks)
 {
 	bool verbose = false;
@@ -148,9 +182,9 @@ bool is_piece_list_invariant(Position& pos)
 			index[c][pt] = 0;
 	for (int i = 0; i < SQ_N; i++)
 	{
-		Color c = pos.boardColor[i];
+		Color c = pos.color_on(i);
 		if (c == COLOR_NULL) continue;
-		PieceType pt = pos.boardPiece[i];
+		PieceType pt = pos.piece_on(i);
 		pieceListStd[c][pt][index[c][pt]++] = i;
 	}
 	std::set<Square> setStd, setActual;
@@ -298,6 +332,36 @@ TEST(Moves, RepetitionDraw)
 	Rep3Assert(1); Rep2Assert(1);
 }
 
+// A copy, like the root position of a search, still sees the repetitions of
+// the states played before it was made
+TEST(Moves, RepetitionAfterCopy)
+{
+	StateStack sb; StateInfo *sbuf = sb;
+	Position orig("8/8/2p2K1B/1pq5/3k2P1/5P1P/1r6/8 w - - 10 23");
+	const Square cycle[4][2] = { {47, 29}, {9, 14}, {29, 47}, {14, 9} };
+	Move mv;
+	for (int i = 0; i < 4; i++)
+	{
+		set_from_to(mv, cycle[i][0], cycle[i][1]);
+		orig.make_move(mv, *sbuf++);
+	}
+	Position pp(orig);
+	ASSERT_TRUE(pp.is_draw<false>());
+	ASSERT_FALSE(pp.is_draw<true>());
+	for (int i = 0; i < 4; i++)
+	{
+		set_from_to(mv, cycle[i][0], cycle[i][1]);
+		Rep3Assert(i == 3); Rep2Assert(1);
+	}
+	// An irreversible move ends the window: nothing before it can repeat
+	Position fresh("8/8/2p2K1B/1pq5/3k2P1/5P1P/1r6/8 w - - 10 23");
+	set_from_to(mv, 30, 38);  // g4g5
+	fresh.make_move(mv, *sbuf++);
+	Position cp(fresh);
+	ASSERT_EQ(0, cp.st->cntFiftyMove);
+	ASSERT_FALSE(cp.is_draw<false>());
+}
+
 // Test lsb, msb and bit_count
 TEST(Misc, BitScan)
 {
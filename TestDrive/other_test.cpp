@@ -14,9 +14,9 @@ TEST(Misc, Timer)
 	const long M = 60000; // minutes
 	const long S = 1000; // sec
 
-	Limit.time[W] = 90 * M;
-	Limit.increment[W] = 0 * S;
-	Limit.movesToGo = 40;
+	Ctx->limit.time[W] = 90 * M;
+	Ctx->limit.increment[W] = 0 * S;
+	Ctx->limit.movesToGo = 40;
 
 	int p = 40;
 	for (int i = 0; i < p; i++)
@@ -28,6 +28,244 @@ TEST(Misc, Timer)
 	}
 }
 
+// Create, grow, shrink and read back a memory-mapped file
+TEST(Misc, MappedFile)
+{
+	const string path = "mapped_file_test.bin";
+	MappedFile mf;
+	mf.create(path, 4096);
+	ASSERT_EQ(4096, mf.size());
+	for (int i = 0; i < 4096; i++)
+		mf.data()[i] = char(i);
+	ASSERT_TRUE(mf.resize(1 << 20));
+	ASSERT_EQ(char(4095), mf.data()[4095]);
+	mf.data()[(1 << 20) - 1] = 42;
+	ASSERT_TRUE(mf.resize(5000));
+	mf.close();
+	ASSERT_FALSE(mf.is_open());
+
+	MappedFile rd;
+	rd.open(path);
+	ASSERT_EQ(5000, rd.size());
+	for (int i = 0; i < 4096; i++)
+		ASSERT_EQ(char(i), rd.data()[i]);
+	rd.close();
+	remove(path.c_str());
+	ASSERT_THROW(rd.open(path), FileNotFoundException);
+}
+
+typedef pair<U64, pair<Move, ushort>> BookEntry;  // key, move, count
+
+// Writes an Excalibur book: the Polyglot keys, then the sorted entries
+static void write_book(string path, const vector<U64>& keys, vector<BookEntry> entries)
+{
+	sort(entries.begin(), entries.end(), [](const BookEntry& a, const BookEntry& b)
+		{ return a.first < b.first; });
+	ofstream fout(path, ofstream::binary);
+	for (U64 k : keys)
+		BinaryIO<>::put(fout, k);
+	BinaryIO<>::put(fout, 0ULL);
+	for (auto& e : entries)
+	{
+		BinaryIO<>::put(fout, e.first);
+		BinaryIO<>::put(fout, ushort(e.second.first));
+		BinaryIO<>::put(fout, e.second.second);
+	}
+}
+
+// Binary search in a memory-mapped book
+TEST(Misc, OpeningBook)
+{
+	const string path = "opening_book_test.book";
+	vector<U64> keys;
+	for (int i = 0; i < 781; i++)
+		keys.push_back(RKiss::rand64() | 1);  // 0 is the sentinel
+	write_book(path, keys, vector<BookEntry>());
+	Polyglot::load(path);
+	ASSERT_TRUE(Polyglot::ValidBook);
+
+	Position start("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
+	Position castle("r3k2r/8/8/8/8/8/8/R3K2R w KQkq - 0 1");
+	U64 startKey = Polyglot::book_key(start), castleKey = Polyglot::book_key(castle);
+	Move e4, d4, nf3, e1h1;
+	set_from_to(e4, SQ_E2, SQ_E4);
+	set_from_to(d4, SQ_D2, SQ_D4);
+	set_from_to(nf3, SQ_G1, SQ_F3);
+	set_from_to(e1h1, SQ_E1, SQ_H1);
+
+	// Neighbouring keys around the start position check the search bounds
+	vector<BookEntry> entries;
+	entries.push_back(BookEntry(startKey - 1, make_pair(nf3, 100)));
+	entries.push_back(BookEntry(startKey, make_pair(e4, 10)));
+	entries.push_back(BookEntry(startKey, make_pair(d4, 20)));
+	entries.push_back(BookEntry(startKey, make_pair(nf3, 5)));
+	entries.push_back(BookEntry(startKey + 1, make_pair(e4, 100)));
+	entries.push_back(BookEntry(castleKey, make_pair(e1h1, 1)));
+	write_book(path, keys, entries);
+	Polyglot::load(path);
+	ASSERT_TRUE(Polyglot::ValidBook);
+
+	Polyglot::AllowBookVariation = false;
+	ASSERT_EQ(d4, Polyglot::probe(start));
+	// Polyglot castling is "king takes rook"
+	ASSERT_EQ(CastleMoves[W][CASTLE_OO], Polyglot::probe(castle));
+	ASSERT_EQ(MOVE_NULL, Polyglot::probe(Position("4k3/8/8/8/8/8/8/4K3 w - - 0 1")));
+
+	Polyglot::AllowBookVariation = true;
+	for (int i = 0; i < 20; i++)
+	{
+		Move mv = Polyglot::probe(start);
+		ASSERT_TRUE(mv == e4 || mv == d4 || mv == nf3);
+	}
+
+	Polyglot::load("no_such_file.book");
+	ASSERT_FALSE(Polyglot::ValidBook);
+	ASSERT_EQ(MOVE_NULL, Polyglot::probe(start));
+	remove(path.c_str());
+}
+
+// A standard big-endian Polyglot book, probed in place
+TEST(Misc, PolyglotBook)
+{
+	const string path = "polyglot_test.bin";
+	// Without a key file we get the standard keys. Hashes from the Polyglot specification
+	ASSERT_FALSE(Polyglot::load_keys("no_such_polyglot.key"));
+	ASSERT_TRUE(Polyglot::KeysLoaded);
+	ASSERT_EQ(0x463B96181691FC9Cull, Polyglot::book_key(Position()));
+	ASSERT_EQ(0x823C9B50FD114196ull, Polyglot::book_key(Position( // e2e4
+		"rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq e3 0 1")));
+	ASSERT_EQ(0x0756B94461C50FB0ull, Polyglot::book_key(Position( // e2e4 d7d5
+		"rnbqkbnr/ppp1pppp/8/3p4/4P3/8/PPPP1PPP/RNBQKBNR w KQkq d6 0 2")));
+	ASSERT_EQ(0x22A48B5A8E47FF78ull, Polyglot::book_key(Position( // e2e4 d7d5 e4e5 f7f5
+		"rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPP1PPP/RNBQKBNR w KQkq f6 0 3")));
+	ASSERT_EQ(0x00FDD303C946BDD9ull, Polyglot::book_key(Position( // ... e1e2 e8f7
+		"rnbq1bnr/ppp1pkpp/8/3pPp2/8/8/PPPPKPPP/RNBQ1BNR w - - 0 4")));
+	ASSERT_EQ(0x5C3F9B829B279560ull, Polyglot::book_key(Position( // a2a4 b7b5 h2h4 b5b4 c2c4 b4c3 a1a2
+		"rnbqkbnr/p1pppppp/8/8/P6P/R1p5/1P1PPPP1/1NBQKBNR b Kkq - 0 4")));
+
+	Position promo("4k3/1P6/8/8/8/8/8/R3K3 w Q - 0 1");
+	U64 key = Polyglot::book_key(promo);
+	// Polyglot moves: promotion in bits 12-14, castling as "king takes rook"
+	ushort b8q = SQ_B8 | SQ_B7 << 6 | 4 << 12, e1a1 = SQ_A1 | SQ_E1 << 6;
+	{
+		ofstream fout(path, ofstream::binary);
+		U64 keys[] = { key - 1, key, key, key + 1 };
+		ushort moves[] = { e1a1, b8q, e1a1, b8q }, counts[] = { 9, 2, 1, 9 };
+		for (int i = 0; i < 4; i++)
+		{
+			BinaryIO<BigEndian>::put(fout, keys[i]);
+			BinaryIO<BigEndian>::put(fout, moves[i]);
+			BinaryIO<BigEndian>::put(fout, counts[i]);
+			BinaryIO<BigEndian>::put(fout, uint(0));
+		}
+	}
+	Polyglot::load(path);
+	ASSERT_TRUE(Polyglot::ValidBook);
+
+	Polyglot::AllowBookVariation = false;
+	Move mv;
+	set_from_to(mv, SQ_B7, SQ_B8); set_promo(mv, QUEEN);
+	ASSERT_EQ(mv, Polyglot::probe(promo));
+	Polyglot::AllowBookVariation = true;
+	for (int i = 0; i < 20; i++)
+	{
+		Move bm = Polyglot::probe(promo);
+		ASSERT_TRUE(bm == mv || bm == CastleMoves[W][CASTLE_OOO]);
+	}
+	remove(path.c_str());
+}
+
+// Builds a book from a small PGN, with 1 and with several threads
+TEST(Misc, PolyglotBuild)
+{
+	const string pgnPath = "build_test.pgn", path1 = "build_test1.bin", pathN = "build_test4.bin";
+	const int Repeat = 100;  // enough games for several batches
+	{
+		ofstream fout(pgnPath);
+		for (int i = 0; i < Repeat; i++)
+			fout << "[Event \"test\"]\n[Result \"1-0\"]\n\n"
+				"1. e4 {a comment (with parentheses)} e5 (1... c5 2. Nf3 (2. c3 {nested})) 2. Nf3\n"
+				"Nc6 ; the rest of the line is a comment 3. d4\n"
+				"3. Bb5 $1 a6 1-0\n\n"
+				"[Result \"1/2-1/2\"]\n1. e4 e5 2. Nf3 Nf6 1/2-1/2\n\n"
+				"[Result \"1/2-1/2\"]\n1.d4 d5 1/2-1/2\n\n"
+				"[Result \"*\"]\n1. c4 e5 *\n\n"
+				"[Result \"0-1\"]\n[FEN \"r3k2r/8/8/8/8/8/8/R3K2R w KQkq - 0 1\"]\n1. O-O O-O-O 0-1\n\n"
+				"[Result \"1-0\"]\n[FEN \"4k3/1P6/8/8/8/8/8/4K3 w - - 0 1\"]\n1. b8=Q+ Kd7 1-0\n\n";
+	}
+	Polyglot::build(pgnPath, path1, 40, 1);
+	Polyglot::build(pgnPath, pathN, 40, 4);
+
+	// The same file whatever the number of threads
+	ifstream fin1(path1, ifstream::binary), finN(pathN, ifstream::binary);
+	string book1((istreambuf_iterator<char>(fin1)), istreambuf_iterator<char>()),
+		bookN((istreambuf_iterator<char>(finN)), istreambuf_iterator<char>());
+	fin1.close(); finN.close();
+	ASSERT_EQ(book1, bookN);
+
+	// Position, Polyglot move and weight: 2 per won game, 1 per draw, nothing for
+	// a loss. Variations, comments and the unfinished game leave no entry
+	Position pos;
+	StateInfo states[16], *sbuf = states;
+	auto play = [&](string san) { Move mv = UCI::san2move(pos, san); pos.make_move(mv, *sbuf++); };
+	map<pair<U64, ushort>, int> expected;
+	auto expect = [&](int from, int to, int promo, int weight)
+		{ expected[make_pair(Polyglot::book_key(pos), ushort(to | from << 6 | promo << 12))] = weight * Repeat; };
+	expect(SQ_E2, SQ_E4, 0, 3); expect(SQ_D2, SQ_D4, 0, 1);
+	play("e4"); expect(SQ_E7, SQ_E5, 0, 1);
+	play("e5"); expect(SQ_G1, SQ_F3, 0, 3);
+	play("Nf3"); expect(SQ_G8, SQ_F6, 0, 1);
+	play("Nc6"); expect(SQ_F1, SQ_B5, 0, 2);
+	pos.parse_fen(FEN_START); play("d4"); expect(SQ_D7, SQ_D5, 0, 1);
+	pos.parse_fen("r3k2r/8/8/8/8/8/8/R3K2R w KQkq - 0 1");
+	play("O-O"); expect(SQ_E8, SQ_A8, 0, 2);
+	pos.parse_fen("4k3/1P6/8/8/8/8/8/4K3 w - - 0 1"); expect(SQ_B7, SQ_B8, 4, 2);
+
+	ifstream fin(path1, ifstream::binary);
+	U64 key, lastKey = 0;
+	ushort move, count;
+	uint learn;
+	map<pair<U64, ushort>, int> found;
+	while (BinaryIO<BigEndian>::get(fin, key))
+	{
+		BinaryIO<BigEndian>::get(fin, move);
+		BinaryIO<BigEndian>::get(fin, count);
+		BinaryIO<BigEndian>::get(fin, learn);
+		ASSERT_LE(lastKey, key);  // sorted
+		lastKey = key;
+		found[make_pair(key, move)] = count;
+	}
+	fin.close();
+	ASSERT_EQ(expected, found);
+
+	// And probe() reads it back
+	Polyglot::load(path1);
+	ASSERT_TRUE(Polyglot::ValidBook);
+	Polyglot::AllowBookVariation = false;
+	Move mv;
+	pos.parse_fen(FEN_START);
+	set_from_to(mv, SQ_E2, SQ_E4);
+	ASSERT_EQ(mv, Polyglot::probe(pos));
+	play("c4");
+	ASSERT_EQ(MOVE_NULL, Polyglot::probe(pos));
+	pos.parse_fen(FEN_START);
+	play("e4"); play("c5");
+	ASSERT_EQ(MOVE_NULL, Polyglot::probe(pos));
+	pos.parse_fen("r3k2r/8/8/8/8/8/8/R3K2R w KQkq - 0 1");
+	ASSERT_EQ(MOVE_NULL, Polyglot::probe(pos));
+	play("O-O");
+	ASSERT_EQ(CastleMoves[B][CASTLE_OOO], Polyglot::probe(pos));
+	pos.parse_fen("4k3/1P6/8/8/8/8/8/4K3 w - - 0 1");
+	set_from_to(mv, SQ_B7, SQ_B8); set_promo(mv, QUEEN);
+	ASSERT_EQ(mv, Polyglot::probe(pos));
+	Polyglot::AllowBookVariation = true;
+
+	Polyglot::load("no_such_file.book");
+	remove(pgnPath.c_str());
+	remove(path1.c_str());
+	remove(pathN.c_str());
+}
+
 #define SAN(from, to, str) \
 	set_from_to(mv, from, to); \
 	ASSERT_EQ(str, move2san(pos, mv))
@@ -61,6 +299,59 @@ TEST(UCI, San)
 	SAN(50, 34, "c5");
 }
 
+// san2move() reads back every legal move of the test positions,
+// and tolerates the usual PGN variants
+TEST(UCI, San2Move)
+{
+	for (int i = 0; i < TEST_SIZE; i++)
+	{
+		Position pp(fenList[i]);
+		MoveBuffer mbuf;
+		ScoredMove *it, *end = pp.gen_moves<LEGAL>(mbuf);
+		for (it = mbuf; it != end; ++it)
+			ASSERT_EQ(it->move, san2move(pp, move2san(pp, it->move))) << fenList[i];
+	}
+	Position pp("r3k3/1P6/8/8/8/8/8/R3K2R w KQq - 0 1");
+	Move mv;
+	set_from_to(mv, SQ_B7, SQ_A8); set_promo(mv, QUEEN);
+	ASSERT_EQ(mv, san2move(pp, "bxa8Q!?"));
+	ASSERT_EQ(mv, san2move(pp, "bxa8=Q+"));
+	ASSERT_EQ(CastleMoves[W][CASTLE_OOO], san2move(pp, "0-0-0"));
+	ASSERT_EQ(MOVE_NULL, san2move(pp, "Nf3"));
+	ASSERT_EQ(MOVE_NULL, san2move(pp, "b8"));  // promotion missing
+	pp.parse_fen("4k3/8/8/8/8/8/4K3/R6R w - - 0 1");
+	ASSERT_EQ(MOVE_NULL, san2move(pp, "Rd1"));  // either rook
+	set_from_to(mv, SQ_H1, SQ_D1);
+	ASSERT_EQ(mv, san2move(pp, "Rhd1"));
+}
+
+// EPD operations, counters and the sanity check of the position
+TEST(UCI, Epd)
+{
+	EpdPosition epd;
+	ASSERT_TRUE(parse_epd("r1bqkbnr/pppp1ppp/2n5/4p3/4P3/5N2/PPPP1PPP/RNBQKB1R w KQkq - "
+		"bm Bb5 Bc4; am Ng5; id \"Italian; or Spanish\"; hmvc 2; fmvn 3;", epd));
+	ASSERT_EQ("r1bqkbnr/pppp1ppp/2n5/4p3/4P3/5N2/PPPP1PPP/RNBQKB1R w KQkq - 2 3", epd.fen);
+	ASSERT_EQ("Italian; or Spanish", epd.id);
+	ASSERT_EQ(2, epd.bm.size());
+	Move mv;
+	set_from_to(mv, SQ_F1, SQ_B5);
+	ASSERT_EQ(mv, epd.bm[0]);
+	set_from_to(mv, SQ_F3, SQ_G5);
+	ASSERT_EQ(1, epd.am.size());
+	ASSERT_EQ(mv, epd.am[0]);
+
+	// A plain FEN keeps its counters
+	ASSERT_TRUE(parse_epd("8/8/8/8/8/8/8/K6k b - - 12 40", epd));
+	ASSERT_EQ("8/8/8/8/8/8/8/K6k b - - 12 40", epd.fen);
+	ASSERT_TRUE(epd.bm.empty() && epd.am.empty() && epd.id.empty());
+
+	ASSERT_FALSE(parse_epd("8/8/8/8/8/8/8/K6k", epd));  // fields missing
+	ASSERT_FALSE(parse_epd("8/8/8/8/8/8/8/K7k w - -", epd));  // 9 files
+	ASSERT_FALSE(parse_epd("8/8/8/8/8/8/8/K6K w - -", epd));  // no black king
+	ASSERT_FALSE(parse_epd("8/8/8/8/8/8/8/K6k w - - bm Qh8;", epd));  // illegal move
+}
+
 TEST(UCI, Notation)
 {
 	Position pp("r4bnr/pPpPPpPp/4P3/8/4P2k/8/P6P/R3K2R w KQ - 0 1");
@@ -86,5 +377,6 @@ TEST(UCI, Notation)
 int main(int argc, char **argv) 
 {
 	::testing::InitGoogleTest(&argc, argv);
+	::testing::AddGlobalTestEnvironment(new EngineEnvironment);
 	return RUN_ALL_TESTS();
 }
\ No newline at end of file
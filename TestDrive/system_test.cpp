@@ -1,5 +1,6 @@
-#include "Common.h"
+#include "tests.h"
 
+#ifdef _WIN32
 int processor_num()
 {
 	SYSTEM_INFO sysinfo;
@@ -22,6 +23,22 @@ string processor_info()
 		info = "Architecture: Unknown architecture.";
 	return info;
 }
+#else
+#include <sys/utsname.h>
+
+int processor_num()
+{
+	return std::thread::hardware_concurrency();
+}
+
+string processor_info()
+{
+	utsname name;
+	if (uname(&name) != 0)
+		return "Architecture: Unknown architecture.";
+	return string("Architecture: ") + name.machine + " (" + name.sysname + " " + name.release + ")";
+}
+#endif // _WIN32
 
 TEST(System, Info)
 {
@@ -1,6 +1,5 @@
 #ifndef __alltest_h__
 #define __alltest_h__
-#define pause system("pause")
 
 #include <fstream>
 #include <sstream>
@@ -8,7 +7,16 @@
 #include <cstdio>
 #include <iomanip>
 #include <bitset>
+#include <thread>
+#ifdef _WIN32
 #include <Windows.h>
+#define pause system("pause")
+#else
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
 #include <set>
 #include "gtest/gtest.h"
 using namespace std; 
@@ -20,6 +28,9 @@ using namespace std;
 #include "uci.h"
 #include "timer.h"
 #include "eval.h"
+#include "openbook.h"
+#include "packedpos.h"
+#include "engine.h"
 using namespace Board;
 using namespace Moves;
 using namespace Search;
@@ -29,6 +40,13 @@ const int TEST_SIZE = 204;
 extern string fenList[TEST_SIZE];
 extern Position pos;
 
+// Initializes the engine tables and reads FEN.epd into fenList
+class EngineEnvironment : public ::testing::Environment
+{
+public:
+	void SetUp();
+};
+
 /* test-oriented functions */
 inline void blank()
 { cout << "" << endl; }
@@ -5,7 +5,7 @@ using namespace Search;
 class GoodThread : public Thread
 {
 public:
-	GoodThread() : Thread() { Signal.stop = false; };
+	GoodThread() : Thread() { Ctx->signal.stop = false; };
 	void execute();
 };
 
@@ -19,7 +19,7 @@ void GoodThread::execute()
 		if (tim1  - tim0 == 200)
 		{
 			if (count ==  3)
-				Signal.stop = true;
+				Ctx->signal.stop = true;
 			tim0 = tim1;
 			cout << "good" << endl;
 			count ++;
@@ -38,7 +38,7 @@ void BadThread::execute()
 	auto tim0 = now();
 	while (true)
 	{
-		if (Signal.stop)
+		if (Ctx->signal.stop)
 		{
 			cout << "Termination Signal" << endl;
 			break;
@@ -62,4 +62,499 @@ TEST(Thread, Signal)
 	del_thread(th_good);
 	del_thread(th_bad);
 }
-*/
\ No newline at end of file
+*/
+
+/* Search smoke tests on an Excalibur::Engine, driven the way the UCI processor
+ * drives its own. stdin is left alone, like the command line mode */
+class SearchThread : public ::testing::Test
+{
+protected:
+	static void SetUpTestCase()
+	{
+		ThreadPool::init(false);
+		engine = new Excalibur::Engine();
+	}
+	static void TearDownTestCase()
+	{
+		delete engine;
+		ThreadPool::terminate();
+	}
+
+	// Starts a search of 'fen' and 'moves' on the engine and returns at once
+	static future<Excalibur::SearchResult> go(const string& fen, const vector<string>& moves,
+		const Excalibur::Limits& limits, Excalibur::InfoCallback callback = Excalibur::InfoCallback())
+	{
+		EXPECT_TRUE(engine->set_position(fen, moves)) << fen;
+		return engine->analyze(limits, callback);
+	}
+
+	// The best move is legal in the root position
+	static bool best_is_legal(const Position& pp, const Excalibur::SearchResult& res)
+	{
+		string best = res.bestMove;
+		return uci2move(pp, best) != MOVE_NULL;
+	}
+
+	// Orders the scores of a MultiPV search: the shortest mate is the best
+	static int rank(const Excalibur::Score& score)
+	{
+		return !score.isMate ? score.value
+			: score.value > 0 ? 100000 - score.value : -100000 - score.value;
+	}
+
+	static Excalibur::Engine *engine;
+};
+Excalibur::Engine *SearchThread::engine;
+
+TEST_F(SearchThread, Depth)
+{
+	Excalibur::Limits limits;
+	limits.depth = 6;
+	for (int i = 0; i < BENCH_FEN_N; i += 7)
+	{
+		Excalibur::SearchResult res = go(BenchFens[i], {}, limits).get();
+		ASSERT_TRUE(best_is_legal(Position(BenchFens[i]), res)) << BenchFens[i];
+		ASSERT_GT(res.nodes, 0) << BenchFens[i];
+	}
+}
+
+// An infinite search must return promptly on 'stop'
+TEST_F(SearchThread, Stop)
+{
+	auto future = go(BenchFens[1], {}, Excalibur::Limits());
+	this_thread::sleep_for(chrono::milliseconds(300));
+	U64 start = now();
+	engine->stop();
+	Excalibur::SearchResult res = future.get();
+	ASSERT_LT(now() - start, 1000) << "the engine ignored the stop signal";
+	ASSERT_TRUE(best_is_legal(Position(BenchFens[1]), res));
+}
+
+// A ponder search waits for 'ponderhit' even when it's done. After 'ponderhit'
+// the clock runs as in a normal search
+TEST_F(SearchThread, Ponderhit)
+{
+	Excalibur::Limits limits;
+	limits.depth = 4;
+	limits.ponder = true;
+	auto future = go(BenchFens[0], {}, limits);
+	ASSERT_EQ(future_status::timeout, future.wait_for(chrono::milliseconds(500)));
+	engine->ponderhit();
+	ASSERT_EQ(4, future.get().depth);
+
+	limits.depth = 0;
+	limits.time[W] = limits.time[B] = 2000;
+	future = go(BenchFens[0], {}, limits);
+	this_thread::sleep_for(chrono::milliseconds(300));
+	ASSERT_EQ(future_status::timeout, future.wait_for(chrono::milliseconds(0))) << "the clock ran while pondering";
+	engine->ponderhit();
+	ASSERT_EQ(future_status::ready, future.wait_for(chrono::milliseconds(2000)));
+	ASSERT_TRUE(best_is_legal(Position(BenchFens[0]), future.get()));
+}
+
+// MultiPV: the best lines come first, each with its own move and a score
+TEST_F(SearchThread, MultiPV)
+{
+	Excalibur::Limits limits;
+	limits.depth = 7;
+	limits.multiPV = 3;
+	for (int i = 0; i < BENCH_FEN_N; i += 9)
+	{
+		vector<Excalibur::InfoUpdate> lines;  // of the last iteration
+		Excalibur::SearchResult res = go(BenchFens[i], {}, limits, [&lines](const Excalibur::InfoUpdate& info)
+		{
+			if (info.multiPV == 1)
+				lines.clear();
+			lines.push_back(info);
+		}).get();
+		Position pp(BenchFens[i]);
+		ASSERT_TRUE(best_is_legal(pp, res)) << BenchFens[i];
+		ASSERT_EQ(size_t(min(3, pp.count_legal())), lines.size()) << BenchFens[i];
+		ASSERT_EQ(res.bestMove, lines[0].pv[0]) << BenchFens[i];
+		for (size_t n = 1; n < lines.size(); n++)
+		{
+			ASSERT_EQ(int(n + 1), lines[n].multiPV) << BenchFens[i];
+			ASSERT_GE(rank(lines[n - 1].score), rank(lines[n].score)) << BenchFens[i];
+			ASSERT_NE(lines[n - 1].pv[0], lines[n].pv[0]) << BenchFens[i];
+		}
+	}
+}
+
+// "Warm Requery": searching a subset of the last root's moves resumes that search
+// at the depth it reached, instead of iterating up from depth 1 again
+TEST_F(SearchThread, WarmRequery)
+{
+	engine->set_option("Warm Requery", "true");
+	Position pp(BenchFens[1]);
+	MoveBuffer mbuf;
+	pp.gen_moves<LEGAL>(mbuf);
+	vector<string> both;
+	both.push_back(move2uci(mbuf[0].move));
+	both.push_back(move2uci(mbuf[1].move));
+	int iterations = 0, depths[2];
+	Excalibur::SearchResult res;
+	Excalibur::Limits limits;
+	limits.depth = 8;
+	for (int q = 0; q < 2; q++)
+	{
+		iterations = 0;
+		limits.searchMoves = q == 0 ? both : vector<string>(1, both[1]);
+		res = go(BenchFens[1], {}, limits, [&iterations](const Excalibur::InfoUpdate&) { iterations ++; }).get();
+		depths[q] = res.depth;
+	}
+	engine->set_option("Warm Requery", "false");
+	ASSERT_EQ(8, depths[0]);
+	ASSERT_EQ(8, depths[1]);
+	ASSERT_EQ(1, iterations);
+	ASSERT_EQ(both[1], res.bestMove);
+	ASSERT_FALSE(res.pv.empty());
+}
+
+// Speculative pondering: helpers ponder on the likely replies other than the predicted
+// one. A search of the reply actually played resumes the work of its helper
+TEST_F(SearchThread, SpeculativePonder)
+{
+	Position parent(BenchFens[0]);
+	MoveBuffer mbuf;
+	parent.gen_moves<LEGAL>(mbuf);
+	Move predicted = mbuf[0].move;
+	engine->set_option("Speculative Ponder", "2");
+	Excalibur::Limits limits;
+	limits.ponder = true;
+	auto future = go(BenchFens[0], { move2uci(predicted) }, limits);
+	this_thread::sleep_for(chrono::milliseconds(500));
+	engine->stop();  // a ponder miss
+	future.get();
+	engine->set_option("Speculative Ponder", "0");
+	Ponder::finish();
+	vector<Move> replies = Ponder::replies();
+	ASSERT_EQ(2u, replies.size());
+	ASSERT_EQ(replies.end(), std::find(replies.begin(), replies.end(), predicted));
+
+	Position pp(parent);
+	StateInfo st;
+	pp.make_move(replies[1], st);
+	int iterations = 0;
+	limits = Excalibur::Limits();
+	limits.depth = 6;
+	Excalibur::SearchResult res = go(BenchFens[0], { move2uci(replies[1]) }, limits,
+		[&iterations](const Excalibur::InfoUpdate&) { iterations ++; }).get();
+	ASSERT_EQ(6, res.depth);
+	ASSERT_EQ(1, iterations) << "the search didn't resume the helper's";
+	ASSERT_TRUE(best_is_legal(pp, res));
+}
+
+// Move generation on other threads while the engine searches.
+// Nothing in Position may be shared between threads
+TEST_F(SearchThread, ConcurrentPerft)
+{
+	const int Workers = 4;
+	U64 expected[Workers], actual[Workers];
+	for (int w = 0; w < Workers; w++)
+		expected[w] = Position(BenchFens[w]).perft<false>(4);
+
+	auto future = go(BenchFens[0], {}, Excalibur::Limits());
+
+	vector<std::thread> workers;
+	for (int w = 0; w < Workers; w++)
+		workers.push_back(std::thread([w, &actual]()
+			{ actual[w] = Position(BenchFens[w]).perft<false>(4); }));
+	for (auto& th : workers)
+		th.join();
+
+	engine->stop();
+	ASSERT_TRUE(best_is_legal(Position(BenchFens[0]), future.get()));
+	for (int w = 0; w < Workers; w++)
+		ASSERT_EQ(expected[w], actual[w]) << BenchFens[w];
+}
+
+// 'analyze' workers search in their own contexts, side by side with the engine
+TEST_F(SearchThread, Analyze)
+{
+	const string epdPath = "analyze_test.epd", outPath = "analyze_test.jsonl";
+	{
+		ofstream fout(epdPath);
+		fout << "6k1/5ppp/8/8/8/8/8/R5K1 w - - bm Ra8; id \"back rank\";\n"
+			<< "\n# comments and blank lines are skipped\n"
+			<< "6K1/8/6k1/8/8/8/8/r7 b - - 0 1\n"
+			<< "k7/8/1K6/8/8/8/8/7R w - - am Rh8;\n"
+			<< "not a position\n";
+	}
+	auto future = go(BenchFens[0], {}, Excalibur::Limits());
+
+	istringstream args(epdPath + " --threads 2 --depth 4 --out " + outPath);
+	ASSERT_EQ(0, UCI::analyze(args));
+	engine->stop();
+	ASSERT_TRUE(best_is_legal(Position(BenchFens[0]), future.get()));
+
+	ifstream fin(outPath);
+	vector<string> lines;
+	string line;
+	while (getline(fin, line))
+		lines.push_back(line);
+	ASSERT_EQ(4, lines.size());
+	ASSERT_EQ(0, lines[0].find("{\"line\":1,\"id\":\"back rank\",\"bestmove\":\"a1a8\",\"score\":{\"mate\":1}"));
+	ASSERT_NE(string::npos, lines[0].find("\"solved\":true"));
+	ASSERT_EQ(0, lines[1].find("{\"line\":4,\"bestmove\":\"a1a8\""));
+	ASSERT_EQ(string::npos, lines[1].find("solved"));
+	ASSERT_EQ(0, lines[2].find("{\"line\":5,\"bestmove\":\"h1h8\""));
+	ASSERT_NE(string::npos, lines[2].find("\"solved\":false"));
+	ASSERT_EQ("{\"line\":6,\"error\":\"bad EPD\"}", lines[3]);
+	fin.close();
+	remove(epdPath.c_str());
+	remove(outPath.c_str());
+}
+
+// 'match' plays each opening with both colors. Every side has its own style and TT
+TEST_F(SearchThread, Match)
+{
+	const string openPath = "match_test.epd", pgnPath = "match_test.pgn";
+	{
+		ofstream fout(openPath);
+		fout << "6k1/5ppp/8/8/8/8/8/R5K1 w - -\n";
+	}
+	Score mobility = MainContext.evalWeights.mobility;
+	auto future = go(BenchFens[0], {}, Excalibur::Limits());
+
+	istringstream args(openPath + " --threads 2 --depth 3 --first Mobility=150"
+		" --second King Safety=50 Contempt Factor=-20 --pgn " + pgnPath);
+	ASSERT_EQ(0, UCI::match(args));
+	engine->stop();
+	ASSERT_TRUE(best_is_legal(Position(BenchFens[0]), future.get()));
+	ASSERT_EQ(mobility, MainContext.evalWeights.mobility);
+
+	ifstream fin(pgnPath);
+	string pgn((istreambuf_iterator<char>(fin)), istreambuf_iterator<char>());
+	ASSERT_NE(string::npos, pgn.find("[White \"first\"]"));
+	ASSERT_NE(string::npos, pgn.find("[White \"second\"]"));
+	size_t mate = pgn.find("1. Ra8# {checkmate} 1-0");  // won by either engine
+	ASSERT_NE(string::npos, mate);
+	ASSERT_NE(string::npos, pgn.find("1. Ra8# {checkmate} 1-0", mate + 1));
+	fin.close();
+	remove(openPath.c_str());
+	remove(pgnPath.c_str());
+
+	istringstream badArgs("startpos --depth 3 --second King Safety=500");
+	ASSERT_EQ(1, UCI::match(badArgs));
+}
+
+// 'gensfen' records are labelled from the side to move, and the shuffle keeps them all
+TEST_F(SearchThread, Gensfen)
+{
+	const string outPath = "gensfen_test.bin", shufPath = "gensfen_test_shuffled.bin";
+	remove(outPath.c_str());
+	istringstream args(outPath + " --threads 2 --depth 2 --positions 300 --seed 7");
+	ASSERT_EQ(0, UCI::gensfen(args));
+
+	vector<TrainingRecord> recs;
+	Packed::load(outPath, recs);
+	ASSERT_GE(recs.size(), 300);
+	Position pos;
+	for (const TrainingRecord& rec : recs)
+	{
+		ASSERT_TRUE(pos.decode(rec.pos));
+		ASSERT_GE(rec.ply, 8);  // after the random opening
+		ASSERT_TRUE(pos.is_pseudo(rec.move) && pos.pseudo_is_legal(rec.move, pos.pinned_map()));
+		ASSERT_TRUE(rec.result >= -1 && rec.result <= 1);
+	}
+	// A game's positions alternate the side to move, and so the sign of the result
+	for (size_t i = 1; i < recs.size(); i++)
+		if (recs[i].ply == recs[i - 1].ply + 1)
+			ASSERT_EQ(recs[i].result, -recs[i - 1].result);
+
+	istringstream shufArgs("shuffle " + outPath + " " + shufPath + " --seed 1");
+	ASSERT_EQ(0, UCI::gensfen(shufArgs));
+	vector<TrainingRecord> shuffled;
+	Packed::load(shufPath, shuffled);
+	ASSERT_EQ(recs.size(), shuffled.size());
+	auto less = [](const TrainingRecord& a, const TrainingRecord& b)
+		{ return memcmp(&a, &b, sizeof(TrainingRecord)) < 0; };
+	sort(recs.begin(), recs.end(), less);
+	sort(shuffled.begin(), shuffled.end(), less);
+	ASSERT_TRUE(memcmp(recs.data(), shuffled.data(), recs.size() * sizeof(TrainingRecord)) == 0);
+	remove(outPath.c_str());
+	remove(shufPath.c_str());
+}
+
+// Games go on for MaxGamePly after an opening of any length
+TEST_F(SearchThread, GensfenLongOpening)
+{
+	const string outPath = "gensfen_long_test.bin";
+	remove(outPath.c_str());
+	istringstream args(outPath + " --threads 1 --depth 1 --positions 100 --random 398 --seed 3");
+	ASSERT_EQ(0, UCI::gensfen(args));
+
+	vector<TrainingRecord> recs;
+	Packed::load(outPath, recs);
+	ASSERT_GE(recs.size(), 100);
+	Position pos;
+	for (const TrainingRecord& rec : recs)
+	{
+		ASSERT_TRUE(pos.decode(rec.pos));
+		ASSERT_GE(rec.ply, 398);
+		ASSERT_TRUE(pos.is_pseudo(rec.move) && pos.pseudo_is_legal(rec.move, pos.pinned_map()));
+	}
+	remove(outPath.c_str());
+}
+
+TEST(Engine, Concurrent)
+{
+	Excalibur::Engine engine1, engine2(8);
+	ASSERT_FALSE(engine1.set_position("not a fen"));
+	ASSERT_FALSE(engine1.set_position(Excalibur::START_FEN, { "e2e4", "e2e4" }));
+	ASSERT_FALSE(engine1.set_option("Mobility", "abc"));
+	ASSERT_FALSE(engine1.set_option("Threads", "2"));
+	ASSERT_TRUE(engine1.set_option("Contempt Factor", "-20"));
+	ASSERT_TRUE(engine1.set_position(Excalibur::START_FEN, { "e2e4", "e7e5" }));
+	// Back rank mate in 1
+	ASSERT_TRUE(engine2.set_position("6k1/5ppp/8/8/8/8/5PPP/3R2K1 w - - 0 1"));
+
+	Excalibur::Limits limits;
+	limits.depth = 8;
+	int updates1 = 0, updates2 = 0;
+	auto future1 = engine1.analyze(limits, [&](const Excalibur::InfoUpdate& info)
+		{ ASSERT_EQ(++updates1, info.depth); ASSERT_FALSE(info.pv.empty()); });
+	auto future2 = engine2.analyze(limits, [&](const Excalibur::InfoUpdate&) { ++updates2; });
+	Excalibur::SearchResult res1 = future1.get(), res2 = future2.get();
+
+	ASSERT_EQ(8, res1.depth);
+	ASSERT_EQ(8, updates1);
+	ASSERT_FALSE(res1.bestMove.empty());
+	ASSERT_EQ(res1.bestMove, res1.pv[0]);
+	ASSERT_EQ("d1d8", res2.bestMove);
+	ASSERT_TRUE(res2.score.isMate);
+	ASSERT_EQ(1, res2.score.value);
+	ASSERT_GT(updates2, 0);
+
+	// searchmoves, and a mated position
+	limits.searchMoves = { "g1f3" };
+	ASSERT_EQ("g1f3", engine1.analyze(limits).get().bestMove);
+	ASSERT_TRUE(engine2.set_position("6k1/5ppp/8/8/8/8/5PPP/3R2K1 w - - 0 1", { "d1d8" }));
+	Excalibur::SearchResult mated = engine2.analyze(Excalibur::Limits()).get();
+	ASSERT_TRUE(mated.bestMove.empty());
+	ASSERT_TRUE(mated.score.isMate && mated.score.value == 0);
+
+	// An infinite search only ends on stop()
+	auto future = engine1.analyze(Excalibur::Limits());
+	ASSERT_EQ(std::future_status::timeout, future.wait_for(std::chrono::milliseconds(200)));
+	engine1.stop();
+	ASSERT_FALSE(future.get().bestMove.empty());
+}
+
+#ifndef _WIN32
+// A client session of the analysis server
+class ServeClient
+{
+public:
+	ServeClient(const string& path) : fd(socket(AF_UNIX, SOCK_STREAM, 0))
+	{
+		sockaddr_un addr;
+		memset(&addr, 0, sizeof(addr));
+		addr.sun_family = AF_UNIX;
+		strcpy(addr.sun_path, path.c_str());
+		// The server may still be starting up
+		for (int i = 0; i < 500 && connect(fd, (sockaddr *) &addr, sizeof(addr)) < 0; i++)
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+	~ServeClient() { close(fd); }
+
+	void send_line(const string& line)
+		{ string buf = line + "\n"; ASSERT_EQ(ssize_t(buf.size()), send(fd, buf.data(), buf.size(), 0)); }
+
+	// Reads lines until one starts with 'prefix' and returns it. Empty on EOF
+	string read_until(const string& prefix)
+	{
+		string line;
+		while (true)
+		{
+			size_t eol = input.find('\n');
+			if (eol == string::npos)
+			{
+				char buf[4096];
+				ssize_t n = recv(fd, buf, sizeof(buf), 0);
+				if (n <= 0)  return "";
+				input.append(buf, n);
+				continue;
+			}
+			line = input.substr(0, eol);
+			input.erase(0, eol + 1);
+			lines.push_back(line);
+			if (line.compare(0, prefix.size(), prefix) == 0)
+				return line;
+		}
+	}
+
+	int fd;
+	string input;
+	vector<string> lines;
+};
+
+TEST(Serve, Sessions)
+{
+	const string path = "serve_test.sock";
+	int status = -1;
+	std::thread server([&] { istringstream args(path + " --threads 2 --memory 32"); status = UCI::serve(args); });
+
+	ServeClient client(path);
+	client.send_line("isready");
+	ASSERT_EQ("readyok", client.read_until("readyok"));
+	client.send_line("position fen bad");
+	ASSERT_EQ("info string bad position", client.read_until("info string"));
+	client.send_line("position startpos moves e2e4 e2e4");
+	ASSERT_EQ("info string illegal move e2e4", client.read_until("info string"));
+	client.send_line("position fen 6k1/5ppp/8/8/8/8/5PPP/3R2K1 w - - 0 1");
+	client.send_line("go depth 6");
+	ASSERT_EQ("bestmove d1d8", client.read_until("bestmove"));
+	ASSERT_NE(string::npos, client.lines[client.lines.size() - 2].find("score mate 1"));
+
+	// More sessions than workers, with deadlines
+	vector<ServeClient *> clients;
+	for (int i = 0; i < 6; i++)
+	{
+		clients.push_back(new ServeClient(path));
+		clients.back()->send_line("position startpos moves d2d4");
+		clients.back()->send_line(i % 2 ? "go deadline 100" : "go depth 5");
+	}
+	for (ServeClient *c : clients)
+	{
+		ASSERT_EQ(0, c->read_until("bestmove").compare(0, 9, "bestmove "));
+		delete c;
+	}
+
+	// Every line of a MultiPV search comes in each iteration
+	client.send_line("setoption name MultiPV value 2");
+	client.send_line("position startpos");
+	client.send_line("go depth 4");
+	ASSERT_EQ(0, client.read_until("info multipv 2 depth 4").find("info multipv 2 depth 4"));
+	client.read_until("bestmove");
+	client.send_line("setoption name MultiPV value 1");
+
+	// One search at a time per session. 'stop' ends an infinite search
+	client.send_line("position startpos");
+	client.send_line("go infinite searchmoves g1f3");
+	client.send_line("go depth 1");
+	ASSERT_EQ(0, client.read_until("info string").find("info string busy"));
+	client.send_line("stop");
+	ASSERT_EQ(0, client.read_until("bestmove").find("bestmove g1f3"));
+
+	// Shut down with both workers busy and one more search queued
+	ServeClient busy1(path), busy2(path), queued(path);
+	for (ServeClient *c : { &busy1, &busy2 })
+	{
+		c->send_line("go infinite");
+		ASSERT_EQ(0, c->read_until("info depth").find("info depth"));
+	}
+	queued.send_line("go depth 30");
+	queued.send_line("isready");
+	ASSERT_EQ("readyok", queued.read_until("readyok"));
+
+	client.send_line("shutdown");
+	server.join();
+	ASSERT_EQ(0, status);
+	// The queued search doesn't keep its session, and so its socket, alive
+	pollfd pfd = { queued.fd, POLLIN, 0 };
+	ASSERT_EQ(1, poll(&pfd, 1, 2000)) << "the session of a queued search wasn't closed";
+	char c;
+	ASSERT_EQ(0, recv(queued.fd, &c, 1, 0));
+}
+#endif // _WIN32